@@ -3,6 +3,37 @@ document.addEventListener('DOMContentLoaded', ()=>{
   const sidebar = document.getElementById('sidebar');
   let tasksUpdateInterval = null;
   let infoUpdateInterval = null;
+  let eventsLive = false; // true while /api/events is connected; the polls then pause
+  let eventRefresh = null;
+
+  // Push channel: task transitions refresh the visible page at once
+  if (window.EventSource) {
+    const events = new EventSource('/api/events');
+    events.onopen = () => { eventsLive = true; };
+    events.onerror = () => { eventsLive = false; }; // the browser reconnects by itself
+    events.addEventListener('task', () => {
+      // Coalesce bursts (queued -> running -> stopped) into one reload
+      if (eventRefresh) return;
+      eventRefresh = setTimeout(() => {
+        eventRefresh = null;
+        if (document.getElementById('tasks').classList.contains('active')) loadTasksEnhanced();
+        if (document.getElementById('home').classList.contains('active')) loadInfo();
+      }, 200);
+    });
+    events.addEventListener('ota', e => {
+      try {
+        const o = JSON.parse(e.data);
+        const pct = o.total ? ` ${Math.floor(o.bytes * 100 / o.total)}%` : '';
+        document.getElementById('otaStatus').textContent = `${o.state}${pct}, ${(o.bytesPerSec / 1024).toFixed(1)} KB/s`;
+      } catch (_) {}
+    });
+    events.addEventListener('log', e => {
+      try { const l = JSON.parse(e.data); console.log(`[LUA ${l.id}#${l.run}] ${l.msg}`); } catch (_) {}
+    });
+  }
+
+  // Fallback poll of the task list while the push channel is down
+  function pollTasks() { if (!eventsLive) loadTasksEnhanced(); }
 
   // Добавляем флаг для отслеживания фокуса на поле лицензии
   let licenseKeyHasFocus = false;
@@ -39,7 +70,7 @@ document.addEventListener('DOMContentLoaded', ()=>{
       }
       if (li.dataset.page === 'tasks') {
         loadTasksEnhanced();
-        tasksUpdateInterval = setInterval(loadTasksEnhanced, 5000); // Update every 5 seconds
+        tasksUpdateInterval = setInterval(pollTasks, 5000); // Update every 5 seconds
       }
       if (li.dataset.page === 'system') loadSystem();
       if (li.dataset.page === 'files') loadFiles();
@@ -143,6 +174,7 @@ document.addEventListener('DOMContentLoaded', ()=>{
     const pass = document.querySelector('#wifiForm input[name="pass"]'); if (pass) pass.placeholder = t.wifi?.passPlaceholder || 'Password';
     const passLabel = document.querySelector('#wifiForm label[for="passInput"]'); if (passLabel) passLabel.textContent = t.wifi?.passPlaceholder || 'Password';
     const firmwareLabel = document.querySelector('#uploadFirmware label[for="firmwareFile"]'); if (firmwareLabel) firmwareLabel.textContent = t.update?.firmwareFile || 'Firmware file';
+    const shaLabel = document.querySelector('#uploadFirmware label[for="firmwareSha"]'); if (shaLabel) shaLabel.textContent = t.update?.sha256 || 'SHA-256 (optional)';
     const fsLabel = document.querySelector('#uploadFS label[for="fsFile"]'); if (fsLabel) fsLabel.textContent = t.update?.fsFile || 'Filesystem file';
 
     const rtype = document.getElementById('rebootTypeLabel'); if (rtype) rtype.textContent = t.reboot?.typeLabel || 'Type:';
@@ -407,19 +439,10 @@ document.addEventListener('DOMContentLoaded', ()=>{
           // Stop updates during delete
           if (tasksUpdateInterval) { clearInterval(tasksUpdateInterval); tasksUpdateInterval = null; }
 
-          const taskFilePath = `/tasks/${taskId}.json`;
-          const scriptFilePath = `/scripts/${taskId}.lua`;
-
-          const deletePromises = [];
-          deletePromises.push(
-            fetch('/api/files/delete', { method: 'POST', body: new URLSearchParams({ path: taskFilePath }) })
-          );
-
-          if (t.hasScript) {
-            deletePromises.push(
-              fetch('/api/files/delete', { method: 'POST', body: new URLSearchParams({ path: scriptFilePath }) })
-            );
-          }
+          // The firmware stops the task (if running) and removes its metadata and script.
+          const deletePromises = [
+            fetch('/api/tasks/delete', { method: 'POST', body: new URLSearchParams({ id: taskId }) })
+          ];
 
           const results = await Promise.all(deletePromises);
           const allOk = results.every(r => r.ok);
@@ -433,12 +456,12 @@ document.addEventListener('DOMContentLoaded', ()=>{
           
           // Restart updates, but only if the page is still active
           if (document.getElementById('tasks').classList.contains('active')) {
-              tasksUpdateInterval = setInterval(loadTasksEnhanced, 5000);
+              tasksUpdateInterval = setInterval(pollTasks, 5000);
           }
         });
 
         // 4. Run/Stop button - ВАЖНО: исправляем логику отображения кнопок
-        if (t.state === 'running') {
+        if (t.state === 'running' || t.state === 'queued') {
           // Если задача запущена, показываем кнопку остановки
           const stopLabel = TRANSLATIONS.tasks?.stop || 'Stop';
           const stopBtn = makeAction('<i class="fas fa-stop"></i>', stopLabel, async () => { 
@@ -578,35 +601,24 @@ document.addEventListener('DOMContentLoaded', ()=>{
     document.querySelector('.modal .builtins').style.display = 'block';
     const scriptEl = document.getElementById('scriptContent');
 
-    // CONSTRUCT THE PATH, as per the user's instruction to mimic the file editor.
-    const scriptPath = `/scripts/${id}.lua`;
-
-    try {
-        // Fetch the script content directly from its path.
-        const rScript = await fetch(scriptPath);
-        if (rScript.ok) {
-            scriptEl.value = await rScript.text();
-        } else {
-            // If the script doesn't exist (e.g., new task), the fetch will fail (404),
-            // and the editor should be empty. This is correct.
-            scriptEl.value = '';
-        }
-    } catch (e) {
-        console.error(`Failed to fetch script from ${scriptPath}:`, e);
-        scriptEl.value = `Error loading script.`;
-    }
-    
-    // Optionally refresh task name from task API (for title only). This is still useful.
+    // The task API returns the script without its checksum line, so a save doesn't stack them up
     try {
       const rTask = await fetch(`/api/tasks/${encodeURIComponent(id)}`);
       if (rTask.ok) {
           const task = await rTask.json();
-          if (task && task.name) {
+          scriptEl.value = task.script || '';
+          if (task.name) {
               document.getElementById('editorTitle').textContent = `${TRANSLATIONS.tasks?.scriptFor || 'Script:'} ${task.name}`;
           }
+      } else if (rTask.status === 404) {
+          // A task the registry doesn't know yet starts with an empty editor
+          scriptEl.value = '';
+      } else {
+          scriptEl.value = `Error loading script.`;
       }
     } catch (e) {
-      console.error('Error fetching task details:', e);
+      console.error(`Failed to fetch script of task ${id}:`, e);
+      scriptEl.value = `Error loading script.`;
     }
 
     // load builtins
@@ -710,12 +722,18 @@ document.addEventListener('DOMContentLoaded', ()=>{
   // uploads
   document.getElementById('uploadFirmware').addEventListener('submit', async (e)=>{
     e.preventDefault();
-    const fd = new FormData(e.target);
     const file = e.target.querySelector('input[name="firmware"]').files[0];
     if (!file) return alert(TRANSLATIONS.alerts?.selectFile || 'Select file');
+    // Size and digest go before the file, so the device has them when the image starts
+    const fd = new FormData();
+    fd.append('size', file.size);
+    const sha = e.target.querySelector('input[name="sha256"]').value.trim();
+    if (sha) fd.append('sha256', sha);
+    fd.append('firmware', file);
     const r = await fetch('/api/upload/firmware', { method:'POST', body: fd });
+    const res = await r.json().catch(() => ({}));
     if (r.ok) alert(TRANSLATIONS.alerts?.uploadStarted || 'Upload started. Device will restart after update.');
-    else alert('Upload failed');
+    else alert('Upload failed' + (res.error ? ': ' + res.error : ''));
   });
 
   document.getElementById('uploadFS').addEventListener('submit', async (e)=>{
@@ -734,9 +752,21 @@ document.addEventListener('DOMContentLoaded', ()=>{
     const fd = new FormData(e.target);
     const ssid = fd.get('ssid'); 
     const pass = fd.get('pass');
+    const result = document.getElementById('wifiResult');
     const r = await fetch('/api/wifi', { method:'POST', body: new URLSearchParams({ssid, pass}) });
     const j = await r.json();
-    document.getElementById('wifiResult').innerText = j.ok ? (TRANSLATIONS.wifi?.connected || 'Connected') : (TRANSLATIONS.wifi?.failed || 'Failed to connect');
+    if (!j.ok) { result.innerText = TRANSLATIONS.wifi?.failed || 'Failed to connect'; return; }
+    // The device joins in the background; follow it until it settles
+    result.innerText = TRANSLATIONS.wifi?.connecting || 'Connecting...';
+    for (let i = 0; i < 30; i++) {
+      await new Promise(res => setTimeout(res, 1000));
+      let s;
+      try { s = await (await fetch(j.status || '/api/wifi/status')).json(); } catch (err) { continue; }
+      if (s.state === 'connected') { result.innerText = (TRANSLATIONS.wifi?.connected || 'Connected') + ' (' + s.ip + ')'; return; }
+      if (s.state === 'backoff' && s.attempts > 0) { result.innerText = (TRANSLATIONS.wifi?.failed || 'Failed to connect') + ' (' + s.reason + ')'; return; }
+      if (s.state === 'idle') { result.innerText = ''; return; }
+    }
+    result.innerText = TRANSLATIONS.wifi?.failed || 'Failed to connect';
   });
 
   // reboot form
@@ -0,0 +1,162 @@
+/**
+ * @file AtomicFile.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the AtomicFile class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/**
+ * @brief Result of checking a file written by AtomicFile.
+ */
+enum AtomicStatus : uint8_t {
+  ATOMIC_OK = 0,         ///< The checksum footer matches the content.
+  ATOMIC_UNCHECKED = 1,  ///< The file has no footer, e.g. it was written by another tool.
+  ATOMIC_CORRUPT = 2,    ///< The footer does not match the content.
+  ATOMIC_MISSING = 3     ///< The file does not exist.
+};
+
+/**
+ * @class AtomicFile
+ * @brief Crash-safe replacement of a LittleFS file.
+ *
+ * The content is written to "<path>.tmp", flushed, and only then renamed over
+ * the target, so a power loss in the middle of a save leaves either the old or
+ * the new version, never a truncated one. Optionally a checksum footer is
+ * appended: a last line "--crc32:xxxxxxxx" holding the CRC-32 of everything
+ * before it. Being a Lua comment it does not disturb scripts, and it lets
+ * verify() tell a damaged file from a good one. recover() deals with a temp
+ * file left behind by an interrupted save.
+ *
+ * @code
+ * AtomicFile f("/scripts/1.lua", true);
+ * f.write(data, len);
+ * if (!f.commit()) { ... } // the old file is still in place
+ * @endcode
+ */
+class AtomicFile {
+public:
+  /**
+   * @brief Starts replacing a file.
+   * @param path The target path.
+   * @param checksum Append a checksum footer on commit().
+   */
+  explicit AtomicFile(const String &path, bool checksum = false);
+
+  /**
+   * @brief Discards the new content unless commit() was called.
+   */
+  ~AtomicFile();
+
+  AtomicFile(const AtomicFile&) = delete;
+  AtomicFile& operator=(const AtomicFile&) = delete;
+
+  /**
+   * @brief Checks that the temp file is open and every write so far succeeded.
+   */
+  bool ok() const { return _ok; }
+
+  /**
+   * @brief Appends data to the new content.
+   * @return The number of bytes written; less than len marks the file as failed.
+   */
+  size_t write(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Writes the footer, flushes the temp file and renames it over the target.
+   * @return True if the target now holds the new content.
+   */
+  bool commit();
+
+  /**
+   * @brief Removes the temp file; the target stays as it was.
+   */
+  void abort();
+
+  /**
+   * @brief Replaces a file with the given content in one step.
+   * @param path The target path.
+   * @param data The content.
+   * @param len The length of the content in bytes.
+   * @param checksum Append a checksum footer.
+   * @return True on success; on failure the old file is unchanged.
+   */
+  static bool write(const String &path, const uint8_t *data, size_t len, bool checksum = false);
+
+  /**
+   * @brief Replaces a file with the given content in one step.
+   */
+  static bool write(const String &path, const String &content, bool checksum = false) {
+    return write(path, (const uint8_t*)content.c_str(), content.length(), checksum);
+  }
+
+  /**
+   * @brief Reads a file, removing a checksum footer.
+   * @param path The path of the file.
+   * @param content Receives the content without the footer.
+   * @return The result of the checksum test.
+   */
+  static AtomicStatus read(const String &path, String &content);
+
+  /**
+   * @brief Checks the footer of a file without loading it into RAM.
+   */
+  static AtomicStatus verify(const String &path);
+
+  /**
+   * @brief Gets the length of an open file without its checksum footer, for
+   * streaming the content. The file is left positioned at its start.
+   */
+  static size_t contentLength(File &file);
+
+  /**
+   * @brief Removes a trailing checksum footer from a string, e.g. from content
+   * that was edited in the file manager and is about to be saved again.
+   * @return True if there was a footer.
+   */
+  static bool stripFooter(String &content);
+
+  /**
+   * @brief Finishes or discards an interrupted save of a file.
+   * A temp file is renamed to the target only if the target is missing and the
+   * temp file carries a valid footer; otherwise it is removed.
+   * @param path The target path (without ".tmp").
+   * @return True if a temp file was found.
+   */
+  static bool recover(const String &path);
+
+  /**
+   * @brief Renames a file over another one.
+   * Falls back to remove and rename where the filesystem refuses to replace.
+   */
+  static bool replace(const String &from, const String &to);
+
+  /**
+   * @brief Computes a CRC-32 (IEEE 802.3) checksum.
+   * @param crc The checksum of the preceding data when checksumming in pieces.
+   */
+  static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+private:
+  /**
+   * @brief Parses a footer.
+   * @param tail The last FOOTER_SIZE bytes of a file.
+   * @param crc Receives the checksum stored in the footer.
+   * @return False if the bytes are not a footer.
+   */
+  static bool _parseFooter(const char *tail, uint32_t &crc);
+
+  static const size_t FOOTER_SIZE = 18; ///< "\n--crc32:" + 8 hex digits + "\n".
+
+  String _path;          ///< Target path.
+  String _tmp;           ///< Temp file receiving the new content.
+  File _file;            ///< Open temp file; closed after commit() or abort().
+  uint32_t _crc = 0;     ///< Checksum of the content written so far.
+  bool _checksum;        ///< Append a footer on commit().
+  bool _ok;              ///< No write failed so far.
+};
@@ -0,0 +1,137 @@
+/**
+ * @file EventHub.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the EventHub class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef EVENT_RING_SIZE
+#define EVENT_RING_SIZE 32 ///< Events kept for sending and for replay to reconnecting clients.
+#endif
+
+#ifndef EVENT_DATA_SIZE
+#define EVENT_DATA_SIZE 192 ///< Maximum size of the JSON data of one event, including the terminator.
+#endif
+
+#ifndef EVENT_CLIENT_QUEUE
+#define EVENT_CLIENT_QUEUE 8 ///< Messages a client may have queued on average before sending pauses.
+#endif
+
+#ifndef EVENT_LOCK_MS
+#define EVENT_LOCK_MS 5 ///< Longest wait of a producer for the ring lock.
+#endif
+
+#ifndef EVENT_PUMP_MS
+#define EVENT_PUMP_MS 50 ///< Interval of the pump() calls in the Arduino loop.
+#endif
+
+#ifndef EVENT_PUMP_BATCH
+#define EVENT_PUMP_BATCH 8 ///< Events handed to the clients per pump() call.
+#endif
+
+/**
+ * @class EventHub
+ * @brief Server-Sent Events channel (/api/events) for task transitions and script logs.
+ *
+ * Producers on any task or core publish into a fixed ring of events and never
+ * wait for the network. pump(), called from the Arduino loop, forwards the ring
+ * to the connected clients. While clients are slow to take their messages the
+ * events stay in the ring; once it wraps the oldest unsent events are dropped
+ * and a "dropped" event tells the clients how many were lost. Every event
+ * carries its sequence number as SSE id, so a reconnecting browser gets the
+ * events it missed replayed as long as they are still in the ring.
+ *
+ * Events: "task" {"id","state","run"}, "log" {"id","run","msg"}, "dropped" {"count"}.
+ */
+class EventHub {
+public:
+  /**
+   * @brief Creates the hub.
+   * @param url The path of the event stream.
+   */
+  explicit EventHub(const char *url = "/api/events");
+
+  /**
+   * @brief Registers the event stream with the web server.
+   */
+  void begin(AsyncWebServer &server);
+
+  /**
+   * @brief Queues an event for the clients. Safe to call from any task.
+   * Waits at most EVENT_LOCK_MS for the ring, never for the network.
+   * @param event The event name (at most 11 characters).
+   * @param data The JSON data; longer data is refused.
+   * @return False if the event was dropped.
+   */
+  bool publish(const char *event, const char *data);
+
+  /**
+   * @brief Publishes a task transition.
+   * @param id The task ID.
+   * @param state The new state ("queued", "running", "stopped", "deleted").
+   * @param run The run number, 0 if unknown.
+   */
+  bool publishTask(const char *id, const char *state, uint32_t run);
+
+  /**
+   * @brief Publishes a line logged by a script; long lines are shortened.
+   * @param id The task ID.
+   * @param run The run number.
+   * @param msg The message.
+   */
+  bool publishLog(const char *id, uint32_t run, const char *msg);
+
+  /**
+   * @brief Hands queued events to the clients. Call regularly from one task.
+   */
+  void pump();
+
+  /**
+   * @brief Gets the number of connected clients.
+   */
+  size_t clients() const { return _source.count(); }
+
+  /**
+   * @brief Gets the number of events dropped because the ring was full.
+   */
+  uint32_t dropped() const { return _dropped.load(); }
+
+private:
+  /**
+   * @struct Event
+   * @brief One slot of the ring.
+   */
+  struct Event {
+    uint32_t seq;                ///< Sequence number, the SSE id.
+    char name[12];               ///< Event name.
+    char data[EVENT_DATA_SIZE];  ///< JSON data.
+  };
+
+  /**
+   * @brief Copies the event with a given sequence number out of the ring.
+   * @return False if it was overwritten already.
+   */
+  bool _read(uint32_t seq, Event &out);
+
+  /**
+   * @brief Sends the retained events after the client's last ID to a reconnecting client.
+   */
+  void _replay(AsyncEventSourceClient *client);
+
+  AsyncEventSource _source;              ///< The SSE endpoint.
+  Event _ring[EVENT_RING_SIZE] = {};     ///< Recent events.
+  uint32_t _next = 1;                    ///< Sequence number of the next event.
+  uint32_t _sent = 1;                    ///< Sequence number of the next event to send.
+  std::atomic<uint32_t> _dropped{0};     ///< Events lost to a full ring.
+  uint32_t _reported = 0;                ///< Value of _dropped last announced to the clients.
+  SemaphoreHandle_t _mutex = nullptr;    ///< Guards the ring.
+};
@@ -0,0 +1,94 @@
+/**
+ * @file JsonListStream.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the JsonListStream class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <memory>
+
+#ifndef JSON_STREAM_ENTRY_SIZE
+#define JSON_STREAM_ENTRY_SIZE 384 ///< Capacity of the JSON document of one list entry (and of the head/tail).
+#endif
+
+#ifndef JSON_STREAM_BUFFER_SIZE
+#define JSON_STREAM_BUFFER_SIZE 512 ///< Bytes reserved for the serialized text of one entry.
+#endif
+
+/**
+ * @class JsonListStream
+ * @brief Serves a JSON object holding one (possibly long) array as a chunked response.
+ *
+ * The response has the form {<head fields>,"<key>":[<entry>,...],<tail fields>}.
+ * Entries are produced one at a time while the connection asks for data, so the
+ * memory used does not depend on the number of entries and no output is ever
+ * truncated. An entry that does not fit JSON_STREAM_BUFFER_SIZE is skipped.
+ */
+class JsonListStream {
+public:
+  /**
+   * @brief Fills the next entry.
+   * @return False when there are no more entries; the object is ignored then.
+   */
+  typedef std::function<bool(JsonObject)> Producer;
+
+  /**
+   * @brief Adds fields before or after the list.
+   */
+  typedef std::function<void(JsonObject)> Fields;
+
+  /**
+   * @brief Creates a stream.
+   * @param key The name of the array.
+   * @param next Produces the entries; called from the web server task.
+   * @param head Adds the fields written before the array, may be empty.
+   * @param tail Adds the fields written after the array, may be empty.
+   */
+  JsonListStream(const char *key, Producer next, Fields head = nullptr, Fields tail = nullptr);
+
+  /**
+   * @brief Sends a stream as a chunked application/json response.
+   * The stream is kept alive until the response is finished.
+   * @param etag ETag of the content, sent with "Cache-Control: no-cache"; empty for none.
+   */
+  static void send(AsyncWebServerRequest *request, std::shared_ptr<JsonListStream> stream, const String &etag = String());
+
+  /**
+   * @brief Writes the next part of the response.
+   * @param buffer Receives the data.
+   * @param maxLen The size of the buffer.
+   * @return The number of bytes written, 0 at the end.
+   */
+  size_t read(uint8_t *buffer, size_t maxLen);
+
+private:
+  enum Phase : uint8_t { PHASE_HEAD, PHASE_ENTRIES, PHASE_TAIL, PHASE_DONE };
+
+  /**
+   * @brief Serializes the next piece of the response into the pending buffer.
+   * @return False when the response is complete.
+   */
+  bool _fill();
+
+  /**
+   * @brief Serializes a set of fields without their enclosing braces.
+   */
+  size_t _fields(const Fields &fields, char *out, size_t size);
+
+  String _key;                           ///< Name of the array.
+  Producer _next;                        ///< Entry producer.
+  Fields _head;                          ///< Fields before the array.
+  Fields _tail;                          ///< Fields after the array.
+  Phase _phase = PHASE_HEAD;             ///< Part being written.
+  size_t _entries = 0;                   ///< Entries written so far.
+  char _pending[JSON_STREAM_BUFFER_SIZE + 8]; ///< Text not yet handed to the connection.
+  size_t _len = 0;                       ///< Bytes in the pending buffer.
+  size_t _pos = 0;                       ///< Bytes of the pending buffer already sent.
+};
@@ -0,0 +1,149 @@
+/**
+ * @file Logger.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the Logger class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64 ///< Log entries kept in RAM (power of two).
+#endif
+
+#ifndef LOG_MSG_SIZE
+#define LOG_MSG_SIZE 112 ///< Maximum length of a log message, including the terminator.
+#endif
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO ///< Least severe level that is recorded at all.
+#endif
+
+#ifndef LOG_FILE_LEVEL
+#define LOG_FILE_LEVEL LOG_LEVEL_INFO ///< Least severe level written to the log file.
+#endif
+
+#ifndef LOG_FILE_PATH
+#define LOG_FILE_PATH "/logs/system.log" ///< Current log file; the previous one gets a ".1" suffix.
+#endif
+
+#ifndef LOG_FILE_MAX
+#define LOG_FILE_MAX 32768 ///< Size in bytes at which the log file is rotated.
+#endif
+
+#ifndef LOG_FILE_FLUSH_MS
+#define LOG_FILE_FLUSH_MS 2000 ///< Longest time a line waits in the file buffer.
+#endif
+
+#ifndef LOG_DRAIN_MS
+#define LOG_DRAIN_MS 100 ///< Interval of the drain task.
+#endif
+
+/**
+ * @brief Severity of a log entry.
+ */
+enum LogLevel : uint8_t {
+  LOG_LEVEL_ERROR = 0,
+  LOG_LEVEL_WARN = 1,
+  LOG_LEVEL_INFO = 2,
+  LOG_LEVEL_DEBUG = 3
+};
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+/**
+ * @struct LogEntry
+ * @brief One log line as kept in the ring.
+ */
+struct LogEntry {
+  uint32_t seq;            ///< Sequence number, starting at 1.
+  uint32_t ms;             ///< millis() when the line was logged.
+  uint8_t level;           ///< One of LogLevel.
+  char tag[11];            ///< Subsystem, e.g. "tasks".
+  char task[16];           ///< ID of the task the line is about, empty if none.
+  char msg[LOG_MSG_SIZE];  ///< The message.
+};
+
+/**
+ * @class Logger
+ * @brief Structured logging through a lock-free ring in RAM.
+ *
+ * Producers on any task or core reserve a slot with one atomic increment and
+ * format straight into it; they never lock and never touch the UART or the
+ * filesystem. A background drain task prints new entries to Serial and appends
+ * them to a rotating log file in LittleFS, batched. Readers such as /api/logs
+ * copy entries by sequence number and detect entries that were overwritten
+ * meanwhile. When producers lap the drain the oldest entries are lost and
+ * counted in dropped().
+ */
+class Logger {
+public:
+  /**
+   * @brief Starts the drain task. Lines logged earlier wait in the ring.
+   */
+  static void begin();
+
+  /**
+   * @brief Records a log line.
+   * @param level The severity.
+   * @param tag The subsystem.
+   * @param task The ID of the task the line is about, nullptr for none.
+   * @param fmt printf-style format.
+   */
+  static void write(LogLevel level, const char *tag, const char *task, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+  /** @brief Records an error. */
+  static void error(const char *tag, const char *task, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+  /** @brief Records a warning. */
+  static void warn(const char *tag, const char *task, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+  /** @brief Records an informational line. */
+  static void info(const char *tag, const char *task, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+  /** @brief Records a debug line (only if LOG_LEVEL allows). */
+  static void debug(const char *tag, const char *task, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+  /**
+   * @brief Copies an entry out of the ring.
+   * @param seq The sequence number.
+   * @param out Receives the entry.
+   * @return False if the entry was overwritten or is still being written.
+   */
+  static bool read(uint32_t seq, LogEntry &out);
+
+  /**
+   * @brief Gets the sequence number the next entry will get.
+   */
+  static uint32_t next();
+
+  /**
+   * @brief Gets the oldest sequence number that may still be in the ring.
+   */
+  static uint32_t oldest();
+
+  /**
+   * @brief Gets the number of entries lost before they were drained.
+   */
+  static uint32_t dropped();
+
+  /**
+   * @brief Gets the name of a level ("error", "warn", "info", "debug").
+   */
+  static const char* levelName(uint8_t level);
+
+private:
+  static void _vwrite(LogLevel level, const char *tag, const char *task, const char *fmt, va_list args);
+  static void _drainTask(void *pvParameters);
+
+  /**
+   * @brief Forwards the new entries to Serial and the file buffer.
+   */
+  static void _drain();
+
+  /**
+   * @brief Appends the file buffer to the log file, rotating it when full.
+   */
+  static void _flushFile();
+};
@@ -0,0 +1,127 @@
+/**
+ * @file LuaArena.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the LuaArena class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef LUA_ARENA_CHUNK_SIZE
+#define LUA_ARENA_CHUNK_SIZE 4096 ///< Size of one arena chunk in bytes.
+#endif
+
+#ifndef LUA_ARENA_MAX_CHUNKS
+#define LUA_ARENA_MAX_CHUNKS 8 ///< Chunks an arena may hold; further small blocks come from the heap.
+#endif
+
+#ifndef LUA_ARENA_OWNERS
+#define LUA_ARENA_OWNERS 64 ///< Number of accounting owners (owner 0 is the state itself).
+#endif
+
+/**
+ * @class LuaArena
+ * @brief lua_Alloc implementation with size-class free lists and per-owner budgets.
+ *
+ * Small blocks are carved from a bounded number of fixed-size chunks and recycled
+ * through one free list per size class; larger blocks come from the heap, in
+ * PSRAM when enabled and available. Every block carries a small header with the
+ * owner it is accounted to, so each owner (e.g. one task run sharing the state)
+ * has its own usage, peak and byte cap. Allocations that would exceed the cap of
+ * the current owner fail, which Lua reports as a memory error in that script.
+ * An arena is used by one thread at a time.
+ */
+class LuaArena {
+public:
+  /**
+   * @brief Creates an empty arena.
+   * @param usePsram Place large blocks in PSRAM if the board has it.
+   */
+  explicit LuaArena(bool usePsram = false);
+
+  /**
+   * @brief Releases the chunks. The state using the arena must be closed first.
+   */
+  ~LuaArena();
+
+  /**
+   * @brief The lua_Alloc function; pass the arena as user data to lua_newstate().
+   */
+  static void* alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+  /**
+   * @brief Sets the owner that new allocations are accounted to.
+   * @param owner The owner, 0 for the state itself (no cap).
+   */
+  void setOwner(uint8_t owner) { _owner = owner < LUA_ARENA_OWNERS ? owner : 0; }
+
+  /**
+   * @brief Resets the counters of an owner and sets its cap.
+   * @param owner The owner (1..LUA_ARENA_OWNERS-1).
+   * @param limit The cap in bytes, 0 for none.
+   */
+  void beginOwner(uint8_t owner, uint32_t limit);
+
+  /**
+   * @brief Gets the bytes currently accounted to an owner.
+   */
+  uint32_t used(uint8_t owner) const { return owner < LUA_ARENA_OWNERS ? _used[owner] : 0; }
+
+  /**
+   * @brief Gets the highest usage of an owner since beginOwner().
+   */
+  uint32_t peak(uint8_t owner) const { return owner < LUA_ARENA_OWNERS ? _peak[owner] : 0; }
+
+  /**
+   * @brief Gets the bytes held in arena chunks.
+   */
+  size_t reserved() const { return _chunks * LUA_ARENA_CHUNK_SIZE; }
+
+private:
+  /**
+   * @struct Header
+   * @brief Prefix of every block.
+   */
+  struct Header {
+    uint8_t owner;      ///< Owner the block is accounted to.
+    uint8_t cls;        ///< Size class, or CLASS_HEAP for heap blocks.
+    uint16_t reserved;
+#if UINTPTR_MAX > 0xFFFFFFFFu
+    uint32_t pad;       ///< Keeps payloads pointer-aligned on 64-bit hosts.
+#endif
+  };
+
+  static const uint8_t CLASS_HEAP = 0xFF;
+  static const uint8_t CLASS_COUNT = 9;
+  static const uint16_t CLASS_SIZE[CLASS_COUNT];
+
+  /**
+   * @brief Gets the smallest size class holding a payload of n bytes, CLASS_HEAP if none.
+   */
+  static uint8_t _classOf(size_t n);
+
+  /**
+   * @brief Gets the payload capacity of a block.
+   */
+  static size_t _capacity(const Header *h, size_t size);
+
+  void* _allocate(size_t n);
+  void _release(void *ptr, size_t n);
+  bool _charge(uint8_t owner, size_t n);
+  void _credit(uint8_t owner, size_t n);
+  void* _carve(uint8_t cls);
+
+  void *_free[CLASS_COUNT] = {};         ///< Free lists, linked through the payload.
+  void *_chunkList = nullptr;            ///< Chunks, linked through their first word.
+  uint8_t *_bump = nullptr;              ///< Next unused byte of the newest chunk.
+  size_t _left = 0;                      ///< Unused bytes in the newest chunk.
+  size_t _chunks = 0;                    ///< Number of chunks.
+  bool _psram = false;                   ///< Large blocks go to PSRAM.
+  uint8_t _owner = 0;                    ///< Owner of new allocations.
+  uint32_t _used[LUA_ARENA_OWNERS] = {}; ///< Bytes per owner.
+  uint32_t _peak[LUA_ARENA_OWNERS] = {}; ///< Peak bytes per owner.
+  uint32_t _limit[LUA_ARENA_OWNERS] = {}; ///< Cap per owner, 0 for none.
+};
@@ -0,0 +1,80 @@
+/**
+ * @file LuaStatePool.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the LuaStatePool class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+struct lua_State;
+class LuaArena;
+
+/**
+ * @class LuaStatePool
+ * @brief Source of pre-initialized Lua states for the workers.
+ *
+ * States are created with the standard libraries opened and the builtins
+ * registered, some of them up front so the workers start without delay. Each
+ * Lua worker acquires one state when it starts and keeps it for good; its runs
+ * are threads of that state. Each run executes its chunk in a fresh environment
+ * table that copies what it reads from the shared globals, libraries one level
+ * deep, so runs see neither each other's globals nor each other's changes to
+ * the libraries. Deeper tables (package.loaded) and the debug library still
+ * reach the shared state; the sandbox keeps ordinary scripts apart, it does not
+ * contain hostile ones. When no prepared state is left, acquire() creates one.
+ * Each state allocates through its own LuaArena.
+ */
+class LuaStatePool {
+public:
+  /**
+   * @brief Function that prepares a new state (e.g. registers builtins).
+   */
+  typedef void (*InitFunction)(lua_State *L);
+
+  /**
+   * @brief Creates the states handed out first.
+   * @param size The number of states to prepare.
+   * @param init Called once for every new state after the standard libraries are opened.
+   * @param usePsram Let the arenas place large blocks in PSRAM if the board has it.
+   */
+  void begin(size_t size, InitFunction init, bool usePsram = false);
+
+  /**
+   * @brief Takes a prepared state, or creates one if none is left.
+   * The caller owns the state from then on.
+   * @return A ready state, or nullptr if no state could be created.
+   */
+  lua_State* acquire();
+
+  /**
+   * @brief Gives the function on top of the stack a fresh sandbox environment.
+   * Replaces the function's _ENV upvalue with a new table in which _G is the
+   * table itself and any other name is copied from the globals of the state
+   * on first read, a library table as a shallow copy. The function stays on the stack.
+   * @param L The state holding the function.
+   */
+  static void sandbox(lua_State *L);
+
+  /**
+   * @brief Gets the arena allocator of a state created by the pool.
+   */
+  static LuaArena* arena(lua_State *L);
+
+private:
+  /**
+   * @brief Creates and initializes a new state.
+   */
+  lua_State* _create();
+
+  InitFunction _init = nullptr;          ///< Per-state initializer.
+  std::vector<lua_State*> _idle;         ///< Prepared states not handed out yet.
+  bool _psram = false;                   ///< Arenas may use PSRAM.
+  SemaphoreHandle_t _mutex = nullptr;    ///< Guards _idle.
+};
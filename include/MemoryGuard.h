@@ -0,0 +1,92 @@
+/**
+ * @file MemoryGuard.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the MemoryGuard class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "Metrics.h"
+
+#ifndef MEM_GUARD_MIN_FREE
+#define MEM_GUARD_MIN_FREE 20480 ///< Free heap in bytes that must remain after an admitted allocation.
+#endif
+
+#ifndef MEM_GUARD_RESERVE
+#define MEM_GUARD_RESERVE 4096 ///< Bytes the largest free block must exceed an admitted allocation by.
+#endif
+
+#ifndef MEM_GUARD_RUN_BYTES
+#define MEM_GUARD_RUN_BYTES 16384 ///< Contiguous memory a new Lua run is assumed to need (thread, chunk, first arena chunks).
+#endif
+
+#ifndef MEM_GUARD_DEFER_MS
+#define MEM_GUARD_DEFER_MS 10000 ///< How long a worker holds a queued run back for memory before dropping it.
+#endif
+
+#ifndef MEM_GUARD_LOG_MS
+#define MEM_GUARD_LOG_MS 5000 ///< Shortest interval between two "low memory" log lines.
+#endif
+
+/**
+ * @enum MemoryUse
+ * @brief What an admission request is for; counted separately.
+ */
+enum MemoryUse : uint8_t {
+  MEM_USE_RUN = 0,  ///< Start of a Lua run.
+  MEM_USE_RESPONSE, ///< A large response built in memory.
+  MEM_USE_COUNT
+};
+
+/**
+ * @class MemoryGuard
+ * @brief Admission control for allocations that can fail on a fragmented heap.
+ *
+ * The free heap alone says little on a long-running controller: after hours of
+ * runs it is split into small blocks and a large allocation fails even though
+ * plenty of memory is free. Before such work starts, admit() checks that the
+ * largest free block holds the allocation with MEM_GUARD_RESERVE to spare and
+ * that MEM_GUARD_MIN_FREE bytes stay free afterwards. Refused work is answered
+ * with 503 instead of risking an allocation failure in the middle of a run.
+ * The decisions are counted for /api/metrics. All methods are thread-safe.
+ */
+class MemoryGuard {
+public:
+  /**
+   * @brief Checks whether an allocation fits, without counting a decision.
+   * Also tracks the smallest largest free block seen.
+   * @param bytes Size of the largest single allocation of the work.
+   */
+  static bool available(size_t bytes);
+
+  /**
+   * @brief Decides whether work may start, counting and logging the decision.
+   * @param use What the memory is for.
+   * @param bytes Size of the largest single allocation of the work.
+   * @return True if the work may start.
+   */
+  static bool admit(MemoryUse use, size_t bytes);
+
+  /**
+   * @brief Counts a run that a worker holds back until memory is available.
+   */
+  static void deferred();
+
+  /**
+   * @brief Counts work refused after it was deferred.
+   */
+  static void refused(MemoryUse use);
+
+  /**
+   * @brief Checks whether the last check found the heap too low.
+   */
+  static bool low();
+
+  /**
+   * @brief Gets the section of /api/metrics with the decisions and the watermarks.
+   */
+  static MetricsStream::Section metricsSection();
+};
@@ -0,0 +1,100 @@
+/**
+ * @file Metrics.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the Metrics and MetricsStream classes for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @class MetricsStream
+ * @brief Serves Prometheus text exposition as a chunked response.
+ *
+ * The text is produced by sections, each called repeatedly to append its next
+ * piece (a metric family header or a few samples) until it reports the end.
+ * Only one piece is held in memory, so the response size does not depend on
+ * the number of tasks or routes.
+ */
+class MetricsStream {
+public:
+  /**
+   * @brief Appends the next piece of a section.
+   * @return False when the section is complete; nothing may be appended then.
+   */
+  typedef std::function<bool(String &out)> Section;
+
+  explicit MetricsStream(std::vector<Section> sections) : _sections(std::move(sections)) {}
+
+  /**
+   * @brief Sends a stream as a chunked text/plain response.
+   */
+  static void send(AsyncWebServerRequest *request, std::shared_ptr<MetricsStream> stream);
+
+  /**
+   * @brief Writes the next part of the response.
+   * @return The number of bytes written, 0 at the end.
+   */
+  size_t read(uint8_t *buffer, size_t maxLen);
+
+private:
+  std::vector<Section> _sections; ///< Producers, in output order.
+  size_t _section = 0;            ///< Section being written.
+  String _pending;                ///< Text not yet handed to the connection.
+  size_t _pos = 0;                ///< Bytes of the pending text already sent.
+};
+
+/**
+ * @class Metrics
+ * @brief Request counters of the API routes and helpers for the Prometheus text format.
+ *
+ * Routes are registered once at startup; record() then only updates counters
+ * and never allocates. All routes are served by the web server task, which is
+ * the only writer, so the counters need no lock.
+ */
+class Metrics {
+public:
+  /**
+   * @brief Registers a route.
+   * @param method The HTTP method(s) of the route.
+   * @param path The path shown in the "route" label.
+   * @return The handle to pass to record().
+   */
+  static int addRoute(WebRequestMethodComposite method, const char *path);
+
+  /**
+   * @brief Counts a request of a route.
+   * @param route The handle returned by addRoute().
+   * @param us Time spent in the handler in microseconds.
+   */
+  static void record(int route, uint32_t us);
+
+  /**
+   * @brief Gets the section with the request count and duration histogram of every route.
+   */
+  static MetricsStream::Section routesSection();
+
+  /**
+   * @brief Appends the # HELP and # TYPE lines of a metric family.
+   */
+  static void family(String &out, const char *name, const char *type, const char *help);
+
+  /**
+   * @brief Appends a sample line.
+   * @param labels Label pairs without braces (see label()), nullptr for none.
+   */
+  static void sample(String &out, const char *name, const char *labels, double value);
+  static void sample(String &out, const char *name, const char *labels, uint64_t value);
+
+  /**
+   * @brief Formats a label pair, escaping the value.
+   */
+  static String label(const char *key, const char *value);
+};
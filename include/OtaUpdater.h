@@ -0,0 +1,179 @@
+/**
+ * @file OtaUpdater.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the OtaUpdater class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <mbedtls/sha256.h>
+
+#ifndef OTA_REQUIRE_SHA256
+#define OTA_REQUIRE_SHA256 0 ///< Refuse firmware uploads that do not supply a SHA-256 digest.
+#endif
+
+#ifndef OTA_CONFIRM_MS
+#define OTA_CONFIRM_MS 30000 ///< Time a new image must run and pass the self-test before it is kept.
+#endif
+
+#ifndef OTA_BOOT_ATTEMPTS
+#define OTA_BOOT_ATTEMPTS 3 ///< Boots a new image gets to confirm itself before the previous one is restored.
+#endif
+
+#ifndef OTA_MIN_HEAP
+#define OTA_MIN_HEAP 32768 ///< Free heap (bytes) the self-test requires.
+#endif
+
+#ifndef OTA_EVENT_MS
+#define OTA_EVENT_MS 500 ///< Interval of "ota" progress events during an upload.
+#endif
+
+class EventHub;
+
+/**
+ * @brief State of a firmware upload.
+ */
+enum OtaState : uint8_t {
+  OTA_IDLE = 0,      ///< No upload since boot.
+  OTA_RECEIVING = 1, ///< Chunks are being written to the update partition.
+  OTA_READY = 2,     ///< Verified and set as boot partition; waits for the reboot.
+  OTA_FAILED = 3     ///< Aborted; the boot partition is unchanged.
+};
+
+/**
+ * @brief State of the image that is running.
+ */
+enum OtaBootState : uint8_t {
+  OTA_BOOT_NORMAL = 0,      ///< Not a fresh update.
+  OTA_BOOT_TESTING = 1,     ///< A fresh update running its self-test.
+  OTA_BOOT_CONFIRMED = 2,   ///< A fresh update that passed the self-test.
+  OTA_BOOT_ROLLED_BACK = 3  ///< The previous image, restored after a failed update.
+};
+
+/**
+ * @class OtaUpdater
+ * @brief Streams firmware into the update partition and guards the first boot.
+ *
+ * Each chunk is written to flash as it arrives and fed into a SHA-256, and a
+ * failed write aborts the update at once. When the upload ends the digest is
+ * compared with the one the client supplied; only then is the image finalized
+ * and made the boot partition, so a truncated or corrupted upload over a weak
+ * link leaves the running firmware untouched.
+ *
+ * The first boots of a new image are counted in NVS. The image must run for
+ * OTA_CONFIRM_MS and pass a self-test (filesystem, heap, network) to be kept;
+ * if it fails the test, or crashes OTA_BOOT_ATTEMPTS times before getting
+ * there, the previous image is made the boot partition again. On builds with
+ * bootloader rollback enabled the image state is marked accordingly as well.
+ */
+class OtaUpdater {
+public:
+  /**
+   * @brief Connects the event hub that receives "ota" progress events.
+   */
+  void setEventHub(EventHub *events) { _events = events; }
+
+  /**
+   * @brief Checks whether this boot is the first of a new image.
+   * Call early in setup(), after Logger::begin(); may restore the previous
+   * image and restart.
+   */
+  void checkBoot();
+
+  /**
+   * @brief Runs the self-test of a new image once it has run for OTA_CONFIRM_MS.
+   * Call regularly from loop().
+   */
+  void poll();
+
+  /**
+   * @brief Starts an update.
+   * @param size The image size in bytes, 0 if unknown.
+   * @param sha256 The expected digest as 64 hex digits, empty if none.
+   * @return False if the update could not start; see error().
+   */
+  bool start(size_t size, const String &sha256);
+
+  /**
+   * @brief Hashes a chunk and writes it to the update partition.
+   * @return False if the update failed; it is aborted then.
+   */
+  bool write(const uint8_t *data, size_t len);
+
+  /**
+   * @brief Verifies the digest and makes the image the boot partition.
+   * @return False if the image was rejected; the update is aborted then.
+   */
+  bool finish();
+
+  /**
+   * @brief Aborts the current update.
+   * @param reason The error to report.
+   */
+  void abort(const char *reason);
+
+  /**
+   * @brief Gets the upload state.
+   */
+  OtaState state() const { return _state; }
+
+  /**
+   * @brief Gets the reason of the last failure.
+   */
+  const String& error() const { return _error; }
+
+  /**
+   * @brief Fills a JSON object with the upload progress and boot state.
+   * Fields: state, bytes, total, bytesPerSec, elapsedMs, sha256, error,
+   * partition and boot.
+   */
+  void getStatusJSON(JsonObject out);
+
+private:
+  /**
+   * @brief Aborts the update and records the reason.
+   */
+  void _fail(const String &reason);
+
+  /**
+   * @brief Checks that the new image works.
+   * @return nullptr if it does, else the failed check.
+   */
+  const char* _selfTest();
+
+  /**
+   * @brief Keeps the running image.
+   */
+  void _confirm();
+
+  /**
+   * @brief Restores the previous image and restarts.
+   */
+  void _rollback(const char *reason);
+
+  /**
+   * @brief Publishes the progress as an "ota" event.
+   */
+  void _publish();
+
+  static const char* _stateName(OtaState state);
+
+  mbedtls_sha256_context _sha;       ///< Digest of the bytes received so far.
+  bool _hashing = false;             ///< _sha is initialized.
+  OtaState _state = OTA_IDLE;        ///< Upload state.
+  OtaBootState _boot = OTA_BOOT_NORMAL; ///< State of the running image.
+  size_t _bytes = 0;                 ///< Bytes written.
+  size_t _total = 0;                 ///< Announced image size, 0 if unknown.
+  uint32_t _startMs = 0;             ///< millis() when the upload started.
+  uint32_t _endMs = 0;               ///< millis() when it finished or failed.
+  uint32_t _eventMs = 0;             ///< millis() of the last progress event.
+  uint32_t _bootMs = 0;              ///< millis() when the self-test period started.
+  char _expected[65] = "";           ///< Expected digest (lower-case hex).
+  char _digest[65] = "";             ///< Computed digest once finished.
+  String _error;                     ///< Reason of the last failure.
+  EventHub *_events = nullptr;       ///< Receiver of progress events.
+};
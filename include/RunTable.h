@@ -0,0 +1,135 @@
+/**
+ * @file RunTable.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the RunTable class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "TaskStore.h"
+
+#ifndef RUN_TABLE_SIZE
+#define RUN_TABLE_SIZE 48 ///< Maximum number of queued and running runs.
+#endif
+
+/**
+ * @class RunTable
+ * @brief Fixed-capacity table of the active (queued or running) task runs.
+ *
+ * Each slot holds the integer key of a task and one atomic state word that packs
+ * the run number with its TaskState. Readers never lock and never allocate; they
+ * may be called from any task or core. Writers (claim, setState, release,
+ * setWaiting) must be serialized by the caller, e.g. under the registry lock.
+ * A slot index stays valid for the whole run, so the worker executing a run
+ * addresses its slot directly.
+ */
+class RunTable {
+public:
+  static const uint32_t KEY_ASSIGNED = 0x80000000u; ///< Keys from here on are assigned by the task registry.
+
+  /**
+   * @brief Computes the run table key of a numeric task ID.
+   * Canonical decimal IDs (the default, see TaskManager::createTask) below
+   * KEY_ASSIGNED map to their value. Other IDs, "007" included, have no key of
+   * their own; the task registry assigns them one from KEY_ASSIGNED on, so no
+   * two tasks ever share a key.
+   * @param id The task ID.
+   * @return The key, or 0 if the ID is not such a number.
+   */
+  static uint32_t key(const char *id);
+
+  /**
+   * @brief Adds a queued run of a task.
+   * @param task The task key.
+   * @param run The run number (1..2^30-1).
+   * @param parent The run that requested this one, 0 for none.
+   * @return The slot index, or -1 if the table is full.
+   */
+  int claim(uint32_t task, uint32_t run, uint32_t parent);
+
+  /**
+   * @brief Changes the state of a run if it is still current in its slot.
+   * @return True if the state was changed.
+   */
+  bool setState(int slot, uint32_t run, uint8_t state);
+
+  /**
+   * @brief Removes the run of a task from the table.
+   * @param task The task key.
+   * @param run The run to remove, 0 for whatever run the task has.
+   * @return True if a run was removed.
+   */
+  bool release(uint32_t task, uint32_t run = 0);
+
+  /**
+   * @brief Records which run a run is joining.
+   * @param run The waiting run.
+   * @param waitingOn The awaited run, 0 for none.
+   */
+  void setWaiting(uint32_t run, uint32_t waitingOn);
+
+  /**
+   * @brief Gets the state of a task (TASK_STOPPED if it has no active run).
+   */
+  uint8_t state(uint32_t task) const;
+
+  /**
+   * @brief Finds the slot of a task.
+   * @return The slot index, or -1 if the task has no active run.
+   */
+  int find(uint32_t task) const;
+
+  /**
+   * @brief Checks whether a run still occupies the given slot.
+   */
+  bool isCurrent(int slot, uint32_t run) const;
+
+  /**
+   * @brief Finds the slot of an active run.
+   * @return The slot index, or -1 if the run is over.
+   */
+  int findRun(uint32_t run) const;
+
+  /**
+   * @brief Gets the task key of a slot, 0 if the slot is free.
+   */
+  uint32_t task(int slot) const { return _slots[slot].task.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Gets the run that requested the run in a slot.
+   */
+  uint32_t parent(int slot) const { return _slots[slot].parent.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Gets the run that the run in a slot is joining.
+   */
+  uint32_t waitingOn(int slot) const { return _slots[slot].waitingOn.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Counts the runs in a given state.
+   */
+  size_t count(uint8_t state) const;
+
+private:
+  /**
+   * @struct Slot
+   * @brief One active run.
+   */
+  struct Slot {
+    std::atomic<uint32_t> task;       ///< Task key, 0 if the slot is free.
+    std::atomic<uint32_t> word;       ///< Run number << 2 | TaskState.
+    std::atomic<uint32_t> parent;     ///< Requesting run, 0 for none.
+    std::atomic<uint32_t> waitingOn;  ///< Run being joined, 0 for none.
+  };
+
+  /**
+   * @brief Packs a run number and a state into a state word.
+   */
+  static uint32_t _word(uint32_t run, uint8_t state) { return (run << 2) | (state & 3); }
+
+  Slot _slots[RUN_TABLE_SIZE] = {};     ///< The table.
+};
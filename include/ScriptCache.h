@@ -0,0 +1,64 @@
+/**
+ * @file ScriptCache.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the ScriptCache class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+struct lua_State;
+
+/**
+ * @class ScriptCache
+ * @brief Precompiled Lua bytecode for task scripts.
+ *
+ * Next to every /scripts/<id>.lua source a /scripts/<id>.luac file holds the
+ * chunk produced by lua_dump(), prefixed with the FNV-1a hash of the source it
+ * was compiled from. A run whose expected source hash matches the cache header
+ * loads the bytecode directly and skips reading and compiling the source; when
+ * the hash is not known yet, e.g. after a boot, the source is only hashed. The
+ * bytecode keeps its debug info, so errors report line numbers either way.
+ */
+class ScriptCache {
+public:
+  /**
+   * @brief Computes the FNV-1a hash used to key cached bytecode.
+   * @param data The script source.
+   * @param len The length of the source in bytes.
+   * @param seed The running hash when hashing in pieces.
+   * @return The hash value.
+   */
+  static uint32_t hash(const char *data, size_t len, uint32_t seed = 2166136261u);
+
+  /**
+   * @brief Compiles a script and writes its bytecode cache.
+   * @param id The ID of the task the script belongs to.
+   * @param source The script source.
+   * @param hashOut Receives the hash of the source (never 0).
+   * @return True if the script compiled and the cache was written.
+   */
+  static bool store(const String &id, const String &source, uint32_t &hashOut);
+
+  /**
+   * @brief Loads a task script as a Lua function onto the stack of L.
+   * If @p knownHash is 0 it is computed from the source first. If it matches
+   * the cache header the bytecode is used. Otherwise the source is compiled,
+   * the cache is refreshed and @p knownHash is updated.
+   * @param L The Lua state to load into.
+   * @param id The ID of the task.
+   * @param knownHash The expected source hash, 0 if unknown.
+   * @return LUA_OK with the function on the stack, a Lua error code with the
+   *         message on the stack, or -1 if the task has no script.
+   */
+  static int load(lua_State *L, const String &id, uint32_t &knownHash);
+
+  /**
+   * @brief Removes the cached bytecode of a task.
+   * @param id The ID of the task.
+   */
+  static void remove(const String &id);
+};
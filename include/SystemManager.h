@@ -13,6 +13,26 @@
 #include <LittleFS.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
+#include <map>
+#include <memory>
+#include "AtomicFile.h"
+#include "Metrics.h"
+#include "OtaUpdater.h"
+#include "WiFiLink.h"
+
+#ifndef SYSTEM_INFO_HEAP_STEP
+#define SYSTEM_INFO_HEAP_STEP 1024 ///< Change of free heap (bytes) that makes /api/info count as changed.
+#endif
+
+#ifndef FS_UPLOAD_BUFFER
+#define FS_UPLOAD_BUFFER 4096 ///< Write buffer of a file upload; one LittleFS block.
+#endif
+
+#ifndef SYSTEM_METRICS_FS_MS
+#define SYSTEM_METRICS_FS_MS 10000 ///< How long /api/metrics reuses the LittleFS usage, which walks the filesystem.
+#endif
+
+class TaskManager;
 
 /**
  * @class SystemManager
@@ -30,6 +50,12 @@ public:
    */
   void begin();
 
+  /**
+   * @brief Connects the TaskManager used for task statistics in getInfoJSON().
+   * @param tasks A pointer to the TaskManager instance.
+   */
+  void setTaskManager(TaskManager *tasks);
+
   /**
    * @brief Gets system information as a JSON string.
    * Includes serial number, license status, heap memory, and script count.
@@ -37,6 +63,23 @@ public:
    */
   String getInfoJSON();
 
+  /**
+   * @brief Gets the version of the system part of getInfoJSON().
+   * Increases when a setting changes or the free heap has moved by at least
+   * SYSTEM_INFO_HEAP_STEP bytes since the last increase, so smaller heap
+   * fluctuations do not defeat conditional requests. The task counters are
+   * versioned by TaskManager::stateVersion().
+   */
+  uint32_t infoVersion();
+
+  /**
+   * @brief Gets the system section of /api/metrics.
+   * Reports the uptime, the heap (free, minimum ever free, largest free
+   * block), PSRAM when present, the LittleFS usage, the stack high-water
+   * marks of the firmware tasks and the dropped log lines.
+   */
+  MetricsStream::Section metricsSection();
+
   /**
    * @brief Gets system settings as a JSON string.
    * Includes software version, language, theme, license key, and auto-update status.
@@ -86,9 +129,23 @@ public:
    */
   void setAutoUpdate(bool enabled);
 
+  /**
+   * @brief Gets the firmware updater.
+   */
+  OtaUpdater& ota() { return _ota; }
+
+  /**
+   * @brief Checks whether a request carried the last firmware upload.
+   */
+  bool isOTARequest(AsyncWebServerRequest *request) const { return request == _otaRequest; }
+
   /**
    * @brief Handles OTA firmware update uploads.
    * This function is called by the web server when a file is being uploaded.
+   * Chunks are streamed into the OtaUpdater; the image size and expected digest
+   * are taken from the "size" and "sha256" parameters (query or form fields
+   * sent before the file). Only one upload runs at a time, and a dropped
+   * connection aborts it. The reboot is left to the request handler.
    * @param request The web server request object.
    * @param filename The name of the uploaded file.
    * @param index The starting index of the data chunk.
@@ -100,6 +157,9 @@ public:
 
   /**
    * @brief Handles file uploads to the LittleFS filesystem.
+   * The file stays open for the whole upload and the data is written in
+   * FS_UPLOAD_BUFFER blocks to "<name>.tmp" (see AtomicFile), which replaces
+   * the target after the last chunk. An interrupted upload leaves the target as it was.
    * @param request The web server request object.
    * @param filename The name of the uploaded file.
    * @param index The starting index of the data chunk.
@@ -109,6 +169,33 @@ public:
    */
   void handleFSUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 
+  /**
+   * @brief Checks whether the file upload of a request failed.
+   * @param request The web server request object.
+   * @return True if a file of the request could not be stored.
+   */
+  bool fsUploadFailed(AsyncWebServerRequest *request) const;
+
+  /**
+   * @brief Starts the access point and joins the saved network in the background.
+   * @param apName The SSID of the access point.
+   */
+  void beginWiFi(const String &apName);
+
+  /**
+   * @brief Saves Wi-Fi credentials and joins that network in the background.
+   * Returns at once; the progress is reported by wifi().
+   * @param ssid The Wi-Fi network SSID; empty to leave the current network.
+   * @param password The Wi-Fi network password.
+   * @return True if the credentials were saved.
+   */
+  bool connectWiFi(const String &ssid, const String &password);
+
+  /**
+   * @brief Gets the station connection.
+   */
+  WiFiLink& wifi() { return _wifi; }
+
   /**
    * @brief Saves Wi-Fi credentials to persistent storage.
    * @param ssid The Wi-Fi network SSID.
@@ -125,8 +212,43 @@ public:
   void scheduleReboot(uint32_t delaySeconds, bool graceful);
 
 private:
+  /**
+   * @struct FSUpload
+   * @brief State of a file upload, kept per request.
+   */
+  struct FSUpload {
+    std::unique_ptr<AtomicFile> file; ///< The file being written, null when none is open.
+    String path;                    ///< Target path.
+    size_t used = 0;                ///< Bytes staged in buf.
+    size_t bytes = 0;               ///< Bytes written to the file.
+    uint32_t startMs = 0;           ///< millis() when the upload started.
+    bool failed = false;            ///< The file could not be stored.
+    uint8_t buf[FS_UPLOAD_BUFFER];  ///< Staged data, written in whole blocks.
+  };
+
+  /**
+   * @brief Writes the staged data of an upload to its temp file.
+   * @return False if the write failed.
+   */
+  bool _flushFSUpload(FSUpload &up);
+
+  /**
+   * @brief Drops the upload context of a request, removing an unfinished temp file.
+   */
+  void _endFSUpload(AsyncWebServerRequest *request);
+
   Preferences _prefs;      ///< Preferences object for persistent storage.
   String _language = "en"; ///< Current system language.
   String _theme = "gp_light"; ///< Current system theme.
   String _licenseKey = ""; ///< Stored license key.
+  TaskManager *_tasks = nullptr; ///< Source of task statistics.
+  uint32_t _version = 1;   ///< Settings and info version, see infoVersion().
+  uint32_t _infoHeap = 0;  ///< Free heap when the version last increased.
+  size_t _fsTotal = 0;     ///< LittleFS capacity at the last check.
+  size_t _fsUsed = 0;      ///< LittleFS usage at the last check.
+  uint32_t _fsStamp = 0;   ///< millis() of the last LittleFS check; 0 when never checked.
+  OtaUpdater _ota;         ///< Firmware update pipeline.
+  WiFiLink _wifi;          ///< Station connection.
+  AsyncWebServerRequest *_otaRequest = nullptr; ///< Request that owns the running upload.
+  std::map<AsyncWebServerRequest*, std::unique_ptr<FSUpload>> _fsUploads; ///< File uploads in progress.
 };
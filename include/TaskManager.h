@@ -11,37 +11,246 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <freertos/FreeRTOS.h>
-#include <map>
+#include <vector>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "TaskStore.h"
+#include "LuaStatePool.h"
+#include "RunTable.h"
+#include "LuaArena.h"
+#include "EventHub.h"
+#include "Metrics.h"
+
+struct lua_Debug;
+
+#ifndef TASK_LUA_POOL_SIZE
+#define TASK_LUA_POOL_SIZE 2 ///< Lua states prepared at startup; every worker keeps one (see LuaStatePool).
+#endif
+
+#ifndef TASK_LUA_MEM_LIMIT
+#define TASK_LUA_MEM_LIMIT 65536 ///< Default Lua memory cap of a run in bytes.
+#endif
+
+#ifndef TASK_LUA_USE_PSRAM
+#define TASK_LUA_USE_PSRAM 1 ///< Place large Lua blocks in PSRAM on boards that have it.
+#endif
+
+#ifndef TASK_WORKER_COUNT
+#define TASK_WORKER_COUNT 2 ///< Default number of Lua worker threads.
+#endif
+
+#ifndef TASK_MAX_WORKERS
+#define TASK_MAX_WORKERS 4 ///< Upper bound for the number of Lua worker threads.
+#endif
+
+#ifndef TASK_QUEUE_DEPTH
+#define TASK_QUEUE_DEPTH 8 ///< Default number of run requests that may wait for a worker.
+#endif
+
+#ifndef TASK_MAX_COROUTINES
+#define TASK_MAX_COROUTINES 16 ///< Maximum number of concurrent script runs hosted by one worker.
+#endif
+
+#ifndef TASK_EXECUTOR_TICK_MS
+#define TASK_EXECUTOR_TICK_MS 250 ///< Longest time a worker with parked coroutines sleeps before checking for stopped runs.
+#endif
+
+#ifndef TASK_JOIN_POLL_MS
+#define TASK_JOIN_POLL_MS 20 ///< Interval at which a joining script checks the awaited run.
+#endif
+
+#ifndef TASK_HOOK_COUNT
+#define TASK_HOOK_COUNT 1000 ///< Lua instructions between two checks of the cancellation hook.
+#endif
+
+#ifndef TASK_TIME_SLICE_MS
+#define TASK_TIME_SLICE_MS 50 ///< Time a run may execute before the hook lets other runs of its worker continue.
+#endif
+
+#ifndef TASK_ONSTOP_BUDGET_MS
+#define TASK_ONSTOP_BUDGET_MS 500 ///< Time the onStop handler of a stopped script may run.
+#endif
+
+#ifndef TASK_WORKER_STACK
+#define TASK_WORKER_STACK 8192 ///< Stack size of a Lua worker thread in bytes.
+#endif
+
+static_assert(RUN_TABLE_SIZE < LUA_ARENA_OWNERS, "every run table slot needs its own arena owner");
 
 /**
  * @class TaskManager
  * @brief Manages tasks and their associated scripts.
  *
  * This class is responsible for creating, deleting, and managing tasks.
- * It handles the storage of task metadata and Lua scripts in the LittleFS filesystem.
+ * Task metadata is kept in a packed TaskStore database and Lua scripts in
+ * /scripts/<id>.lua on the LittleFS filesystem. The metadata is mirrored in an
+ * in-memory registry that serves all reads. Metadata changes are written through
+ * to the store, while runtime state transitions are coalesced and persisted in
+ * the background (write-behind).
+ *
+ * Scripts are executed by a fixed pool of persistent worker threads fed by a
+ * bounded run queue. Run requests beyond the queue depth are rejected. Every run
+ * is a coroutine of its worker's Lua state: delay() yields back to the worker,
+ * which keeps sleeping runs in a timer heap and executes other scripts meanwhile.
+ * A count debug hook preempts runs that exceed their time slice and cancels
+ * stopped runs, after which the script's onStop function (if any) is called.
  */
 class TaskManager {
 public:
+  /**
+   * @brief Outcome of a run request.
+   */
+  enum RunStatus : uint8_t {
+    RUN_OK = 0,          ///< The task was queued for execution.
+    RUN_NOT_FOUND,       ///< No task with this ID exists.
+    RUN_ALREADY_ACTIVE,  ///< The task is already queued or running.
+    RUN_QUEUE_FULL,      ///< The run queue is full; try again later.
+    RUN_CYCLE,           ///< The task already takes part in the chain of runs that requested it.
+    RUN_LOW_MEMORY       ///< The heap is too low or fragmented for another run (see MemoryGuard).
+  };
+
+  /**
+   * @brief Configures the worker pool. Must be called before begin().
+   * @param workers The number of worker threads (1..TASK_MAX_WORKERS).
+   * @param queueDepth The number of run requests that may wait for a worker.
+   * @param pinToCores If true, worker i is pinned to core i % portNUM_PROCESSORS.
+   */
+  void configureWorkers(uint8_t workers, uint8_t queueDepth, bool pinToCores);
+
   /**
    * @brief Initializes the TaskManager.
-   * Ensures that the required directories (/tasks, /scripts) exist in the filesystem.
+   * Ensures that the /scripts directory exists, opens the task store (migrating the
+   * legacy /tasks/<id>.json layout on first start) and loads the task registry.
+   * Script saves cut short by a reset are completed or discarded, and scripts
+   * that fail their checksum are moved to "<id>.lua.bad" and detached.
    */
   void begin();
 
+  /**
+   * @brief Rebuilds the in-memory task registry from the task store.
+   * Call this after task or script files were changed behind the TaskManager's back
+   * (e.g. through the file manager). The state of running tasks is preserved.
+   */
+  void reload();
+
+  /**
+   * @brief Writes all pending task state changes to the filesystem.
+   * Called periodically by the background persistence task and on shutdown.
+   */
+  void flush();
+
+  /**
+   * @brief Sets how often pending task state changes are flushed to the filesystem.
+   * @param ms The flush interval in milliseconds.
+   */
+  void setFlushInterval(uint32_t ms);
+
+  /**
+   * @brief Connects the event channel that receives task transitions and script logs.
+   * @param events The EventHub instance, nullptr to disconnect.
+   */
+  void setEventHub(EventHub *events) { _events = events; }
+
+  /**
+   * @brief Logs a line on behalf of the script running on a Lua thread.
+   * Records it in the log and publishes it with the task ID and run number.
+   * @param L The Lua thread calling log().
+   * @param msg The message.
+   */
+  void scriptLog(lua_State *L, const char *msg);
+
+  /**
+   * @brief Gets the time left to the onStop handler running on a Lua thread.
+   * Builtins that block instead of yielding use it to stay within the budget.
+   * @param L The Lua thread calling the builtin.
+   * @return Milliseconds left (0 if used up), or -1 if L is not running an onStop handler.
+   */
+  int32_t onStopTimeLeft(lua_State *L);
+
+  /**
+   * @brief Gets the number of tasks that have a script attached.
+   */
+  size_t scriptCount();
+
+  /**
+   * @brief Gets the number of tasks that are currently running.
+   */
+  size_t runningCount();
+
+  /**
+   * @brief Gets the /api/metrics section of the task engine: run queue and
+   * worker gauges, then per task the run count, last/average/longest run time
+   * and Lua memory peak. Each piece takes the registry lock for one task only.
+   */
+  MetricsStream::Section metricsSection();
+
+  /**
+   * @brief Gets the state version of the task list.
+   * Increases whenever a task is created, changed or deleted and on every run
+   * transition (queued, running, stopped); equal versions mean an identical
+   * /api/tasks response. Lock-free.
+   */
+  uint32_t stateVersion() const { return _version.load(std::memory_order_relaxed); }
+
   /**
    * @brief Runs a specific task.
-   * Currently, it marks the task's state as "running" in its metadata file.
+   * Marks the task as "queued" in the registry and hands it to the run queue; a
+   * worker thread picks it up and executes its Lua script. State changes reach the
+   * filesystem with the next flush.
    * @param id The unique ID of the task to run.
-   * @return True if the task was found and marked as running, false otherwise.
+   * @return True if the task was queued, false otherwise.
    */
   bool runTask(const String &id);
 
   /**
-   * @brief Gets a JSON string representing all tasks.
-   * @return A JSON array of task objects.
+   * @brief Requests a run of a task and reports why a request was refused.
+   * The request returns immediately; the run starts as soon as a worker is free
+   * and MemoryGuard admits it, or is dropped after MEM_GUARD_DEFER_MS.
+   * @param id The unique ID of the task to run.
+   * @param parentRun The run requesting the start (from a script), 0 for none.
+   *        A task that already occurs in the chain of parent runs is refused.
+   * @param runOut Receives the number of the new run (the handle of a Lua startTask()).
+   * @return RUN_OK if the task was queued, otherwise the reason for the refusal.
+   */
+  RunStatus startRun(const String &id, uint32_t parentRun = 0, uint32_t *runOut = nullptr);
+
+  /**
+   * @brief Checks whether a task is queued or running.
+   * @param id The ID of the task.
+   */
+  bool isRunning(const String &id);
+
+  /**
+   * @brief Checks whether a run is still queued or running.
+   * @param run The run number returned by startRun().
    */
-  String getTasksJSON();
+  bool isRunActive(uint32_t run);
+
+  /**
+   * @brief Records that a run waits for another one (used by the Lua join()).
+   * @param waiter The waiting run.
+   * @param run The awaited run, 0 when the wait is over.
+   * @return False if @p run directly or indirectly waits for @p waiter, i.e. the
+   *         wait would never end; nothing is recorded then.
+   */
+  bool setWaiting(uint32_t waiter, uint32_t run);
+
+  /**
+   * @brief Fills a JSON object describing one task of the registry.
+   * Used to stream the task list entry by entry; a task removed meanwhile may
+   * make a listing skip one entry.
+   * @param index The position of the task in the registry.
+   * @param obj Receives the task fields.
+   * @return False if there is no task at @p index.
+   */
+  bool getTaskEntryJSON(size_t index, JsonObject obj);
+
+  /**
+   * @brief Fills the run counters ("runningTasks" and the "queue" object) into a JSON object.
+   * Lock-free; reads the run table and the run queue only.
+   */
+  void getQueueJSON(JsonObject obj);
 
   /**
    * @brief Creates a new task with a given name.
@@ -52,6 +261,8 @@ public:
 
   /**
    * @brief Saves a script for a task and/or updates its name.
+   * The script file is replaced atomically and carries a checksum footer; a
+   * footer already at the end of @p content is dropped first.
    * @param id The ID of the task.
    * @param name The new name for the task. Can be empty if not changing the name.
    * @param content The Lua script content. Can be empty if only renaming the task.
@@ -60,7 +271,16 @@ public:
   bool saveScript(const String &id, const String &name, const String &content);
 
   /**
-   * @brief Retrieves the script content for a given task.
+   * @brief Sets the Lua memory cap of a task's runs.
+   * A run that exceeds it fails with a memory error instead of exhausting the heap.
+   * @param id The ID of the task.
+   * @param bytes The cap in bytes, 0 for TASK_LUA_MEM_LIMIT.
+   * @return True on success, false if the task is unknown or the store failed.
+   */
+  bool setMemoryLimit(const String &id, uint32_t bytes);
+
+  /**
+   * @brief Retrieves the script content for a given task, without its checksum footer.
    * @param id The ID of the task.
    * @return The script content as a String, or an empty string if not found.
    */
@@ -83,29 +303,193 @@ public:
   /**
    * @brief Gets a single task as JSON including its script content.
    * The task object contains id, name, state, hasScript, and script (the task script code).
+   * The document is only allocated if MemoryGuard admits it.
    * @param id The ID of the task.
+   * @param lowMemory Set to true if the task exists but memory was too low to build the response.
    * @return A JSON string with the task and its script, or an empty string if task not found.
    */
-  String getTaskWithScriptJSON(const String &id);
+  String getTaskWithScriptJSON(const String &id, bool *lowMemory = nullptr);
 
 private:
   /**
-   * @struct LuaTaskParams
-   * @brief Holds parameters needed to run a Lua script in a separate task.
+   * @brief Finds a task in the registry. The registry lock must be held.
+   * @param id The base ID of the task.
+   * @return Pointer to the record, or nullptr if the task is unknown.
+   */
+  TaskRecord* _findTask(const String &id);
+
+  /**
+   * @brief Gives a new registry record its run table key.
+   * A numeric ID is its own key; any other ID gets the next assigned key.
+   */
+  void _assignRunKey(TaskRecord &rec);
+
+  /**
+   * @brief Gets the run table key of a task. The registry lock must be held.
+   * @return The key, or 0 if the task is unknown.
+   */
+  uint32_t _runKey(const String &id);
+
+  /**
+   * @brief Completes interrupted script saves and retires damaged scripts.
+   * Called once at boot, after the registry is loaded.
+   */
+  void _repairScripts();
+
+  /**
+   * @brief Serializes a registry record into a JSON object.
+   */
+  void _recordToJSON(const TaskRecord &rec, JsonObject obj);
+
+  /**
+   * @brief FreeRTOS task entry point that periodically calls flush().
+   * @param pvParameters A pointer to the TaskManager instance.
+   */
+  static void _persistTask(void* pvParameters);
+
+  TaskStore _store;                      ///< Persistent task database.
+  LuaStatePool _luaPool;                 ///< Source of the workers' Lua states.
+  std::vector<TaskRecord> _tasks;        ///< In-memory task registry.
+  SemaphoreHandle_t _lock = nullptr;     ///< Guards _tasks and serializes writers of _runs.
+  SemaphoreHandle_t _flushLock = nullptr; ///< Serializes flushes against task deletion and compaction.
+  TaskHandle_t _persistHandle = nullptr; ///< Handle of the background persistence task.
+  uint32_t _flushIntervalMs = 2000;      ///< Write-behind flush interval.
+
+  struct Coroutine;
+
+  /**
+   * @struct Worker
+   * @brief A persistent Lua worker thread.
+   */
+  struct Worker {
+    TaskManager* instance;   ///< Owning TaskManager.
+    uint8_t slot;            ///< Index in _workers.
+    TaskHandle_t handle;     ///< FreeRTOS handle of the thread.
+    lua_State *host;         ///< Lua state whose threads execute the runs.
+    LuaArena *arena;         ///< Allocator of the host state; accounts memory per run.
+    Coroutine *current;      ///< Run being resumed, nullptr while idle.
+    uint32_t sliceEnd;       ///< millis() at which the current run is preempted.
+    uint32_t seenGeneration; ///< Value of _stopGeneration at the last hook check.
+  };
+
+  /**
+   * @struct RunRequest
+   * @brief Item of the run queue.
+   */
+  struct RunRequest {
+    char id[16];             ///< ID of the task to run.
+    int16_t slot;            ///< Slot of the run in _runs.
+    uint32_t run;            ///< Run number.
+  };
+
+  /**
+   * @brief Static function that serves as the FreeRTOS entry point of a worker thread.
+   * Takes run requests from the queue and executes them as coroutines, resuming
+   * sleeping runs from a timer heap.
+   * @param pvParameters A pointer to the Worker slot.
+   */
+  static void _workerTask(void* pvParameters);
+
+  /**
+   * @brief Starts (or restarts) the worker thread of a slot.
+   * @param slot The worker slot.
+   * @return True if the thread was created.
+   */
+  bool _spawnWorker(uint8_t slot);
+
+  /**
+   * @struct Coroutine
+   * @brief A script run executing as a Lua thread of its worker's host state.
    */
-  struct LuaTaskParams {
-    TaskManager* instance;
-    String taskId;
+  struct Coroutine {
+    char id[16];             ///< ID of the task.
+    uint32_t run;            ///< Run number.
+    int16_t slot;            ///< Slot of the run in _runs.
+    lua_State *thread;       ///< Lua thread executing the script.
+    int ref;                 ///< Registry reference keeping the thread alive.
+    int envRef;              ///< Registry reference to the run's environment table.
+    uint32_t wakeAt;         ///< millis() at which a sleeping run resumes.
+    bool cancelled;          ///< The run was stopped and is being released.
+    bool stopping;           ///< The onStop handler is executing.
+    uint32_t startedAt;      ///< millis() at which the run started executing.
   };
 
   /**
-   * @brief Static function that serves as a FreeRTOS task entry point to run a Lua script.
-   * @param pvParameters A void pointer to a LuaTaskParams struct.
+   * @brief Starts a queued run as a new coroutine of the host state.
+   * @param worker The worker hosting the run.
+   * @param req The run request taken from the queue.
+   * @return The coroutine with the script loaded, or nullptr if the run was dropped.
+   */
+  Coroutine* _spawnCoroutine(Worker *worker, const RunRequest &req);
+
+  /**
+   * @brief Resumes a coroutine until it yields or finishes.
+   * Finished, failed and stopped runs are released.
+   * @return True if the coroutine yielded and has to be parked until co->wakeAt.
+   */
+  bool _resumeCoroutine(Worker *worker, Coroutine *co);
+
+  /**
+   * @brief Releases the Lua thread of a coroutine and ends its run.
+   * A cancelled run gets its onStop handler called first.
+   */
+  void _finishCoroutine(Worker *worker, Coroutine *co);
+
+  /**
+   * @brief Calls the onStop function of a cancelled run's environment, if defined.
+   */
+  void _runOnStop(Worker *worker, Coroutine *co);
+
+  /**
+   * @brief Gives a worker the host state it keeps for good.
+   */
+  void _attachHost(Worker *worker);
+
+  /**
+   * @brief Count hook of every run: cancels stopped runs and preempts runs
+   * that used up their time slice by yielding them to the worker.
+   */
+  static void _hook(lua_State *L, lua_Debug *ar);
+
+  /**
+   * @brief Checks whether a coroutine still belongs to the current run of its task.
+   * Lock-free; called from the debug hook.
+   */
+  bool _isCurrentRun(const Coroutine *co) { return _runs.isCurrent(co->slot, co->run); }
+
+  /**
+   * @brief Marks a run as finished unless the task was stopped or restarted meanwhile.
+   * @param memPeak Peak Lua memory of the run, 0 if unknown.
+   * @param elapsedMs Duration of a run that executed, counted in the task's
+   *        run statistics; negative for a run that never started.
+   */
+  void _endRun(const String &taskId, uint32_t run, uint32_t memPeak = 0, int32_t elapsedMs = -1);
+
+  Worker _workers[TASK_MAX_WORKERS] = {}; ///< Worker thread slots.
+  uint8_t _workerCount = TASK_WORKER_COUNT; ///< Number of worker threads.
+  uint8_t _queueDepth = TASK_QUEUE_DEPTH; ///< Capacity of the run queue.
+  bool _pinWorkers = false;              ///< Pin workers to cores round-robin.
+  QueueHandle_t _runQueue = nullptr;     ///< Pending run requests.
+
+  RunTable _runs;                        ///< Queued and running runs; readable without the lock.
+  uint32_t _runCounter = 0;              ///< Last assigned run number (startTask() handle).
+  uint32_t _lastRunKey = 0;              ///< Last run table key assigned to a non-numeric task ID.
+  volatile uint32_t _stopGeneration = 0; ///< Incremented whenever a running task is stopped.
+  std::atomic<uint32_t> _version{1};     ///< State version, see stateVersion().
+
+  /**
+   * @brief Advances the state version after a visible change.
+   */
+  void _changed() { _version.fetch_add(1, std::memory_order_relaxed); }
+
+  /**
+   * @brief Publishes a task transition on the event channel, if connected.
    */
-  static void _luaTaskRunner(void* pvParameters);
+  void _publish(const char *id, const char *state, uint32_t run) {
+    if (_events) _events->publishTask(id, state, run);
+  }
 
-  // Map to store handles of running tasks
-  std::map<String, TaskHandle_t> _runningTasks;
+  EventHub *_events = nullptr;           ///< Receives task transitions and script logs.
 
 public:
   /**
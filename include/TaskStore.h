@@ -0,0 +1,170 @@
+/**
+ * @file TaskStore.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the TaskStore class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * @brief Runtime state of a task.
+ */
+enum TaskState : uint8_t {
+  TASK_STOPPED = 0,
+  TASK_RUNNING = 1,
+  TASK_QUEUED = 2     ///< Waiting in the run queue for a free worker.
+};
+
+/**
+ * @struct TaskRunStats
+ * @brief Counters of the finished runs of a task since boot. Not persisted.
+ */
+struct TaskRunStats {
+  uint32_t runs;       ///< Finished runs.
+  uint32_t lastMs;     ///< Duration of the last run.
+  uint32_t maxMs;      ///< Duration of the longest run.
+  uint64_t totalMs;    ///< Sum of all durations, for the average.
+  uint32_t memPeakMax; ///< Highest Lua memory peak of a run in bytes.
+};
+
+/**
+ * @struct TaskRecord
+ * @brief Compact, fixed-layout metadata of one task.
+ */
+struct TaskRecord {
+  char id[16];        ///< Task ID.
+  char name[64];      ///< Display name of the task.
+  uint8_t state;      ///< One of TaskState.
+  uint8_t savedState; ///< State last written to the task store.
+  bool hasScript;     ///< True if a script is attached to the task.
+  uint32_t scriptHash; ///< Hash of the script source as cached by ScriptCache, 0 if unknown. Not persisted.
+  uint32_t runKey;    ///< Key of the task in the run table, see RunTable::key(). Not persisted.
+  uint32_t memLimit;  ///< Lua memory cap of a run in bytes, 0 for the default.
+  uint32_t memPeak;   ///< Peak Lua memory of the last run in bytes. Not persisted.
+  TaskRunStats stats; ///< Run counters. Not persisted.
+};
+
+/**
+ * @class TaskStore
+ * @brief Packed, append-only task database in a single LittleFS file.
+ *
+ * Every change appends a fixed-size, CRC-protected record to /tasks.db; the
+ * latest record for an ID wins and delete records act as tombstones. The log
+ * is replayed on load; an in-memory set of live IDs counts the current
+ * records, and once superseded records outnumber them the log is compacted
+ * into a fresh file. On first start
+ * the legacy one-JSON-per-task layout under /tasks is migrated into the store.
+ */
+class TaskStore {
+public:
+  /**
+   * @brief Opens the store, migrating the legacy /tasks/<id>.json layout if needed.
+   * @param path The path of the database file.
+   * @return True if the store is usable, false on failure.
+   */
+  bool begin(const char *path = "/tasks.db");
+
+  /**
+   * @brief Replays the log and returns all live task records.
+   * Rebuilds the set of live IDs. Records failing their CRC are skipped and a short
+   * final record (a torn append) is dropped; the log is then compacted. If
+   * records were skipped, or the header is invalid, the file is first
+   * renamed to "<path>.bad"; with an invalid header the store starts empty.
+   * @param out Receives the live records in creation order.
+   * @return True on success, false if the file could not be read.
+   */
+  bool load(std::vector<TaskRecord> &out);
+
+  /**
+   * @brief Appends the current version of a task record.
+   * @param rec The record to store.
+   * @return True on success, false on failure.
+   */
+  bool put(const TaskRecord &rec);
+
+  /**
+   * @brief Appends several task records with a single file open.
+   * @param recs The records to store.
+   * @return True on success, false on failure.
+   */
+  bool putMany(const std::vector<TaskRecord> &recs);
+
+  /**
+   * @brief Appends a tombstone for a task.
+   * @param id The ID of the task to remove.
+   * @return True on success, false on failure.
+   */
+  bool remove(const char *id);
+
+  /**
+   * @brief Checks whether superseded records take up enough space to compact.
+   * @return True if compact() should be called.
+   */
+  bool needsCompaction() const;
+
+  /**
+   * @brief Rewrites the store so that it only contains the given records.
+   * The new file is written next to the old one and renamed over it.
+   * @param live The complete set of live records.
+   * @return True on success, false on failure.
+   */
+  bool compact(const std::vector<TaskRecord> &live);
+
+  /**
+   * @brief Gets the number of live tasks.
+   */
+  size_t size() const { return _live.size(); }
+
+private:
+  /**
+   * @struct LiveId
+   * @brief ID of a task whose latest record is a put.
+   */
+  struct LiveId {
+    char id[16];
+  };
+
+  /**
+   * @brief Imports /tasks/<id>.json into a new store and removes the legacy files.
+   * @return True if the store was created, false on failure.
+   */
+  bool _migrateLegacy();
+
+  /**
+   * @brief Appends encoded records to the log. The store lock must be held.
+   */
+  bool _append(const uint8_t *data, size_t len, size_t count);
+
+  /**
+   * @brief Rewrites the store with the given records. The store lock must be held.
+   */
+  bool _compact(const std::vector<TaskRecord> &live);
+
+  /**
+   * @brief Renames the database file to "<path>.bad". The store lock must be held.
+   */
+  void _setAside();
+
+  /**
+   * @brief Writes a complete store and renames it over the database file
+   * (see AtomicFile). The store lock must be held.
+   */
+  bool _writeFile(const std::vector<TaskRecord> &recs);
+
+  /**
+   * @brief Adds an ID to or removes it from the set of live IDs.
+   */
+  void _setLive(const char *id, bool live);
+
+  String _path;                          ///< Path of the database file.
+  std::vector<LiveId> _live;             ///< IDs of the live tasks, for the compaction threshold.
+  uint32_t _records = 0;                 ///< Number of records in the log.
+  SemaphoreHandle_t _mutex = nullptr;    ///< Serializes access to the file.
+};
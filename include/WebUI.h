@@ -10,16 +10,104 @@
 #include <Arduino.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
+#include <vector>
+
+#ifndef WEBUI_MAX_AGE
+#define WEBUI_MAX_AGE 86400 ///< Cache lifetime (seconds) of build-time assets other than HTML pages.
+#endif
+
+/**
+ * @struct WebAsset
+ * @brief A UI file embedded in flash (WEBUI_EMBED_ASSETS builds).
+ * The table is generated by scripts/compress_assets.py into WebAssets.h.
+ */
+struct WebAsset {
+  const char *path;      ///< URL path, e.g. "/app.js".
+  const char *type;      ///< MIME type.
+  const uint8_t *data;   ///< Content in PROGMEM.
+  uint32_t size;         ///< Size of the content in bytes.
+  const char *etag;      ///< Quoted content hash.
+  bool gzip;             ///< The content is gzip-compressed.
+};
 
 /**
  * @class WebUI
- * @brief Manages the setup of the web user interface.
+ * @brief Serves the web user interface.
+ *
+ * Files come from LittleFS, where the build step (scripts/compress_assets.py)
+ * stores text assets as precompressed "<name>.gz"; a plain file of the same
+ * name, e.g. one edited through the file manager, takes precedence. Builds
+ * with WEBUI_EMBED_ASSETS also serve the assets from flash when they are not
+ * on the filesystem. Responses carry a content-hash ETag and Cache-Control:
+ * build-time assets (".gz" files and embedded ones) other than HTML pages are
+ * cached for WEBUI_MAX_AGE seconds; everything else, including scripts, logs
+ * and files edited at run time, is revalidated on every load. A matching
+ * If-None-Match is answered with 304.
  */
-class WebUI {
+class WebUI : public AsyncWebHandler {
 public:
   /**
-   * @brief Initializes the web UI by setting up the static file server.
+   * @brief Initializes the web UI by registering the asset handler.
    * @param server A pointer to the AsyncWebServer instance.
    */
   void begin(AsyncWebServer *server);
+
+  /**
+   * @brief Forgets the cached content hashes, e.g. after files were changed.
+   */
+  void invalidate() { _etags.clear(); }
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  bool isRequestHandlerTrivial() override { return true; }
+
+private:
+  /**
+   * @struct ETagEntry
+   * @brief Cached content hash of a file.
+   */
+  struct ETagEntry {
+    String path;         ///< Path of the served file (possibly ending in ".gz").
+    uint32_t size;       ///< File size when hashed; a different size means a new file.
+    time_t mtime;        ///< Modification time when hashed; catches same-size edits.
+    uint32_t hash;       ///< FNV-1a hash of the content.
+  };
+
+  /**
+   * @brief Maps a request URL to an asset path ("/" becomes "/index.html").
+   */
+  static String _assetPath(const String &url);
+
+  /**
+   * @brief Finds the file serving a path: the plain file or its ".gz" variant.
+   * @return The file path, or an empty string if neither exists.
+   */
+  static String _findFile(const String &path);
+
+  /**
+   * @brief Gets the quoted content-hash ETag of a file, hashing it on first use.
+   */
+  String _fileETag(const String &file);
+
+  /**
+   * @brief Adds the caching headers for an asset and answers 304 if the client is current.
+   * @param built True for a build-time asset, which may be cached without revalidation.
+   * @return True if the request was answered with 304.
+   */
+  static bool _notModified(AsyncWebServerRequest *request, const String &path, const String &etag, bool built);
+
+  /**
+   * @brief Adds ETag and Cache-Control to a response.
+   * @param built True for a build-time asset, which may be cached without revalidation.
+   */
+  static void _cacheHeaders(AsyncWebServerResponse *response, const String &path, const String &etag, bool built);
+
+#ifdef WEBUI_EMBED_ASSETS
+  /**
+   * @brief Finds an embedded asset.
+   */
+  static const WebAsset* _findEmbedded(const String &path);
+#endif
+
+  std::vector<ETagEntry> _etags;         ///< Content hashes of files served so far.
 };
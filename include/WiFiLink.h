@@ -0,0 +1,128 @@
+/**
+ * @file WiFiLink.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Definition of the WiFiLink class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000 ///< Time an attempt may take to get an IP address.
+#endif
+
+#ifndef WIFI_BACKOFF_MIN_MS
+#define WIFI_BACKOFF_MIN_MS 2000 ///< Pause after the first failed attempt; doubles with each further failure.
+#endif
+
+#ifndef WIFI_BACKOFF_MAX_MS
+#define WIFI_BACKOFF_MAX_MS 60000 ///< Longest pause between attempts.
+#endif
+
+class EventHub;
+
+/**
+ * @brief State of the station connection.
+ */
+enum WiFiLinkState : uint8_t {
+  WIFI_LINK_IDLE = 0,       ///< No network configured.
+  WIFI_LINK_CONNECTING = 1, ///< An attempt is in progress.
+  WIFI_LINK_CONNECTED = 2,  ///< Associated and holding an IP address.
+  WIFI_LINK_BACKOFF = 3     ///< Waiting before the next attempt.
+};
+
+/**
+ * @class WiFiLink
+ * @brief Keeps the station connected to the configured network in the background.
+ *
+ * The access point stays up the whole time (AP+STA), so the device remains
+ * reachable while the station connects, retries or is misconfigured. Nothing
+ * here waits: connect() only hands the credentials over, Wi-Fi events are
+ * recorded by the event callback, and poll() advances the state machine from
+ * loop(). A failed attempt is retried after a pause that doubles up to
+ * WIFI_BACKOFF_MAX_MS; a connection that drops later is re-established the
+ * same way, indefinitely.
+ */
+class WiFiLink {
+public:
+  /**
+   * @brief Starts the access point and the station interface. Call before connect().
+   * @param apName The SSID of the access point.
+   */
+  void begin(const String &apName);
+
+  /**
+   * @brief Connects the event hub that receives "wifi" state events.
+   */
+  void setEventHub(EventHub *events) { _events = events; }
+
+  /**
+   * @brief Joins a network; returns at once. Safe to call from any task.
+   * @param ssid The network name; empty to leave the current network.
+   * @param pass The password, empty for open networks.
+   */
+  void connect(const String &ssid, const String &pass);
+
+  /**
+   * @brief Advances the state machine. Call regularly from loop().
+   */
+  void poll();
+
+  /**
+   * @brief Gets the state of the station connection.
+   */
+  WiFiLinkState state() const { return _state; }
+
+  /**
+   * @brief Fills a JSON object with the connection status.
+   * Fields: state, ssid, ip, rssi, attempts, reason (last disconnect reason),
+   * retryInMs and apIp.
+   */
+  void getStatusJSON(JsonObject out);
+
+private:
+  /**
+   * @brief Records Wi-Fi events for poll(). Runs on the Wi-Fi event task.
+   */
+  void _onEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+
+  /**
+   * @brief Starts an attempt with the current credentials.
+   */
+  void _attempt(uint32_t now);
+
+  /**
+   * @brief Drops the attempt or connection and schedules the next attempt.
+   */
+  void _retryLater(uint32_t now);
+
+  /**
+   * @brief Changes the state and publishes it.
+   */
+  void _setState(WiFiLinkState state, uint32_t now);
+
+  static const char* _stateName(WiFiLinkState state);
+
+  WiFiLinkState _state = WIFI_LINK_IDLE; ///< Written by poll() only.
+  uint32_t _stateMs = 0;             ///< millis() of the last state change.
+  uint32_t _retryMs = 0;             ///< Pause before the next attempt.
+  uint16_t _attempts = 0;            ///< Failed attempts since the last success.
+  String _ssid;                      ///< Network in use.
+  String _pass;                      ///< Its password.
+  String _nextSsid;                  ///< Network handed over by connect().
+  String _nextPass;                  ///< Its password.
+  std::atomic<bool> _pending{false}; ///< connect() was called since the last poll().
+  std::atomic<bool> _gotIp{false};   ///< The station got an IP address.
+  std::atomic<bool> _lost{false};    ///< The station was disconnected.
+  std::atomic<uint8_t> _reason{0};   ///< Reason code of the last disconnect.
+  SemaphoreHandle_t _mutex = nullptr; ///< Guards the strings.
+  EventHub *_events = nullptr;       ///< Receiver of state events.
+};
@@ -0,0 +1,140 @@
+/**
+ * @file AllocStats.cpp
+ * @author Masyukov Pavel
+ * @brief Process-wide heap allocation counters for the WASH-PRO benchmarks.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "AllocStats.h"
+#include <atomic>
+#include <cerrno>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+#endif
+
+static std::atomic<uint64_t> s_count{0};
+static std::atomic<uint64_t> s_bytes{0};
+static std::atomic<int64_t> s_live{0};
+static std::atomic<int64_t> s_peak{0};
+
+/**
+ * @brief Accounts for a new block.
+ */
+static void added(void *ptr) {
+#ifdef __GLIBC__
+  if (!ptr) return;
+  size_t size = malloc_usable_size(ptr);
+  s_count.fetch_add(1, std::memory_order_relaxed);
+  s_bytes.fetch_add(size, std::memory_order_relaxed);
+  int64_t live = s_live.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+  int64_t peak = s_peak.load(std::memory_order_relaxed);
+  while (live > peak && !s_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+#else
+  (void)ptr;
+#endif
+}
+
+/**
+ * @brief Accounts for a block about to be released.
+ */
+static void removed(void *ptr) {
+#ifdef __GLIBC__
+  if (ptr) s_live.fetch_sub((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed);
+#else
+  (void)ptr;
+#endif
+}
+
+#ifdef __GLIBC__
+extern "C" {
+
+void *malloc(size_t size) {
+  void *ptr = __libc_malloc(size);
+  added(ptr);
+  return ptr;
+}
+
+void *calloc(size_t n, size_t size) {
+  void *ptr = __libc_calloc(n, size);
+  added(ptr);
+  return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (!ptr) return malloc(size);
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+  size_t old = malloc_usable_size(ptr);
+  void *out = __libc_realloc(ptr, size);
+  if (!out) return nullptr;
+  // A resized block counts as one allocation of its new size
+  s_live.fetch_sub((int64_t)old, std::memory_order_relaxed);
+  added(out);
+  return out;
+}
+
+void free(void *ptr) {
+  removed(ptr);
+  __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  void *ptr = __libc_memalign(alignment, size);
+  added(ptr);
+  return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  void *ptr = memalign(alignment, size);
+  if (!ptr) return ENOMEM;
+  *out = ptr;
+  return 0;
+}
+
+} // extern "C"
+#endif
+
+namespace AllocStats {
+
+/**
+ * @brief Checks whether allocations are counted on this platform.
+ */
+bool enabled() {
+#ifdef __GLIBC__
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Reads the counters.
+ */
+AllocSnapshot snapshot() {
+  return AllocSnapshot{s_count.load(std::memory_order_relaxed), s_bytes.load(std::memory_order_relaxed),
+                       s_live.load(std::memory_order_relaxed), s_peak.load(std::memory_order_relaxed)};
+}
+
+/**
+ * @brief Restarts the peak from the bytes currently allocated.
+ */
+void resetPeak() {
+  s_peak.store(s_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+} // namespace AllocStats
@@ -0,0 +1,45 @@
+/**
+ * @file AllocStats.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Process-wide heap allocation counters for the WASH-PRO benchmarks.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * AllocStats.cpp replaces malloc() and friends with wrappers around the glibc
+ * allocator that count every allocation of the process, including those of
+ * the worker threads, Lua and ArduinoJson. On other C libraries the counters
+ * stay at zero.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct AllocSnapshot
+ * @brief Counter values at one point in time.
+ */
+struct AllocSnapshot {
+  uint64_t count;  ///< Allocations so far (malloc, calloc, growing realloc).
+  uint64_t bytes;  ///< Bytes allocated so far.
+  int64_t live;    ///< Bytes currently allocated.
+  int64_t peak;    ///< Highest value of live since the last resetPeak().
+};
+
+namespace AllocStats {
+  /**
+   * @brief Checks whether allocations are counted on this platform.
+   */
+  bool enabled();
+
+  /**
+   * @brief Reads the counters.
+   */
+  AllocSnapshot snapshot();
+
+  /**
+   * @brief Restarts the peak from the bytes currently allocated.
+   */
+  void resetPeak();
+}
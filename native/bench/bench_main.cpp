@@ -0,0 +1,232 @@
+/**
+ * @file bench_main.cpp
+ * @author Masyukov Pavel
+ * @brief Microbenchmarks of the task engine for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * Measures the hot paths of TaskManager on the host build across registry
+ * sizes and script sizes and writes one JSON document with ns/op, heap
+ * allocations per op and peak heap of every case:
+ *
+ *   pio run -e native-bench
+ *   .pio/build/native-bench/program -o .pio/bench.json
+ *   python3 scripts/bench_compare.py .pio/bench.json
+ *
+ * Options: -o results file (.pio/bench.json), -f run only the cases whose name
+ * contains the text, -t minimum time per case in ms (200), -q quick matrix.
+ * Allocation counts are process-wide and include the worker threads.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include <chrono>
+#include <functional>
+#include <unistd.h>
+#include <vector>
+#include "AllocStats.h"
+#include "TaskManager.h"
+#include "JsonListStream.h"
+#include "Logger.h"
+
+TaskManager tasks;
+
+static const size_t TASK_COUNTS[] = {1, 10, 100, 500};
+static const size_t SCRIPT_SIZES[] = {100, 1024, 4096, 16384, 65536};
+static const size_t QUICK_TASK_COUNTS[] = {1, 100};
+static const size_t QUICK_SCRIPT_SIZES[] = {100, 4096};
+static const uint32_t BENCH_LUA_MEM_LIMIT = 4 * 1024 * 1024; ///< Room for compiling the largest script.
+static const size_t MAX_ITERATIONS = 100000;
+
+/**
+ * @struct BenchResult
+ * @brief The figures of one case.
+ */
+struct BenchResult {
+  String name;
+  size_t tasks;
+  size_t size;
+  size_t iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+  int64_t peakHeap; ///< Highest heap growth over the start of the case, in bytes.
+};
+
+static std::vector<BenchResult> s_results;
+static uint32_t s_minTimeMs = 200;
+static const char *s_filter = nullptr;
+
+/**
+ * @brief Times an operation until the minimum time has passed.
+ * One untimed call warms caches (file buffers, compiled scripts) first.
+ */
+static void bench(const char *name, size_t taskCount, size_t size, const std::function<bool()> &op) {
+  if (s_filter && !strstr(name, s_filter)) return;
+  if (!op()) {
+    fprintf(stderr, "%-18s tasks=%-4zu size=%-6zu FAILED\n", name, taskCount, size);
+    return;
+  }
+  AllocStats::resetPeak();
+  AllocSnapshot before = AllocStats::snapshot();
+  auto start = std::chrono::steady_clock::now();
+  auto until = start + std::chrono::milliseconds(s_minTimeMs);
+  size_t n = 0;
+  std::chrono::steady_clock::time_point now;
+  do {
+    if (!op()) {
+      fprintf(stderr, "%-18s tasks=%-4zu size=%-6zu FAILED at %zu\n", name, taskCount, size, n);
+      return;
+    }
+    n++;
+    now = std::chrono::steady_clock::now();
+  } while (now < until && n < MAX_ITERATIONS);
+  AllocSnapshot after = AllocStats::snapshot();
+
+  BenchResult r;
+  r.name = name;
+  r.tasks = taskCount;
+  r.size = size;
+  r.iterations = n;
+  r.nsPerOp = std::chrono::duration<double, std::nano>(now - start).count() / n;
+  r.allocsPerOp = (double)(after.count - before.count) / n;
+  r.bytesPerOp = (double)(after.bytes - before.bytes) / n;
+  r.peakHeap = after.peak - before.live;
+  s_results.push_back(r);
+  fprintf(stderr, "%-18s tasks=%-4zu size=%-6zu %12.0f ns/op %9.1f allocs/op %11.0f B/op %9lld B peak\n",
+          name, taskCount, size, r.nsPerOp, r.allocsPerOp, r.bytesPerOp, (long long)r.peakHeap);
+}
+
+/**
+ * @brief Builds a Lua script of about @p size bytes of simple statements.
+ */
+static String makeScript(size_t size) {
+  String s;
+  s.reserve(size + 32);
+  s = "local x = 0\n";
+  while (s.length() + 10 <= size) s += "x = x + 1\n";
+  while (s.length() < size) s += " ";
+  return s;
+}
+
+/**
+ * @brief Streams the task list the way GET /api/tasks does.
+ */
+static bool listTasks() {
+  AsyncWebServerRequest request(HTTP_GET, "/api/tasks");
+  std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+  JsonListStream::send(&request, std::make_shared<JsonListStream>("tasks",
+    [next](JsonObject obj) { return tasks.getTaskEntryJSON((*next)++, obj); },
+    nullptr,
+    [](JsonObject obj) { tasks.getQueueJSON(obj); }));
+  return request.response() && request.response()->content().length() > 0;
+}
+
+/**
+ * @brief Starts a run and spins until it has finished.
+ */
+static bool runToEnd(const String &id) {
+  uint32_t run = 0;
+  if (tasks.startRun(id, 0, &run) != TaskManager::RUN_OK) return false;
+  while (tasks.isRunActive(run)) yield();
+  return true;
+}
+
+/**
+ * @brief Grows the registry to @p count tasks with small scripts.
+ */
+static bool growRegistry(std::vector<String> &ids, size_t count) {
+  static const String filler = makeScript(100);
+  while (ids.size() < count) {
+    String id = tasks.createTask(String("bench-") + (unsigned)ids.size());
+    if (id.length() == 0 || !tasks.saveScript(id, "", filler)) return false;
+    ids.push_back(id);
+  }
+  return true;
+}
+
+/**
+ * @brief Entry point.
+ */
+int main(int argc, char **argv) {
+  const char *outPath = ".pio/bench.json";
+  bool quick = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:f:t:q")) != -1) {
+    switch (opt) {
+      case 'o': outPath = optarg; break;
+      case 'f': s_filter = optarg; break;
+      case 't': s_minTimeMs = (uint32_t)strtoul(optarg, nullptr, 10); break;
+      case 'q': quick = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-o results.json] [-f filter] [-t ms] [-q]\n", argv[0]);
+        return 2;
+    }
+  }
+  std::vector<size_t> counts, sizes;
+  if (quick) {
+    counts.assign(std::begin(QUICK_TASK_COUNTS), std::end(QUICK_TASK_COUNTS));
+    sizes.assign(std::begin(QUICK_SCRIPT_SIZES), std::end(QUICK_SCRIPT_SIZES));
+  } else {
+    counts.assign(std::begin(TASK_COUNTS), std::end(TASK_COUNTS));
+    sizes.assign(std::begin(SCRIPT_SIZES), std::end(SCRIPT_SIZES));
+  }
+
+  if (!LittleFS.begin()) {
+    fprintf(stderr, "cannot mount the filesystem\n");
+    return 1;
+  }
+  LittleFS.format();
+  Logger::begin();
+  tasks.begin();
+
+  std::vector<String> ids;
+  for (size_t count : counts) {
+    if (!growRegistry(ids, count)) {
+      fprintf(stderr, "cannot create %zu tasks\n", count);
+      return 1;
+    }
+    const String &target = ids.back();
+
+    bench("list", count, 0, listTasks);
+    for (size_t size : sizes) {
+      String script = makeScript(size);
+      tasks.saveScript(target, "", script);
+      bench("get_with_script", count, size, [&]() { return tasks.getTaskWithScriptJSON(target).length() > 0; });
+      bench("save_script", count, size, [&]() { return tasks.saveScript(target, "", script); });
+    }
+
+    // Start latency: an empty script, so the time is queueing and dispatch
+    tasks.saveScript(target, "", "return");
+    bench("run_start", count, 0, [&]() { return runToEnd(target); });
+    tasks.saveScript(target, "", makeScript(100));
+  }
+
+  // Lua throughput does not depend on the registry size
+  const String &luaTask = ids.front();
+  tasks.setMemoryLimit(luaTask, BENCH_LUA_MEM_LIMIT);
+  for (size_t size : sizes) {
+    tasks.saveScript(luaTask, "", makeScript(size));
+    bench("lua_exec", ids.size(), size, [&]() { return runToEnd(luaTask); });
+  }
+  tasks.flush();
+
+  FILE *out = fopen(outPath, "w");
+  if (!out) {
+    fprintf(stderr, "cannot write %s\n", outPath);
+    return 1;
+  }
+  fprintf(out, "{\n  \"allocCounting\": %s,\n  \"minTimeMs\": %u,\n  \"results\": [\n",
+          AllocStats::enabled() ? "true" : "false", (unsigned)s_minTimeMs);
+  for (size_t i = 0; i < s_results.size(); i++) {
+    const BenchResult &r = s_results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"tasks\": %zu, \"size\": %zu, \"iterations\": %zu, "
+                 "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f, \"peak_heap\": %lld}%s\n",
+            r.name.c_str(), r.tasks, r.size, r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp,
+            (long long)r.peakHeap, i + 1 < s_results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+  fprintf(stderr, "%zu cases written to %s\n", s_results.size(), outPath);
+  return 0;
+}
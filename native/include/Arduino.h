@@ -0,0 +1,107 @@
+/**
+ * @file Arduino.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino core for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * Provides the part of the ESP32 Arduino core the firmware uses, so the
+ * managers build and run as a Linux process for profiling and tests
+ * (see [env:native] in platformio.ini). Serial writes to stdout, time comes
+ * from the monotonic clock, and FreeRTOS maps onto pthreads.
+ */
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+
+using std::max;
+using std::min;
+
+#ifndef NATIVE_HEAP_SIZE
+#define NATIVE_HEAP_SIZE (4 * 1024 * 1024) ///< Heap size reported by ESP; free heap is this minus the bytes malloc() has handed out.
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define F(string_literal) (string_literal)
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+/**
+ * @class HardwareSerial
+ * @brief The serial port; output goes to stdout, there is no input.
+ */
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * @class IPAddress
+ * @brief An IPv4 address.
+ */
+class IPAddress : public Printable {
+public:
+  IPAddress() : _addr(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t addr) : _addr(addr) {}
+  operator uint32_t() const { return _addr; }
+  uint8_t operator[](int index) const { return (uint8_t)(_addr >> (index * 8)); }
+  String toString() const;
+  size_t printTo(Print &p) const override { return p.print(toString()); }
+
+private:
+  uint32_t _addr; ///< Address in network order, as on the ESP32.
+};
+
+/**
+ * @class EspClass
+ * @brief Chip information; heap figures are derived from malloc() statistics.
+ */
+class EspClass {
+public:
+  uint32_t getHeapSize() { return NATIVE_HEAP_SIZE; }
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+  uint32_t getPsramSize() { return 0; }
+  uint32_t getFreePsram() { return 0; }
+  uint64_t getEfuseMac();
+  const char* getSdkVersion() { return "native"; }
+  void restart();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void yield();
@@ -0,0 +1,21 @@
+/**
+ * @file AsyncTCP.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the AsyncTCP library for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class AsyncClient
+ * @brief A TCP connection; the host build has no network stack.
+ */
+class AsyncClient {
+public:
+  bool connected() const { return false; }
+  void close(bool now = false) { (void)now; }
+};
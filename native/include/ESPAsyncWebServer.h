@@ -0,0 +1,378 @@
+/**
+ * @file ESPAsyncWebServer.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the ESPAsyncWebServer library for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * Requests are objects the caller builds, hands to a handler and inspects
+ * afterwards: the response the handler sent is kept, with a chunked body
+ * already drained through its filler, so request paths such as the streamed
+ * task list can be driven and profiled in-process.
+ *
+ * begin() also serves the routes over HTTP/1.0 on the port given to the
+ * constructor (WASH_HTTP_PORT overrides it), one thread per connection. As on
+ * the device, where everything runs on the async_tcp task, handlers run one at
+ * a time and every connection is closed after its response.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+#include "AsyncTCP.h"
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+class AsyncWebServerRequest;
+typedef std::function<void(void)> ArDisconnectHandler;
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+typedef std::function<String(const String&)> AwsTemplateProcessor;
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+
+/**
+ * @class AsyncWebParameter
+ * @brief A query, form or file parameter.
+ */
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool form = false, bool file = false, size_t size = 0)
+    : _name(name), _value(value), _size(size), _isForm(form), _isFile(file) {}
+  const String& name() const { return _name; }
+  const String& value() const { return _value; }
+  size_t size() const { return _size; }
+  bool isPost() const { return _isForm; }
+  bool isFile() const { return _isFile; }
+
+private:
+  String _name;
+  String _value;
+  size_t _size;
+  bool _isForm;
+  bool _isFile;
+};
+
+/**
+ * @class AsyncWebHeader
+ * @brief A request or response header.
+ */
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+  const String& name() const { return _name; }
+  const String& value() const { return _value; }
+
+private:
+  String _name;
+  String _value;
+};
+
+/**
+ * @class DefaultHeaders
+ * @brief Headers added to every response.
+ */
+class DefaultHeaders {
+public:
+  static DefaultHeaders& Instance() {
+    static DefaultHeaders instance;
+    return instance;
+  }
+  void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+  const std::vector<AsyncWebHeader>& headers() const { return _headers; }
+
+private:
+  std::vector<AsyncWebHeader> _headers;
+};
+
+/**
+ * @class AsyncWebServerResponse
+ * @brief A response with a fixed or a chunked body.
+ */
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &contentType, const String &content)
+    : _code(code), _contentType(contentType), _content(content), _headers(DefaultHeaders::Instance().headers()) {}
+  AsyncWebServerResponse(int code, const String &contentType, AwsResponseFiller filler)
+    : _code(code), _contentType(contentType), _filler(filler), _headers(DefaultHeaders::Instance().headers()) {}
+  virtual ~AsyncWebServerResponse() {}
+
+  void setCode(int code) { _code = code; }
+  void setContentType(const String &type) { _contentType = type; }
+  void setContentLength(size_t len) { (void)len; }
+  void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+
+  int code() const { return _code; }
+  const String& contentType() const { return _contentType; }
+  const std::vector<AsyncWebHeader>& headers() const { return _headers; }
+
+  /**
+   * @brief Gets a header value, empty if it was not set.
+   */
+  String header(const String &name) const;
+
+  /**
+   * @brief Gets the body; a chunked body is produced on the first call, in
+   * pieces of the size the library uses for one TCP segment.
+   */
+  const String& content();
+
+private:
+  int _code;
+  String _contentType;
+  String _content;
+  AwsResponseFiller _filler; ///< Producer of a chunked body, reset once drained.
+  std::vector<AsyncWebHeader> _headers;
+};
+
+/**
+ * @class AsyncWebServerRequest
+ * @brief A request built by the caller; keeps the response sent to it.
+ * Destroying it runs the onDisconnect handler, as closing the connection does.
+ */
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String &url) : _method(method), _url(url) {}
+  ~AsyncWebServerRequest();
+  AsyncWebServerRequest(const AsyncWebServerRequest&) = delete;
+  AsyncWebServerRequest& operator=(const AsyncWebServerRequest&) = delete;
+
+  /**
+   * @brief Adds a parameter (query by default, form with post).
+   */
+  void addParam(const String &name, const String &value, bool post = false, bool file = false) {
+    _params.emplace_back(name, value, post, file, value.length());
+  }
+
+  /**
+   * @brief Adds a request header.
+   */
+  void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+
+  /**
+   * @brief Sets the captures of a regex route, read with pathArg().
+   */
+  void setPathArgs(const std::vector<String> &args) { _pathArgs = args; }
+
+  WebRequestMethodComposite method() const { return _method; }
+  const String& url() const { return _url; }
+  const String& pathArg(size_t i) const;
+
+  size_t params() const { return _params.size(); }
+  bool hasParam(const String &name, bool post = false, bool file = false) const { return getParam(name, post, file) != nullptr; }
+  AsyncWebParameter* getParam(const String &name, bool post = false, bool file = false) const;
+  bool hasArg(const char *name) const;
+  const String& arg(const String &name) const;
+
+  bool hasHeader(const String &name) const { return getHeader(name) != nullptr; }
+  AsyncWebHeader* getHeader(const String &name) const;
+  const String& header(const char *name) const;
+
+  void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+
+  AsyncWebServerResponse* beginResponse(int code, const String &contentType = String(), const String &content = String()) {
+    return new AsyncWebServerResponse(code, contentType, content);
+  }
+  AsyncWebServerResponse* beginChunkedResponse(const String &contentType, AwsResponseFiller callback, AwsTemplateProcessor templateCallback = nullptr) {
+    (void)templateCallback;
+    return new AsyncWebServerResponse(200, contentType, callback);
+  }
+  AsyncWebServerResponse* beginResponse(File content, const String &path, const String &contentType = String(), bool download = false);
+  AsyncWebServerResponse* beginResponse(fs::FS &fs, const String &path, const String &contentType = String(), bool download = false);
+  AsyncWebServerResponse* beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len) {
+    return new AsyncWebServerResponse(code, contentType, String((const char*)content, (unsigned int)len));
+  }
+  void send(AsyncWebServerResponse *response) { _response.reset(response); }
+  void send(fs::FS &fs, const String &path, const String &contentType = String(), bool download = false) {
+    send(beginResponse(fs, path, contentType, download));
+  }
+  void send(int code, const String &contentType = String(), const String &content = String()) {
+    send(beginResponse(code, contentType, content));
+  }
+
+  /**
+   * @brief Gets the response sent to this request, nullptr if there was none.
+   */
+  AsyncWebServerResponse* response() const { return _response.get(); }
+
+  void *_tempObject = nullptr;
+
+private:
+  WebRequestMethodComposite _method;
+  String _url;
+  mutable std::list<AsyncWebParameter> _params; ///< A list, so getParam() pointers stay valid.
+  mutable std::list<AsyncWebHeader> _headers;
+  std::vector<String> _pathArgs; ///< Captures of a regex route.
+  ArDisconnectHandler _onDisconnect;
+  std::unique_ptr<AsyncWebServerResponse> _response;
+};
+
+/**
+ * @class AsyncWebHandler
+ * @brief Base of request handlers.
+ */
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) { (void)request; return false; }
+  virtual void handleRequest(AsyncWebServerRequest *request) { (void)request; }
+  virtual void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+    (void)request; (void)filename; (void)index; (void)data; (void)len; (void)final;
+  }
+  virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    (void)request; (void)data; (void)len; (void)index; (void)total;
+  }
+  virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+/**
+ * @class AsyncCallbackWebHandler
+ * @brief A route registered with AsyncWebServer::on().
+ * Matches like the library: "^...$" is a regex whose groups become path
+ * arguments, a star and an extension after the slash match the extension, a
+ * trailing star a prefix, and anything else the path and the paths below it.
+ */
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+  void setUri(const String &uri) { _uri = uri; }
+  void setMethod(WebRequestMethodComposite method) { _method = method; }
+  void onRequest(ArRequestHandlerFunction fn) { _onRequest = fn; }
+  void onUpload(ArUploadHandlerFunction fn) { _onUpload = fn; }
+  void onBody(ArBodyHandlerFunction fn) { _onBody = fn; }
+  bool hasUpload() const { return (bool)_onUpload; }
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) override;
+  void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+  bool isRequestHandlerTrivial() override { return !_onBody && !_onUpload; }
+
+private:
+  String _uri;
+  WebRequestMethodComposite _method = HTTP_ANY;
+  ArRequestHandlerFunction _onRequest;
+  ArUploadHandlerFunction _onUpload;
+  ArBodyHandlerFunction _onBody;
+};
+
+/**
+ * @class AsyncEventSourceClient
+ * @brief A connected Server-Sent Events client.
+ */
+class AsyncEventSourceClient {
+public:
+  void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0) {
+    (void)message; (void)event; (void)id; (void)reconnect;
+  }
+  uint32_t lastId() const { return 0; }
+  size_t packetsWaiting() const { return 0; }
+};
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+/**
+ * @class AsyncEventSource
+ * @brief A Server-Sent Events endpoint; nobody can subscribe on the host.
+ */
+class AsyncEventSource : public AsyncWebHandler {
+public:
+  explicit AsyncEventSource(const String &url) : _url(url) {}
+  const char* url() const { return _url.c_str(); }
+  void onConnect(ArEventHandlerFunction cb) { _connect = cb; }
+  void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0) {
+    (void)message; (void)event; (void)id; (void)reconnect;
+  }
+  size_t count() const { return 0; }
+  size_t avgPacketsWaiting() const { return 0; }
+
+private:
+  String _url;
+  ArEventHandlerFunction _connect;
+};
+
+/**
+ * @class AsyncWebServer
+ * @brief The server; dispatch() hands a request to the first handler that takes it.
+ */
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port) : _port(port) {}
+  ~AsyncWebServer();
+
+  /**
+   * @brief Starts serving HTTP in a background thread.
+   */
+  void begin();
+  void end();
+
+  AsyncWebHandler& addHandler(AsyncWebHandler *handler) { _handlers.push_back(handler); return *handler; }
+  bool removeHandler(AsyncWebHandler *handler);
+
+  AsyncCallbackWebHandler& on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr);
+  AsyncCallbackWebHandler& on(const char *uri, ArRequestHandlerFunction onRequest) { return on(uri, HTTP_ANY, onRequest); }
+  void onNotFound(ArRequestHandlerFunction fn) { _onNotFound = fn; }
+
+  /**
+   * @brief Receives the file parts of requests whose route has no upload handler.
+   */
+  void onFileUpload(ArUploadHandlerFunction fn) { _onFileUpload = fn; }
+  void onRequestBody(ArBodyHandlerFunction fn) { _onRequestBody = fn; }
+
+  /**
+   * @brief Finds the handler of a request, filling its path arguments.
+   * @return nullptr if no handler takes it.
+   */
+  AsyncWebHandler* attach(AsyncWebServerRequest *request);
+
+  /**
+   * @brief Passes a file part to the handler of a request, or to onFileUpload().
+   */
+  void upload(AsyncWebHandler *handler, AsyncWebServerRequest *request, const String &filename,
+              size_t index, uint8_t *data, size_t len, bool final);
+
+  /**
+   * @brief Passes a raw body to the handler of a request, or to onRequestBody().
+   */
+  void body(AsyncWebHandler *handler, AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+  /**
+   * @brief Runs the first handler that accepts the request, or the onNotFound() handler.
+   * @return False if no handler did.
+   */
+  bool dispatch(AsyncWebServerRequest *request);
+
+private:
+  /**
+   * @brief Accepts connections until end().
+   */
+  void _listen();
+
+  /**
+   * @brief Reads one request from a connection, answers it and closes the connection.
+   */
+  void _serve(int fd);
+
+  uint16_t _port;
+  int _fd = -1; ///< Listening socket.
+  std::vector<AsyncWebHandler*> _handlers;
+  std::vector<std::unique_ptr<AsyncCallbackWebHandler>> _routes; ///< Handlers created by on().
+  ArRequestHandlerFunction _onNotFound;
+  ArUploadHandlerFunction _onFileUpload;
+  ArBodyHandlerFunction _onRequestBody;
+};
@@ -0,0 +1,47 @@
+/**
+ * @file LittleFS.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the LittleFS filesystem for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include "FS.h"
+
+#ifndef NATIVE_FS_ROOT
+#define NATIVE_FS_ROOT ".pio/native_fs" ///< Host directory mounted as LittleFS unless WASH_FS_ROOT is set.
+#endif
+
+#ifndef NATIVE_FS_SIZE
+#define NATIVE_FS_SIZE 0x160000 ///< Capacity reported by totalBytes(); the size of the default esp32dev partition.
+#endif
+
+namespace fs {
+
+/**
+ * @class LittleFSFS
+ * @brief LittleFS backed by a host directory.
+ *
+ * The directory is taken from the environment variable WASH_FS_ROOT, else
+ * NATIVE_FS_ROOT, and is created on begin(). Writes are ordinary file writes,
+ * so the crash-safety of AtomicFile rests on rename() as on the device.
+ */
+class LittleFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char *partitionLabel = "spiffs");
+  void end() { _root.clear(); }
+  bool format();
+  size_t totalBytes() { return _root.empty() ? 0 : NATIVE_FS_SIZE; }
+  size_t usedBytes();
+
+  /**
+   * @brief Gets the host directory, empty while not mounted.
+   */
+  const char* root() const { return _root.c_str(); }
+};
+
+} // namespace fs
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,58 @@
+/**
+ * @file Preferences.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Preferences class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @class Preferences
+ * @brief NVS key-value storage, kept in memory for the life of the process.
+ * Instances opened on the same namespace see the same values, as with NVS.
+ */
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partitionLabel = nullptr);
+  void end() { _ns.clear(); }
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putBool(const char *key, bool value) { return _put(key, &value, sizeof(value)); }
+  size_t putUChar(const char *key, uint8_t value) { return _put(key, &value, sizeof(value)); }
+  size_t putInt(const char *key, int32_t value) { return _put(key, &value, sizeof(value)); }
+  size_t putUInt(const char *key, uint32_t value) { return _put(key, &value, sizeof(value)); }
+  size_t putULong64(const char *key, uint64_t value) { return _put(key, &value, sizeof(value)); }
+  size_t putString(const char *key, const char *value) { return value ? _put(key, value, strlen(value)) : 0; }
+  size_t putString(const char *key, const String &value) { return _put(key, value.c_str(), value.length()); }
+  size_t putBytes(const char *key, const void *value, size_t len) { return _put(key, value, len); }
+
+  bool getBool(const char *key, bool defaultValue = false) { _get(key, &defaultValue, sizeof(defaultValue)); return defaultValue; }
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { _get(key, &defaultValue, sizeof(defaultValue)); return defaultValue; }
+  int32_t getInt(const char *key, int32_t defaultValue = 0) { _get(key, &defaultValue, sizeof(defaultValue)); return defaultValue; }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { _get(key, &defaultValue, sizeof(defaultValue)); return defaultValue; }
+  uint64_t getULong64(const char *key, uint64_t defaultValue = 0) { _get(key, &defaultValue, sizeof(defaultValue)); return defaultValue; }
+  String getString(const char *key, const String &defaultValue = String());
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  /**
+   * @brief Stores a value.
+   * @return The number of bytes stored, 0 if the namespace is not open for writing.
+   */
+  size_t _put(const char *key, const void *value, size_t len);
+
+  /**
+   * @brief Copies a value of exactly len bytes; leaves out untouched if there is none.
+   */
+  bool _get(const char *key, void *out, size_t len);
+
+  std::string _ns;        ///< Open namespace, empty when closed.
+  bool _readOnly = false; ///< Opened read-only.
+};
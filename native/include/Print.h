@@ -0,0 +1,85 @@
+/**
+ * @file Print.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Print and Stream classes for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "WString.h"
+
+class Print;
+
+/**
+ * @class Printable
+ * @brief An object that can print itself.
+ */
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+/**
+ * @class Print
+ * @brief Byte sink with the formatting helpers of the Arduino core.
+ */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(int value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned int value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(long long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned long long value, int base = 10) { return print(String(value, (unsigned char)base)); }
+  size_t print(double value, int digits = 2) { return print(String(value, (unsigned int)digits)); }
+  size_t print(const Printable &p) { return p.printTo(*this); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value) { size_t n = print(value); return n + println(); }
+  template <typename T>
+  size_t println(const T &value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+/**
+ * @class Stream
+ * @brief Byte source with the parsing helpers of the Arduino core.
+ * Reads do not wait for data: on the host a source that has nothing more
+ * to give has reached its end.
+ */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char*)buffer, length); }
+  virtual String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  unsigned long _timeout = 1000; ///< Kept for API compatibility only.
+};
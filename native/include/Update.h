@@ -0,0 +1,39 @@
+/**
+ * @file Update.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Update class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_NO_PARTITION 10
+
+/**
+ * @class UpdateClass
+ * @brief Firmware updater; the host has no update partition, so begin() fails.
+ */
+class UpdateClass {
+public:
+  bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH, int ledPin = -1, uint8_t ledOn = 0, const char *label = nullptr);
+  size_t write(uint8_t *data, size_t len);
+  bool end(bool evenIfRemaining = false);
+  void abort() {}
+  bool isRunning() const { return false; }
+  bool hasError() const { return _error != UPDATE_ERROR_OK; }
+  uint8_t getError() const { return _error; }
+  const char* errorString() const;
+
+private:
+  uint8_t _error = UPDATE_ERROR_OK; ///< Last error.
+};
+
+extern UpdateClass Update;
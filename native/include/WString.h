@@ -0,0 +1,140 @@
+/**
+ * @file WString.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino String class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class String
+ * @brief The Arduino String API on top of std::string.
+ *
+ * Only the members the firmware and ArduinoJson use are provided; they behave
+ * like the ESP32 core's, including substring() and indexOf() clamping out of
+ * range positions instead of throwing.
+ */
+class String {
+public:
+  String(const char *cstr = "") : _s(cstr ? cstr : "") {}
+  String(const char *cstr, unsigned int length) : _s(cstr ? cstr : "", cstr ? length : 0) {}
+  String(const std::string &str) : _s(str) {}
+  String(const String &str) = default;
+  String(String &&str) = default;
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  String& operator=(const String &rhs) = default;
+  String& operator=(String &&rhs) = default;
+  String& operator=(const char *cstr) { _s = cstr ? cstr : ""; return *this; }
+
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool isEmpty() const { return _s.empty(); }
+  const char* c_str() const { return _s.c_str(); }
+  bool reserve(unsigned int size) { _s.reserve(size); return true; }
+  void clear() { _s.clear(); }
+
+  bool concat(const String &str) { _s += str._s; return true; }
+  bool concat(const char *cstr) { if (!cstr) return false; _s += cstr; return true; }
+  bool concat(const char *cstr, unsigned int length) { if (!cstr) return false; _s.append(cstr, length); return true; }
+  bool concat(char c) { _s += c; return true; }
+  bool concat(unsigned char value) { return concat(String(value)); }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  bool concat(long long value) { return concat(String(value)); }
+  bool concat(unsigned long long value) { return concat(String(value)); }
+  bool concat(float value) { return concat(String(value)); }
+  bool concat(double value) { return concat(String(value)); }
+
+  template <typename T>
+  String& operator+=(const T &rhs) { concat(rhs); return *this; }
+  String& operator+=(const char *cstr) { concat(cstr); return *this; }
+
+  bool equals(const String &str) const { return _s == str._s; }
+  bool equals(const char *cstr) const { return _s == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String &str) const;
+  int compareTo(const String &str) const { return _s.compare(str._s); }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const { return _s < rhs._s; }
+  bool operator>(const String &rhs) const { return _s > rhs._s; }
+  bool operator<=(const String &rhs) const { return _s <= rhs._s; }
+  bool operator>=(const String &rhs) const { return _s >= rhs._s; }
+
+  bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+  bool startsWith(const String &prefix, unsigned int offset) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+  void setCharAt(unsigned int index, char c) { if (index < _s.size()) _s[index] = c; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index);
+  void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {
+    getBytes((unsigned char*)buf, bufsize, index);
+  }
+  char* begin() { return &_s[0]; }
+  char* end() { return &_s[0] + _s.size(); }
+  const char* begin() const { return _s.data(); }
+  const char* end() const { return _s.data() + _s.size(); }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const { return _find(_s.find(c, fromIndex)); }
+  int indexOf(const String &str, unsigned int fromIndex = 0) const { return _find(_s.find(str._s, fromIndex)); }
+  int lastIndexOf(char c) const { return _find(_s.rfind(c)); }
+  int lastIndexOf(char c, unsigned int fromIndex) const { return _find(_s.rfind(c, fromIndex)); }
+  int lastIndexOf(const String &str) const { return _find(_s.rfind(str._s)); }
+  int lastIndexOf(const String &str, unsigned int fromIndex) const { return _find(_s.rfind(str._s, fromIndex)); }
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, length()); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String &find, const String &replace);
+  void remove(unsigned int index) { if (index < _s.size()) _s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < _s.size()) _s.erase(index, count); }
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+private:
+  static int _find(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+
+  std::string _s; ///< The characters; always valid, so no String is ever "invalid".
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+String operator+(const String &lhs, unsigned char rhs);
+String operator+(const String &lhs, int rhs);
+String operator+(const String &lhs, unsigned int rhs);
+String operator+(const String &lhs, long rhs);
+String operator+(const String &lhs, unsigned long rhs);
+String operator+(const String &lhs, long long rhs);
+String operator+(const String &lhs, unsigned long long rhs);
+String operator+(const String &lhs, float rhs);
+String operator+(const String &lhs, double rhs);
+inline bool operator==(const char *lhs, const String &rhs) { return rhs == lhs; }
+inline bool operator!=(const char *lhs, const String &rhs) { return rhs != lhs; }
@@ -0,0 +1,100 @@
+/**
+ * @file WiFi.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino WiFi class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_MODE_NULL = 0,
+  WIFI_MODE_STA,
+  WIFI_MODE_AP,
+  WIFI_MODE_APSTA
+} wifi_mode_t;
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_STA_START = 2,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP = 8,
+  ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+typedef size_t wifi_event_id_t;
+
+/**
+ * @class WiFiClass
+ * @brief Simulated radio: the access point is always up and the station joins
+ * at once, raising the same events as the ESP32 core.
+ *
+ * If the environment variable WASH_WIFI_SSID is set, only that network
+ * "exists"; joining another one fails with reason 201 (no AP found), which
+ * exercises the retry path.
+ */
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t mode) { _mode = mode; return true; }
+  wifi_mode_t getMode() const { return _mode; }
+  void persistent(bool persistent) { (void)persistent; }
+  bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+  bool softAP(const char *ssid, const char *passphrase = nullptr, int channel = 1, int ssidHidden = 0, int maxConnection = 4);
+  IPAddress softAPIP() const { return IPAddress(192, 168, 4, 1); }
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  wl_status_t status() const { return _status; }
+  bool isConnected() const { return _status == WL_CONNECTED; }
+  IPAddress localIP() const { return isConnected() ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+  String SSID() const { return _ssid; }
+  int8_t RSSI() const { return isConnected() ? -55 : 0; }
+  wifi_event_id_t onEvent(WiFiEventFuncCb cbEvent, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+private:
+  /**
+   * @brief Calls the handlers registered for an event.
+   */
+  void _raise(arduino_event_id_t event, uint8_t reason = 0);
+
+  wifi_mode_t _mode = WIFI_MODE_NULL;   ///< Current mode.
+  wl_status_t _status = WL_DISCONNECTED; ///< Station status.
+  String _ssid;                         ///< Network joined.
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,29 @@
+/**
+ * @file esp_system.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the ESP-IDF system API for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <cstdint>
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+/**
+ * @brief Registers a function esp_restart() calls before restarting.
+ */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+
+/**
+ * @brief Runs the shutdown handlers and ends the process with exit code 0;
+ * a supervisor (or the benchmark script) starts it again if it wants a reboot.
+ */
+[[noreturn]] void esp_restart(void);
+
+uint32_t esp_random(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
@@ -0,0 +1,16 @@
+/**
+ * @file esp_timer.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the ESP-IDF high resolution timer for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Gets the microseconds since start; does not wrap like micros().
+ */
+int64_t esp_timer_get_time();
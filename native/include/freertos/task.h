@@ -0,0 +1,57 @@
+/**
+ * @file task.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the FreeRTOS task API for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct NativeTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void *pvParameters);
+
+/**
+ * @brief Starts a detached pthread. Priority is ignored and the stack depth is only
+ * recorded: host frames are larger than Xtensa ones, so the threads get the
+ * default stack.
+ */
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+
+/**
+ * @brief Like xTaskCreate(); the core affinity is ignored.
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID);
+
+/**
+ * @brief Ends the calling task (nullptr) or cancels another one.
+ */
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+
+void vTaskDelay(TickType_t xTicksToDelay);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+/**
+ * @brief Gets the name of a task; the main thread is "loopTask" as on the ESP32.
+ */
+const char* pcTaskGetName(TaskHandle_t xTaskToQuery);
+
+/**
+ * @brief Finds a running task by name; nullptr if there is none.
+ */
+TaskHandle_t xTaskGetHandle(const char *pcNameToQuery);
+
+/**
+ * @brief Gets the stack depth the task was created with: stack use is not
+ * measured on the host, host threads have stacks of their own size.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
@@ -0,0 +1,21 @@
+/**
+ * @file lua.hpp
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the Lua binding for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * On the device <lua/lua.hpp> comes from the Arduino-Lua library; the host
+ * build links the system Lua 5.3 instead (Debian/Ubuntu: liblua5.3-dev).
+ * Both are stock 5.3, so scripts behave the same; lua_Integer is 64-bit on
+ * the host, and bytecode cached by the device is rejected there, after which
+ * ScriptCache recompiles from the source.
+ */
+#pragma once
+
+#if __has_include(<lua5.3/lua.hpp>)
+#include <lua5.3/lua.hpp>
+#else
+#include <lua.hpp>
+#endif
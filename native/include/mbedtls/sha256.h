@@ -0,0 +1,28 @@
+/**
+ * @file sha256.h
+ * @note This file is part of the WASH-PRO-CORE project.
+ * @author Masyukov Pavel
+ * @brief Host shim of the mbedTLS SHA-256 API for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief State of a SHA-256 computation.
+ */
+typedef struct {
+  uint32_t total[2];     ///< Bytes processed (low, high word).
+  uint32_t state[8];     ///< Intermediate digest.
+  unsigned char buffer[64]; ///< Block being filled.
+  int is224;             ///< Computing SHA-224 instead.
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output);
@@ -0,0 +1,23 @@
+/**
+ * @file arduino_main.cpp
+ * @author Masyukov Pavel
+ * @brief Host entry point of the firmware for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * Runs setup() and loop() of src/main.cpp as the ESP32 core does, so the whole
+ * firmware, web server included, serves HTTP from a Linux process; see
+ * [env:native-server] in platformio.ini.
+ */
+#include <Arduino.h>
+
+void setup();
+void loop();
+
+/**
+ * @brief Entry point.
+ */
+int main() {
+  setup();
+  for (;;) loop();
+}
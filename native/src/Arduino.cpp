@@ -0,0 +1,145 @@
+/**
+ * @file Arduino.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino core for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Arduino.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <chrono>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sched.h>
+#include <thread>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const auto s_boot = std::chrono::steady_clock::now(); ///< Reference point of millis().
+static std::atomic<uint32_t> s_minFreeHeap{NATIVE_HEAP_SIZE};
+
+/**
+ * @brief Writes a byte to stdout.
+ */
+size_t HardwareSerial::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+/**
+ * @brief Writes a buffer to stdout.
+ */
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+/**
+ * @brief Flushes stdout.
+ */
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+/**
+ * @brief Formats the address in dotted notation.
+ */
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buf);
+}
+
+/**
+ * @brief Gets the free heap: the reported size minus what malloc() has handed out.
+ */
+uint32_t EspClass::getFreeHeap() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  size_t used = info.uordblks + info.hblkhd;
+#else
+  size_t used = 0; // no allocator statistics on this libc
+#endif
+  uint32_t avail = used >= NATIVE_HEAP_SIZE ? 0 : NATIVE_HEAP_SIZE - (uint32_t)used;
+  uint32_t low = s_minFreeHeap.load();
+  while (avail < low && !s_minFreeHeap.compare_exchange_weak(low, avail)) {}
+  return avail;
+}
+
+/**
+ * @brief Gets the lowest free heap seen by getFreeHeap().
+ */
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return s_minFreeHeap.load();
+}
+
+/**
+ * @brief Gets a MAC-like number derived from the host ID.
+ */
+uint64_t EspClass::getEfuseMac() {
+  return ((uint64_t)gethostid() << 16 | 0x5E) & 0xFFFFFFFFFFFFULL;
+}
+
+/**
+ * @brief Restarts the chip; on the host the process exits.
+ */
+void EspClass::restart() {
+  esp_restart();
+}
+
+/**
+ * @brief Gets the milliseconds since start.
+ */
+unsigned long millis() {
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - s_boot).count();
+}
+
+/**
+ * @brief Gets the microseconds since start.
+ */
+unsigned long micros() {
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - s_boot).count();
+}
+
+/**
+ * @brief Gets the microseconds since start.
+ */
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_boot).count();
+}
+
+/**
+ * @brief Sleeps; delay(0) only yields.
+ */
+void delay(uint32_t ms) {
+  if (ms == 0) sched_yield();
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/**
+ * @brief Lets other threads run.
+ */
+void yield() {
+  sched_yield();
+}
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+/**
+ * @brief Copies a string with truncation; glibc gained it only in 2.38.
+ */
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
@@ -0,0 +1,622 @@
+/**
+ * @file ESPAsyncWebServer.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the ESPAsyncWebServer library for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "ESPAsyncWebServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <regex>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+static const size_t CHUNK_SIZE = 1460;              ///< One TCP segment, the size the library asks fillers for.
+static const size_t MAX_HEADER_SIZE = 8192;         ///< Longest request line plus headers.
+static const size_t MAX_BODY_SIZE = 4 * 1024 * 1024; ///< Largest accepted request body.
+static const int RECV_TIMEOUT_S = 10;               ///< A client silent for this long is dropped.
+
+static std::mutex s_asyncTcp; ///< Handlers run one at a time, as on the single async_tcp task.
+
+/**
+ * @brief Gets a header value.
+ */
+String AsyncWebServerResponse::header(const String &name) const {
+  for (const AsyncWebHeader &h : _headers) {
+    if (h.name().equalsIgnoreCase(name)) return h.value();
+  }
+  return String();
+}
+
+/**
+ * @brief Gets the body, draining a chunked body on the first call.
+ */
+const String& AsyncWebServerResponse::content() {
+  if (_filler) {
+    uint8_t buf[CHUNK_SIZE];
+    size_t index = 0, n;
+    while ((n = _filler(buf, sizeof(buf), index)) > 0) {
+      _content.concat((const char*)buf, (unsigned int)n);
+      index += n;
+    }
+    _filler = nullptr;
+  }
+  return _content;
+}
+
+/**
+ * @brief Guesses the content type from the file extension, as the library does.
+ */
+static String contentTypeFor(const String &path) {
+  static const char *const TYPES[][2] = {
+    {".html", "text/html"}, {".htm", "text/html"}, {".css", "text/css"}, {".json", "application/json"},
+    {".js", "application/javascript"}, {".png", "image/png"}, {".gif", "image/gif"}, {".jpg", "image/jpeg"},
+    {".ico", "image/x-icon"}, {".svg", "image/svg+xml"}, {".eot", "font/eot"}, {".woff", "font/woff"},
+    {".woff2", "font/woff2"}, {".ttf", "font/ttf"}, {".xml", "text/xml"}, {".pdf", "application/pdf"},
+    {".zip", "application/zip"}, {".gz", "application/x-gzip"},
+  };
+  for (const auto &t : TYPES) {
+    if (path.endsWith(t[0])) return t[1];
+  }
+  return "text/plain";
+}
+
+/**
+ * @brief Runs the disconnect handler.
+ */
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  if (_onDisconnect) _onDisconnect();
+}
+
+/**
+ * @brief Gets a capture of a regex route, empty if there is none.
+ */
+const String& AsyncWebServerRequest::pathArg(size_t i) const {
+  static const String empty;
+  return i < _pathArgs.size() ? _pathArgs[i] : empty;
+}
+
+/**
+ * @brief Answers with an open file. A ".gz" file served under its plain name
+ * gets Content-Encoding: gzip.
+ */
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(File content, const String &path, const String &contentType, bool download) {
+  AsyncWebServerResponse *response = new AsyncWebServerResponse(200, contentType.length() ? contentType : contentTypeFor(path),
+    [content](uint8_t *buf, size_t maxLen, size_t index) mutable {
+      (void)index;
+      return content.read(buf, maxLen);
+    });
+  if (!download && String(content.name()).endsWith(".gz") && !path.endsWith(".gz")) {
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  String filename = path.substring(path.lastIndexOf('/') + 1);
+  response->addHeader("Content-Disposition", String(download ? "attachment" : "inline") + "; filename=\"" + filename + "\"");
+  return response;
+}
+
+/**
+ * @brief Answers with a file by path, preferring a compressed copy.
+ */
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(fs::FS &fs, const String &path, const String &contentType, bool download) {
+  if (!download && fs.exists(path + ".gz")) return beginResponse(fs.open(path + ".gz", "r"), path, contentType, download);
+  File content = fs.open(path, "r");
+  if (!content) return beginResponse(404);
+  return beginResponse(content, path, contentType, download);
+}
+
+/**
+ * @brief Finds a parameter by name and kind.
+ */
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  for (AsyncWebParameter &p : _params) {
+    if (p.name() == name && p.isPost() == post && p.isFile() == file) return &p;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Checks for a query or form parameter.
+ */
+bool AsyncWebServerRequest::hasArg(const char *name) const {
+  for (const AsyncWebParameter &p : _params) {
+    if (!p.isFile() && p.name() == name) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Gets a query or form parameter, empty if missing.
+ */
+const String& AsyncWebServerRequest::arg(const String &name) const {
+  static const String empty;
+  for (const AsyncWebParameter &p : _params) {
+    if (!p.isFile() && p.name() == name) return p.value();
+  }
+  return empty;
+}
+
+/**
+ * @brief Finds a header, ignoring case.
+ */
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String &name) const {
+  for (AsyncWebHeader &h : _headers) {
+    if (h.name().equalsIgnoreCase(name)) return &h;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Gets a header value, empty if missing.
+ */
+const String& AsyncWebServerRequest::header(const char *name) const {
+  static const String empty;
+  AsyncWebHeader *h = getHeader(name);
+  return h ? h->value() : empty;
+}
+
+/**
+ * @brief Checks the method and the path of a request against the route.
+ */
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (!_onRequest || !(_method & request->method())) return false;
+  const String &url = request->url();
+  if (_uri.startsWith("^") && _uri.endsWith("$")) {
+    std::regex pattern(_uri.c_str());
+    std::cmatch matches;
+    if (!std::regex_search(url.c_str(), matches, pattern)) return false;
+    std::vector<String> args;
+    for (size_t i = 1; i < matches.size(); i++) args.push_back(String(matches[i].str()));
+    request->setPathArgs(args);
+    return true;
+  }
+  if (_uri.startsWith("/*.")) return url.endsWith(_uri.substring(_uri.lastIndexOf('.')));
+  if (_uri.endsWith("*")) return url.startsWith(_uri.substring(0, _uri.length() - 1));
+  return _uri.length() == 0 || _uri == url || url.startsWith(_uri + "/");
+}
+
+/**
+ * @brief Runs the request callback.
+ */
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  if (_onRequest) _onRequest(request);
+  else request->send(500);
+}
+
+/**
+ * @brief Runs the upload callback.
+ */
+void AsyncCallbackWebHandler::handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+  if (_onUpload) _onUpload(request, filename, index, data, len, final);
+}
+
+/**
+ * @brief Runs the body callback.
+ */
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (_onBody) _onBody(request, data, len, index, total);
+}
+
+/**
+ * @brief Stops serving.
+ */
+AsyncWebServer::~AsyncWebServer() {
+  end();
+}
+
+/**
+ * @brief Registers a route.
+ */
+AsyncCallbackWebHandler& AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                            ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+  AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler();
+  handler->setUri(uri);
+  handler->setMethod(method);
+  handler->onRequest(onRequest);
+  handler->onUpload(onUpload);
+  handler->onBody(onBody);
+  _routes.emplace_back(handler);
+  addHandler(handler);
+  return *handler;
+}
+
+/**
+ * @brief Removes a handler.
+ */
+bool AsyncWebServer::removeHandler(AsyncWebHandler *handler) {
+  auto it = std::find(_handlers.begin(), _handlers.end(), handler);
+  if (it == _handlers.end()) return false;
+  _handlers.erase(it);
+  return true;
+}
+
+/**
+ * @brief Finds the handler of a request.
+ */
+AsyncWebHandler* AsyncWebServer::attach(AsyncWebServerRequest *request) {
+  for (AsyncWebHandler *handler : _handlers) {
+    if (handler->canHandle(request)) return handler;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Passes a file part on; routes without an upload callback fall back to onFileUpload().
+ */
+void AsyncWebServer::upload(AsyncWebHandler *handler, AsyncWebServerRequest *request, const String &filename,
+                            size_t index, uint8_t *data, size_t len, bool final) {
+  AsyncCallbackWebHandler *route = nullptr;
+  for (const auto &r : _routes) {
+    if (r.get() == handler) route = r.get();
+  }
+  if (handler && (!route || route->hasUpload())) handler->handleUpload(request, filename, index, data, len, final);
+  else if (_onFileUpload) _onFileUpload(request, filename, index, data, len, final);
+}
+
+/**
+ * @brief Passes a raw body on.
+ */
+void AsyncWebServer::body(AsyncWebHandler *handler, AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (handler) handler->handleBody(request, data, len, index, total);
+  else if (_onRequestBody) _onRequestBody(request, data, len, index, total);
+}
+
+/**
+ * @brief Runs the first handler that accepts the request.
+ */
+bool AsyncWebServer::dispatch(AsyncWebServerRequest *request) {
+  AsyncWebHandler *handler = attach(request);
+  if (handler) {
+    handler->handleRequest(request);
+    return true;
+  }
+  if (_onNotFound) _onNotFound(request);
+  return false;
+}
+
+/**
+ * @brief Opens the listening socket and starts the accept thread.
+ */
+void AsyncWebServer::begin() {
+  if (_fd >= 0) return;
+  uint16_t port = _port;
+  const char *env = getenv("WASH_HTTP_PORT");
+  if (env && *env) port = (uint16_t)atoi(env);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+    fprintf(stderr, "http: cannot listen on port %u (set WASH_HTTP_PORT)\n", (unsigned)port);
+    close(fd);
+    return;
+  }
+  _fd = fd;
+  fprintf(stderr, "http: listening on port %u\n", (unsigned)port);
+  std::thread(&AsyncWebServer::_listen, this).detach();
+}
+
+/**
+ * @brief Closes the listening socket; open connections finish on their own.
+ */
+void AsyncWebServer::end() {
+  if (_fd < 0) return;
+  shutdown(_fd, SHUT_RDWR);
+  close(_fd);
+  _fd = -1;
+}
+
+/**
+ * @brief Accepts connections until end().
+ */
+void AsyncWebServer::_listen() {
+  for (;;) {
+    int fd = _fd;
+    if (fd < 0) return;
+    int client = accept(fd, nullptr, nullptr);
+    if (client < 0) {
+      if (_fd < 0) return;
+      continue;
+    }
+    std::thread(&AsyncWebServer::_serve, this, client).detach();
+  }
+}
+
+/**
+ * @struct Connection
+ * @brief A client socket with its read buffer.
+ */
+struct Connection {
+  int fd;
+  std::string buf;
+
+  /**
+   * @brief Reads more data into the buffer.
+   */
+  bool fill() {
+    char tmp[4096];
+    ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+    if (n <= 0) return false;
+    buf.append(tmp, (size_t)n);
+    return true;
+  }
+
+  /**
+   * @brief Reads up to the empty line that ends the headers.
+   */
+  bool readHead(std::string &head) {
+    size_t end;
+    while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+      if (buf.size() > MAX_HEADER_SIZE || !fill()) return false;
+    }
+    head = buf.substr(0, end);
+    buf.erase(0, end + 4);
+    return true;
+  }
+
+  /**
+   * @brief Reads exactly @p len bytes of body.
+   */
+  bool readBody(size_t len, std::string &body) {
+    while (buf.size() < len) {
+      if (!fill()) return false;
+    }
+    body = buf.substr(0, len);
+    buf.erase(0, len);
+    return true;
+  }
+
+  /**
+   * @brief Sends everything.
+   */
+  void send(const std::string &data) {
+    size_t off = 0;
+    while (off < data.size()) {
+      ssize_t n = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+      if (n <= 0) return;
+      off += (size_t)n;
+    }
+  }
+};
+
+/**
+ * @brief Decodes a URL-encoded component ("+" is a space).
+ */
+static String urlDecode(const std::string &in) {
+  std::string out;
+  out.reserve(in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    if (in[i] == '+') out += ' ';
+    else if (in[i] == '%' && i + 2 < in.size() && isxdigit((unsigned char)in[i + 1]) && isxdigit((unsigned char)in[i + 2])) {
+      out += (char)strtol(in.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      out += in[i];
+    }
+  }
+  return String(out);
+}
+
+/**
+ * @brief Adds the parameters of a query string or an urlencoded form.
+ */
+static void addParams(AsyncWebServerRequest &request, const std::string &query, bool post) {
+  size_t pos = 0;
+  while (pos <= query.size()) {
+    size_t amp = query.find('&', pos);
+    if (amp == std::string::npos) amp = query.size();
+    std::string pair = query.substr(pos, amp - pos);
+    if (!pair.empty()) {
+      size_t eq = pair.find('=');
+      if (eq == std::string::npos) request.addParam(urlDecode(pair), String(), post);
+      else request.addParam(urlDecode(pair.substr(0, eq)), urlDecode(pair.substr(eq + 1)), post);
+    }
+    pos = amp + 1;
+  }
+}
+
+/**
+ * @brief Gets an attribute such as name="x" from a header value.
+ */
+static bool headerAttr(const std::string &value, const char *attr, std::string &out) {
+  std::string key = std::string(attr) + "=";
+  size_t pos = 0;
+  while ((pos = value.find(key, pos)) != std::string::npos) {
+    if (pos == 0 || value[pos - 1] == ' ' || value[pos - 1] == ';') break;
+    pos += key.size();
+  }
+  if (pos == std::string::npos) return false;
+  pos += key.size();
+  if (pos < value.size() && value[pos] == '"') {
+    size_t end = value.find('"', pos + 1);
+    out = value.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+  } else {
+    size_t end = value.find(';', pos);
+    out = value.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+  }
+  return true;
+}
+
+/**
+ * @brief Splits a multipart/form-data body into fields and file uploads.
+ * File contents reach the upload handler in segment-sized pieces, as from the library.
+ */
+static void parseMultipart(AsyncWebServer &server, AsyncWebHandler *handler, AsyncWebServerRequest &request,
+                           const std::string &body, const std::string &boundary) {
+  std::string delim = "--" + boundary;
+  size_t pos = body.find(delim);
+  while (pos != std::string::npos) {
+    pos += delim.size();
+    if (body.compare(pos, 2, "--") == 0) return;
+    size_t headEnd = body.find("\r\n\r\n", pos);
+    if (headEnd == std::string::npos) return;
+    std::string head = body.substr(pos, headEnd - pos);
+    size_t dataStart = headEnd + 4;
+    size_t next = body.find("\r\n" + delim, dataStart);
+    if (next == std::string::npos) return;
+    std::string name, filename;
+    size_t cd = head.find("Content-Disposition:");
+    if (cd == std::string::npos) cd = head.find("content-disposition:");
+    if (cd != std::string::npos) {
+      std::string line = head.substr(cd, head.find("\r\n", cd) - cd);
+      headerAttr(line, "name", name);
+      headerAttr(line, "filename", filename);
+    }
+    size_t len = next - dataStart;
+    if (!filename.empty()) {
+      request.addParam(String(name), String(filename), true, true);
+      uint8_t *data = (uint8_t*)&body[dataStart];
+      size_t index = 0;
+      do {
+        size_t n = std::min(CHUNK_SIZE, len - index);
+        server.upload(handler, &request, String(filename), index, data + index, n, index + n == len);
+        index += n;
+      } while (index < len);
+    } else {
+      request.addParam(String(name), String(body.substr(dataStart, len)), true);
+    }
+    pos = next + 2;
+  }
+}
+
+/**
+ * @brief Gets the reason phrase of a status code.
+ */
+static const char* reasonPhrase(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+/**
+ * @brief Maps a method name to its flag, 0 if unknown.
+ */
+static WebRequestMethodComposite methodFlag(const std::string &name) {
+  if (name == "GET") return HTTP_GET;
+  if (name == "POST") return HTTP_POST;
+  if (name == "DELETE") return HTTP_DELETE;
+  if (name == "PUT") return HTTP_PUT;
+  if (name == "PATCH") return HTTP_PATCH;
+  if (name == "HEAD") return HTTP_HEAD;
+  if (name == "OPTIONS") return HTTP_OPTIONS;
+  return 0;
+}
+
+/**
+ * @brief Reads one request from a connection, answers it and closes the connection.
+ */
+void AsyncWebServer::_serve(int fd) {
+  timeval tv = { RECV_TIMEOUT_S, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  Connection conn{fd, std::string()};
+  std::string head;
+  if (!conn.readHead(head)) {
+    close(fd);
+    return;
+  }
+
+  size_t lineEnd = head.find("\r\n");
+  std::string requestLine = head.substr(0, lineEnd);
+  size_t sp1 = requestLine.find(' '), sp2 = requestLine.rfind(' ');
+  WebRequestMethodComposite method = sp1 == std::string::npos ? 0 : methodFlag(requestLine.substr(0, sp1));
+  if (!method || sp2 <= sp1) {
+    conn.send("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    close(fd);
+    return;
+  }
+  std::string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+  size_t q = target.find('?');
+  std::unique_ptr<AsyncWebServerRequest> request(new AsyncWebServerRequest(method, urlDecode(target.substr(0, q))));
+  if (q != std::string::npos) addParams(*request, target.substr(q + 1), false);
+
+  std::string contentType;
+  size_t contentLength = 0;
+  size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+  while (pos < head.size()) {
+    size_t end = head.find("\r\n", pos);
+    if (end == std::string::npos) end = head.size();
+    std::string line = head.substr(pos, end - pos);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      std::string name = line.substr(0, colon);
+      size_t v = line.find_first_not_of(' ', colon + 1);
+      std::string value = v == std::string::npos ? std::string() : line.substr(v);
+      request->addHeader(String(name), String(value));
+      if (strcasecmp(name.c_str(), "Content-Type") == 0) contentType = value;
+      if (strcasecmp(name.c_str(), "Content-Length") == 0) contentLength = strtoul(value.c_str(), nullptr, 10);
+    }
+    pos = end + 2;
+  }
+  std::string body;
+  if (contentLength > MAX_BODY_SIZE) {
+    conn.send("HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    close(fd);
+    return;
+  }
+  if (contentLength > 0 && !conn.readBody(contentLength, body)) {
+    close(fd);
+    return;
+  }
+
+  std::string out;
+  {
+    std::lock_guard<std::mutex> lock(s_asyncTcp);
+    AsyncWebHandler *handler = attach(request.get());
+    std::string boundary;
+    if (contentType.compare(0, 33, "application/x-www-form-urlencoded") == 0) {
+      addParams(*request, body, true);
+    } else if (contentType.compare(0, 19, "multipart/form-data") == 0 && headerAttr(contentType, "boundary", boundary)) {
+      parseMultipart(*this, handler, *request, body, boundary);
+    } else if (!body.empty()) {
+      this->body(handler, request.get(), (uint8_t*)&body[0], body.size(), 0, body.size());
+    }
+    if (handler) handler->handleRequest(request.get());
+    else if (_onNotFound) _onNotFound(request.get());
+    else request->send(404);
+
+    AsyncWebServerResponse *response = request->response();
+    int code = response ? response->code() : 500;
+    const String &content = response ? response->content() : String();
+    char status[64];
+    snprintf(status, sizeof(status), "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+    out = status;
+    if (response && response->contentType().length()) out += std::string("Content-Type: ") + response->contentType().c_str() + "\r\n";
+    out += "Content-Length: " + std::to_string(content.length()) + "\r\n";
+    if (response) {
+      for (const AsyncWebHeader &h : response->headers()) {
+        out += std::string(h.name().c_str()) + ": " + h.value().c_str() + "\r\n";
+      }
+    }
+    out += "Connection: close\r\n\r\n";
+    if (method != HTTP_HEAD && code != 204 && code != 304) out.append(content.c_str(), content.length());
+    // The disconnect handlers run on the async_tcp task as well
+    request.reset();
+  }
+  conn.send(out);
+  shutdown(fd, SHUT_WR);
+  close(fd);
+}
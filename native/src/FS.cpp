@@ -0,0 +1,323 @@
+/**
+ * @file FS.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino filesystem API and LittleFS for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "FS.h"
+#include "LittleFS.h"
+#include <algorithm>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+/**
+ * @brief Host side of an open file or directory.
+ */
+class FileImpl {
+public:
+  ~FileImpl() { close(); }
+
+  /**
+   * @brief Closes the file.
+   */
+  void close() {
+    if (fp) fclose(fp);
+    fp = nullptr;
+    dir = false;
+  }
+
+  std::string path;                 ///< Path within the filesystem.
+  std::string real;                 ///< Host path.
+  FILE *fp = nullptr;               ///< Open file, nullptr for a directory.
+  bool dir = false;                 ///< This is an open directory.
+  std::vector<std::string> entries; ///< Directory: names, sorted.
+  size_t next = 0;                  ///< Directory: index of the next entry.
+};
+
+/**
+ * @brief Opens a file or directory by host path.
+ */
+static FileImplPtr openReal(const std::string &path, const std::string &real, const char *mode) {
+  std::error_code ec;
+  if (stdfs::is_directory(real, ec)) {
+    if (mode[0] != 'r') return FileImplPtr();
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    impl->real = real;
+    impl->dir = true;
+    for (const auto &entry : stdfs::directory_iterator(real, ec)) {
+      impl->entries.push_back(entry.path().filename().string());
+    }
+    std::sort(impl->entries.begin(), impl->entries.end());
+    return impl;
+  }
+  FILE *fp = fopen(real.c_str(), mode);
+  if (!fp) return FileImplPtr();
+  auto impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  impl->real = real;
+  impl->fp = fp;
+  return impl;
+}
+
+/**
+ * @brief Writes a byte.
+ */
+size_t File::write(uint8_t c) {
+  return _p && _p->fp && fputc(c, _p->fp) != EOF ? 1 : 0;
+}
+
+/**
+ * @brief Writes a buffer.
+ */
+size_t File::write(const uint8_t *buf, size_t size) {
+  return _p && _p->fp ? fwrite(buf, 1, size, _p->fp) : 0;
+}
+
+/**
+ * @brief Gets the number of bytes left to read.
+ */
+int File::available() {
+  if (!_p || !_p->fp) return 0;
+  size_t total = size(), pos = position();
+  return total > pos ? (int)(total - pos) : 0;
+}
+
+/**
+ * @brief Reads a byte, -1 at the end.
+ */
+int File::read() {
+  return _p && _p->fp ? fgetc(_p->fp) : -1;
+}
+
+/**
+ * @brief Gets the next byte without consuming it, -1 at the end.
+ */
+int File::peek() {
+  if (!_p || !_p->fp) return -1;
+  int c = fgetc(_p->fp);
+  if (c != EOF) ungetc(c, _p->fp);
+  return c;
+}
+
+/**
+ * @brief Pushes buffered writes to the host file.
+ */
+void File::flush() {
+  if (_p && _p->fp) fflush(_p->fp);
+}
+
+/**
+ * @brief Reads into a buffer.
+ */
+size_t File::read(uint8_t *buf, size_t size) {
+  return _p && _p->fp ? fread(buf, 1, size, _p->fp) : 0;
+}
+
+/**
+ * @brief Moves the read/write position.
+ */
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!_p || !_p->fp) return false;
+  int whence = mode == SeekCur ? SEEK_CUR : mode == SeekEnd ? SEEK_END : SEEK_SET;
+  return fseek(_p->fp, (long)pos, whence) == 0;
+}
+
+/**
+ * @brief Gets the read/write position.
+ */
+size_t File::position() const {
+  if (!_p || !_p->fp) return 0;
+  long pos = ftell(_p->fp);
+  return pos < 0 ? 0 : (size_t)pos;
+}
+
+/**
+ * @brief Gets the file size, including buffered writes.
+ */
+size_t File::size() const {
+  if (!_p || !_p->fp) return 0;
+  fflush(_p->fp);
+  struct stat st;
+  return fstat(fileno(_p->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+/**
+ * @brief Closes the file for every copy of this File.
+ */
+void File::close() {
+  if (_p) _p->close();
+  _p = nullptr;
+}
+
+/**
+ * @brief Checks that the file or directory is open.
+ */
+File::operator bool() const {
+  return _p && (_p->fp || _p->dir);
+}
+
+/**
+ * @brief Gets the time of the last modification.
+ */
+time_t File::getLastWrite() {
+  struct stat st;
+  return _p && stat(_p->real.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+/**
+ * @brief Gets the full path.
+ */
+const char* File::path() const {
+  return _p ? _p->path.c_str() : nullptr;
+}
+
+/**
+ * @brief Gets the name without the directory, as the ESP32 core 2.x does.
+ */
+const char* File::name() const {
+  if (!_p) return nullptr;
+  size_t slash = _p->path.rfind('/');
+  return _p->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+/**
+ * @brief Checks whether this is a directory.
+ */
+bool File::isDirectory() const {
+  return _p && _p->dir;
+}
+
+/**
+ * @brief Opens the next entry of a directory; an empty File at the end.
+ */
+File File::openNextFile(const char *mode) {
+  if (!_p || !_p->dir) return File();
+  while (_p->next < _p->entries.size()) {
+    const std::string &name = _p->entries[_p->next++];
+    std::string path = _p->path == "/" ? "/" + name : _p->path + "/" + name;
+    FileImplPtr child = openReal(path, _p->real + "/" + name, mode);
+    if (child) return File(child);
+  }
+  return File();
+}
+
+/**
+ * @brief Starts the directory listing over.
+ */
+void File::rewindDirectory() {
+  if (_p) _p->next = 0;
+}
+
+/**
+ * @brief Maps a filesystem path to the host path.
+ */
+std::string FS::_real(const char *path) const {
+  std::string p = path ? path : "";
+  if (p.empty() || p[0] != '/') p = "/" + p;
+  while (p.size() > 1 && p.back() == '/') p.pop_back();
+  return p == "/" ? _root : _root + p;
+}
+
+/**
+ * @brief Opens a file; create also makes the missing parent directories.
+ */
+File FS::open(const char *path, const char *mode, const bool create) {
+  if (_root.empty() || !path) return File();
+  std::string real = _real(path);
+  if (create && mode[0] != 'r') {
+    std::error_code ec;
+    stdfs::create_directories(stdfs::path(real).parent_path(), ec);
+  }
+  std::string p = path[0] == '/' ? path : std::string("/") + path;
+  return File(openReal(p, real, mode));
+}
+
+/**
+ * @brief Checks whether a file or directory exists.
+ */
+bool FS::exists(const char *path) {
+  struct stat st;
+  return !_root.empty() && stat(_real(path).c_str(), &st) == 0;
+}
+
+/**
+ * @brief Removes a file.
+ */
+bool FS::remove(const char *path) {
+  if (_root.empty()) return false;
+  std::string real = _real(path);
+  std::error_code ec;
+  if (stdfs::is_directory(real, ec)) return false;
+  return ::remove(real.c_str()) == 0;
+}
+
+/**
+ * @brief Renames a file or directory; an existing target is replaced.
+ */
+bool FS::rename(const char *pathFrom, const char *pathTo) {
+  return !_root.empty() && ::rename(_real(pathFrom).c_str(), _real(pathTo).c_str()) == 0;
+}
+
+/**
+ * @brief Creates a directory; fails if it exists.
+ */
+bool FS::mkdir(const char *path) {
+  return !_root.empty() && ::mkdir(_real(path).c_str(), 0755) == 0;
+}
+
+/**
+ * @brief Removes an empty directory.
+ */
+bool FS::rmdir(const char *path) {
+  return !_root.empty() && ::rmdir(_real(path).c_str()) == 0;
+}
+
+/**
+ * @brief Mounts the host directory, creating it if needed.
+ */
+bool LittleFSFS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles, const char *partitionLabel) {
+  (void)formatOnFail; (void)basePath; (void)maxOpenFiles; (void)partitionLabel;
+  const char *env = getenv("WASH_FS_ROOT");
+  std::string root = env && *env ? env : NATIVE_FS_ROOT;
+  while (root.size() > 1 && root.back() == '/') root.pop_back();
+  std::error_code ec;
+  stdfs::create_directories(root, ec);
+  if (!stdfs::is_directory(root, ec)) return false;
+  _root = root;
+  return true;
+}
+
+/**
+ * @brief Removes every file and directory.
+ */
+bool LittleFSFS::format() {
+  if (_root.empty()) return false;
+  std::error_code ec;
+  for (const auto &entry : stdfs::directory_iterator(_root, ec)) stdfs::remove_all(entry.path(), ec);
+  return !ec;
+}
+
+/**
+ * @brief Gets the total size of the files.
+ */
+size_t LittleFSFS::usedBytes() {
+  if (_root.empty()) return 0;
+  size_t used = 0;
+  std::error_code ec;
+  for (const auto &entry : stdfs::recursive_directory_iterator(_root, ec)) {
+    if (entry.is_regular_file(ec)) used += (size_t)entry.file_size(ec);
+  }
+  return used;
+}
+
+} // namespace fs
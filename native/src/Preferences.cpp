@@ -0,0 +1,113 @@
+/**
+ * @file Preferences.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Preferences class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Preferences.h"
+#include <map>
+#include <mutex>
+#include <string>
+
+typedef std::map<std::string, std::string> Namespace;
+
+static std::mutex s_lock;
+static std::map<std::string, Namespace> s_store; ///< Values by namespace and key.
+
+/**
+ * @brief Opens a namespace.
+ */
+bool Preferences::begin(const char *name, bool readOnly, const char *partitionLabel) {
+  (void)partitionLabel;
+  if (!name || !*name) return false;
+  _ns = name;
+  _readOnly = readOnly;
+  return true;
+}
+
+/**
+ * @brief Removes every key of the namespace.
+ */
+bool Preferences::clear() {
+  if (_ns.empty() || _readOnly) return false;
+  std::lock_guard<std::mutex> lock(s_lock);
+  s_store[_ns].clear();
+  return true;
+}
+
+/**
+ * @brief Removes a key.
+ */
+bool Preferences::remove(const char *key) {
+  if (_ns.empty() || _readOnly || !key) return false;
+  std::lock_guard<std::mutex> lock(s_lock);
+  return s_store[_ns].erase(key) > 0;
+}
+
+/**
+ * @brief Checks whether a key exists.
+ */
+bool Preferences::isKey(const char *key) {
+  if (_ns.empty() || !key) return false;
+  std::lock_guard<std::mutex> lock(s_lock);
+  return s_store[_ns].count(key) > 0;
+}
+
+/**
+ * @brief Gets a string value.
+ */
+String Preferences::getString(const char *key, const String &defaultValue) {
+  if (_ns.empty() || !key) return defaultValue;
+  std::lock_guard<std::mutex> lock(s_lock);
+  Namespace &ns = s_store[_ns];
+  auto it = ns.find(key);
+  return it == ns.end() ? defaultValue : String(it->second);
+}
+
+/**
+ * @brief Gets the length of a value.
+ */
+size_t Preferences::getBytesLength(const char *key) {
+  if (_ns.empty() || !key) return 0;
+  std::lock_guard<std::mutex> lock(s_lock);
+  Namespace &ns = s_store[_ns];
+  auto it = ns.find(key);
+  return it == ns.end() ? 0 : it->second.size();
+}
+
+/**
+ * @brief Copies a value into a buffer.
+ */
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  if (_ns.empty() || !key) return 0;
+  std::lock_guard<std::mutex> lock(s_lock);
+  Namespace &ns = s_store[_ns];
+  auto it = ns.find(key);
+  if (it == ns.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+/**
+ * @brief Stores a value.
+ */
+size_t Preferences::_put(const char *key, const void *value, size_t len) {
+  if (_ns.empty() || _readOnly || !key) return 0;
+  std::lock_guard<std::mutex> lock(s_lock);
+  s_store[_ns][key].assign((const char*)value, len);
+  return len;
+}
+
+/**
+ * @brief Copies a value of exactly len bytes.
+ */
+bool Preferences::_get(const char *key, void *out, size_t len) {
+  if (_ns.empty() || !key) return false;
+  std::lock_guard<std::mutex> lock(s_lock);
+  Namespace &ns = s_store[_ns];
+  auto it = ns.find(key);
+  if (it == ns.end() || it->second.size() != len) return false;
+  memcpy(out, it->second.data(), len);
+  return true;
+}
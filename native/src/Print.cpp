@@ -0,0 +1,75 @@
+/**
+ * @file Print.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Print and Stream classes for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Print.h"
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief Writes a buffer byte by byte.
+ */
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+/**
+ * @brief Writes formatted text.
+ */
+size_t Print::printf(const char *format, ...) {
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(small)) return write((const uint8_t*)small, len);
+  std::vector<char> big(len + 1);
+  va_start(args, format);
+  vsnprintf(big.data(), big.size(), format, args);
+  va_end(args);
+  return write((const uint8_t*)big.data(), len);
+}
+
+/**
+ * @brief Reads up to length bytes.
+ */
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = read();
+    if (c < 0) break;
+    buffer[n++] = (char)c;
+  }
+  return n;
+}
+
+/**
+ * @brief Reads everything that is left.
+ */
+String Stream::readString() {
+  String s;
+  char buf[256];
+  size_t n;
+  while ((n = readBytes(buf, sizeof(buf))) > 0) s.concat(buf, (unsigned int)n);
+  return s;
+}
+
+/**
+ * @brief Reads up to a terminator, which is consumed but not returned.
+ */
+String Stream::readStringUntil(char terminator) {
+  String s;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) s.concat((char)c);
+  return s;
+}
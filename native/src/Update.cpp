@@ -0,0 +1,42 @@
+/**
+ * @file Update.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino Update class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Update.h"
+
+UpdateClass Update;
+
+/**
+ * @brief Starts an update; fails for lack of an update partition.
+ */
+bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, const char *label) {
+  (void)size; (void)command; (void)ledPin; (void)ledOn; (void)label;
+  _error = UPDATE_ERROR_NO_PARTITION;
+  return false;
+}
+
+/**
+ * @brief Writes image data; nothing was started.
+ */
+size_t UpdateClass::write(uint8_t *data, size_t len) {
+  (void)data; (void)len;
+  return 0;
+}
+
+/**
+ * @brief Finishes an update; nothing was started.
+ */
+bool UpdateClass::end(bool evenIfRemaining) {
+  (void)evenIfRemaining;
+  return false;
+}
+
+/**
+ * @brief Describes the last error.
+ */
+const char* UpdateClass::errorString() const {
+  return _error == UPDATE_ERROR_NO_PARTITION ? "Partition Could Not be Found" : "No Error";
+}
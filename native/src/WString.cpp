@@ -0,0 +1,196 @@
+/**
+ * @file WString.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino String class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "WString.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+/**
+ * @brief Formats an unsigned number in the given base.
+ */
+static std::string formatUnsigned(unsigned long long value, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  char buf[72];
+  char *p = buf + sizeof(buf) - 1;
+  *p = 0;
+  do {
+    unsigned digit = (unsigned)(value % base);
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value);
+  return std::string(p);
+}
+
+/**
+ * @brief Formats a signed number; like the ESP32 core, only base 10 gets a sign.
+ */
+static std::string formatSigned(long long value, unsigned char base, unsigned bits) {
+  if (base == 10 && value < 0) return "-" + formatUnsigned(0ULL - (unsigned long long)value, 10);
+  unsigned long long mask = bits >= 64 ? ~0ULL : ((1ULL << bits) - 1);
+  return formatUnsigned((unsigned long long)value & mask, base);
+}
+
+/**
+ * @brief Formats a floating point number with a fixed number of decimals.
+ */
+static std::string formatFloat(double value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  return std::string(buf);
+}
+
+String::String(unsigned char value, unsigned char base) : _s(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : _s(formatSigned(value, base, sizeof(int) * 8)) {}
+String::String(unsigned int value, unsigned char base) : _s(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : _s(formatSigned(value, base, sizeof(long) * 8)) {}
+String::String(unsigned long value, unsigned char base) : _s(formatUnsigned(value, base)) {}
+String::String(long long value, unsigned char base) : _s(formatSigned(value, base, 64)) {}
+String::String(unsigned long long value, unsigned char base) : _s(formatUnsigned(value, base)) {}
+String::String(float value, unsigned int decimalPlaces) : _s(formatFloat(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : _s(formatFloat(value, decimalPlaces)) {}
+
+/**
+ * @brief Compares two strings ignoring ASCII case.
+ */
+bool String::equalsIgnoreCase(const String &str) const {
+  return _s.size() == str._s.size() && strcasecmp(_s.c_str(), str._s.c_str()) == 0;
+}
+
+/**
+ * @brief Checks for a prefix at an offset.
+ */
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+  return offset <= _s.size() && _s.compare(offset, prefix._s.size(), prefix._s) == 0;
+}
+
+/**
+ * @brief Checks for a suffix.
+ */
+bool String::endsWith(const String &suffix) const {
+  return _s.size() >= suffix._s.size() &&
+         _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+}
+
+/**
+ * @brief Gives write access to a character; out of range yields a dummy.
+ */
+char& String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= _s.size()) {
+    dummy = 0;
+    return dummy;
+  }
+  return _s[index];
+}
+
+/**
+ * @brief Copies characters into a zero-terminated buffer.
+ */
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+  if (!buf || bufsize == 0) return;
+  if (index >= _s.size()) {
+    buf[0] = 0;
+    return;
+  }
+  size_t n = std::min<size_t>(bufsize - 1, _s.size() - index);
+  memcpy(buf, _s.data() + index, n);
+  buf[n] = 0;
+}
+
+/**
+ * @brief Gets a part of the string; the indices are swapped and clamped like on the ESP32.
+ */
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if (beginIndex >= _s.size()) return String();
+  if (endIndex > _s.size()) endIndex = (unsigned int)_s.size();
+  return String(_s.substr(beginIndex, endIndex - beginIndex));
+}
+
+/**
+ * @brief Replaces every occurrence of a character.
+ */
+void String::replace(char find, char replace) {
+  for (char &c : _s) {
+    if (c == find) c = replace;
+  }
+}
+
+/**
+ * @brief Replaces every occurrence of a substring.
+ */
+void String::replace(const String &find, const String &replace) {
+  if (find._s.empty()) return;
+  size_t pos = 0;
+  while ((pos = _s.find(find._s, pos)) != std::string::npos) {
+    _s.replace(pos, find._s.size(), replace._s);
+    pos += replace._s.size();
+  }
+}
+
+/**
+ * @brief Converts to lower case.
+ */
+void String::toLowerCase() {
+  for (char &c : _s) c = (char)tolower((unsigned char)c);
+}
+
+/**
+ * @brief Converts to upper case.
+ */
+void String::toUpperCase() {
+  for (char &c : _s) c = (char)toupper((unsigned char)c);
+}
+
+/**
+ * @brief Removes leading and trailing whitespace.
+ */
+void String::trim() {
+  size_t b = 0, e = _s.size();
+  while (b < e && isspace((unsigned char)_s[b])) b++;
+  while (e > b && isspace((unsigned char)_s[e - 1])) e--;
+  _s = _s.substr(b, e - b);
+}
+
+/**
+ * @brief Parses a leading integer, 0 if there is none.
+ */
+long String::toInt() const {
+  return atol(_s.c_str());
+}
+
+/**
+ * @brief Parses a leading floating point number, 0 if there is none.
+ */
+float String::toFloat() const {
+  return (float)atof(_s.c_str());
+}
+
+/**
+ * @brief Parses a leading floating point number, 0 if there is none.
+ */
+double String::toDouble() const {
+  return atof(_s.c_str());
+}
+
+String operator+(const String &lhs, const String &rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, const char *rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const char *lhs, const String &rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, char rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, unsigned char rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, int rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, unsigned int rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, long rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, unsigned long rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, long long rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, unsigned long long rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, float rhs) { String s(lhs); s.concat(rhs); return s; }
+String operator+(const String &lhs, double rhs) { String s(lhs); s.concat(rhs); return s; }
@@ -0,0 +1,86 @@
+/**
+ * @file WiFi.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the Arduino WiFi class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "WiFi.h"
+#include <mutex>
+#include <utility>
+#include <vector>
+
+WiFiClass WiFi;
+
+static const uint8_t REASON_ASSOC_LEAVE = 8;
+static const uint8_t REASON_NO_AP_FOUND = 201;
+
+static std::mutex s_lock;
+static std::vector<std::pair<WiFiEventFuncCb, arduino_event_id_t>> s_handlers;
+
+/**
+ * @brief Starts the access point.
+ */
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssidHidden, int maxConnection) {
+  (void)passphrase; (void)channel; (void)ssidHidden; (void)maxConnection;
+  if (!ssid || !*ssid) return false;
+  if (!(_mode & WIFI_MODE_AP)) _mode = (wifi_mode_t)(_mode | WIFI_MODE_AP);
+  return true;
+}
+
+/**
+ * @brief Joins a network.
+ */
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase) {
+  (void)passphrase;
+  if (!(_mode & WIFI_MODE_STA)) _mode = (wifi_mode_t)(_mode | WIFI_MODE_STA);
+  const char *only = getenv("WASH_WIFI_SSID");
+  if (!ssid || !*ssid || (only && *only && strcmp(only, ssid) != 0)) {
+    _status = WL_NO_SSID_AVAIL;
+    _raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, REASON_NO_AP_FOUND);
+    return _status;
+  }
+  _ssid = ssid;
+  _status = WL_CONNECTED;
+  _raise(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  _raise(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  return _status;
+}
+
+/**
+ * @brief Leaves the network.
+ */
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+  (void)eraseap;
+  bool was = _status == WL_CONNECTED;
+  _status = WL_DISCONNECTED;
+  _ssid = "";
+  if (wifioff) _mode = (wifi_mode_t)(_mode & ~WIFI_MODE_STA);
+  if (was) _raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, REASON_ASSOC_LEAVE);
+  return true;
+}
+
+/**
+ * @brief Registers an event handler; ARDUINO_EVENT_MAX receives every event.
+ */
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb cbEvent, arduino_event_id_t event) {
+  std::lock_guard<std::mutex> lock(s_lock);
+  s_handlers.push_back(std::make_pair(cbEvent, event));
+  return s_handlers.size();
+}
+
+/**
+ * @brief Calls the handlers registered for an event.
+ */
+void WiFiClass::_raise(arduino_event_id_t event, uint8_t reason) {
+  arduino_event_info_t info = {};
+  info.wifi_sta_disconnected.reason = reason;
+  std::vector<std::pair<WiFiEventFuncCb, arduino_event_id_t>> handlers;
+  {
+    std::lock_guard<std::mutex> lock(s_lock);
+    handlers = s_handlers;
+  }
+  for (auto &h : handlers) {
+    if (h.second == ARDUINO_EVENT_MAX || h.second == event) h.first(event, info);
+  }
+}
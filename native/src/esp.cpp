@@ -0,0 +1,161 @@
+/**
+ * @file esp.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the ESP-IDF system, heap, partition and OTA API for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include <Arduino.h>
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include <mutex>
+#include <random>
+#include <vector>
+
+static std::mutex s_shutdownLock;
+static std::vector<shutdown_handler_t> s_shutdownHandlers;
+
+static const esp_partition_t s_app0 = {
+  ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 0x140000, "app0", false
+};
+
+/**
+ * @brief Registers a function esp_restart() calls before restarting.
+ */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+  std::lock_guard<std::mutex> lock(s_shutdownLock);
+  s_shutdownHandlers.push_back(handle);
+  return ESP_OK;
+}
+
+/**
+ * @brief Runs the shutdown handlers and ends the process.
+ */
+void esp_restart(void) {
+  std::vector<shutdown_handler_t> handlers;
+  {
+    std::lock_guard<std::mutex> lock(s_shutdownLock);
+    handlers = s_shutdownHandlers;
+  }
+  // ESP-IDF calls them in reverse order of registration
+  for (auto it = handlers.rbegin(); it != handlers.rend(); ++it) (*it)();
+  fflush(stdout);
+  _Exit(0);
+}
+
+/**
+ * @brief Gets a random number.
+ */
+uint32_t esp_random(void) {
+  static std::mutex lock;
+  static std::mt19937 rng{std::random_device{}()};
+  std::lock_guard<std::mutex> guard(lock);
+  return rng();
+}
+
+/**
+ * @brief Gets the free heap.
+ */
+uint32_t esp_get_free_heap_size(void) {
+  return ESP.getFreeHeap();
+}
+
+/**
+ * @brief Gets the lowest free heap seen so far.
+ */
+uint32_t esp_get_minimum_free_heap_size(void) {
+  return ESP.getMinFreeHeap();
+}
+
+/**
+ * @brief Allocates memory; SPIRAM requests fail.
+ */
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  if (caps & MALLOC_CAP_SPIRAM) return nullptr;
+  return malloc(size);
+}
+
+/**
+ * @brief Frees memory from heap_caps_malloc().
+ */
+void heap_caps_free(void *ptr) {
+  free(ptr);
+}
+
+/**
+ * @brief Gets the size of the heap with the given capabilities.
+ */
+size_t heap_caps_get_total_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : ESP.getHeapSize();
+}
+
+/**
+ * @brief Gets the free memory with the given capabilities.
+ */
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : ESP.getFreeHeap();
+}
+
+/**
+ * @brief Gets the largest block that could be allocated; malloc() does not
+ * fragment the way the ESP32 heap does, so this is the free heap.
+ */
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : ESP.getMaxAllocHeap();
+}
+
+/**
+ * @brief Finds a partition.
+ */
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+  if (type != s_app0.type) return nullptr;
+  if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != s_app0.subtype) return nullptr;
+  if (label && strcmp(label, s_app0.label) != 0) return nullptr;
+  return &s_app0;
+}
+
+/**
+ * @brief Gets the partition the firmware runs from.
+ */
+const esp_partition_t* esp_ota_get_running_partition(void) {
+  return &s_app0;
+}
+
+/**
+ * @brief Gets the partition the next update goes to; there is none.
+ */
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+  (void)start_from;
+  return nullptr;
+}
+
+/**
+ * @brief Sets the boot partition; only the running one is accepted.
+ */
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+  return partition == &s_app0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Gets the state of an image; the host image is always valid.
+ */
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state) {
+  if (!partition || !ota_state) return ESP_ERR_INVALID_ARG;
+  *ota_state = ESP_OTA_IMG_VALID;
+  return ESP_OK;
+}
+
+/**
+ * @brief Marks the running image valid.
+ */
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) {
+  return ESP_OK;
+}
+
+/**
+ * @brief Marks the running image invalid; there is nothing to roll back to.
+ */
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) {
+  return ESP_FAIL;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file freertos.cpp
+ * @author Masyukov Pavel
+ * @brief Host shim of the FreeRTOS task, queue and semaphore API for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <vector>
+
+unsigned long millis();
+
+/**
+ * @brief A task: a detached pthread with a notification counter.
+ */
+struct NativeTask {
+  pthread_t thread;
+  TaskFunction_t code = nullptr;
+  void *params = nullptr;
+  std::string name;
+  uint32_t stackDepth = 8192; ///< As given to xTaskCreate(); the loop task has the core's default.
+  bool alive = true;          ///< Cleared when the task ends.
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notified = 0; ///< Pending notifications.
+};
+
+/**
+ * @brief A queue of fixed-size items in a ring buffer.
+ */
+struct NativeQueue {
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::vector<uint8_t> ring;
+  size_t itemSize;
+  size_t length;
+  size_t head = 0;  ///< Index of the oldest item.
+  size_t count = 0; ///< Items waiting.
+};
+
+/**
+ * @brief A counting semaphore, mutex or recursive mutex.
+ */
+struct NativeSemaphore {
+  std::mutex lock;
+  std::condition_variable released;
+  UBaseType_t count;
+  UBaseType_t maxCount;
+  bool recursive = false;
+  bool owned = false;   ///< Recursive mutex: held by owner.
+  pthread_t owner;
+  UBaseType_t depth = 0; ///< Recursive mutex: nesting level.
+};
+
+static thread_local NativeTask *t_current = nullptr;
+static std::mutex s_tasksLock;              ///< Guards s_tasks.
+static std::vector<NativeTask*> s_tasks;    ///< Every task, for xTaskGetHandle(); never freed.
+
+/**
+ * @brief Waits on a condition for up to the given number of ticks.
+ * @return The value of the predicate when the wait ended.
+ */
+template <typename Pred>
+static bool waitTicks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, pred);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+}
+
+/**
+ * @brief Gets the task of the calling thread; threads not started by
+ * xTaskCreate() (the main thread) get one on first use.
+ */
+static NativeTask* currentTask() {
+  if (!t_current) {
+    t_current = new NativeTask();
+    t_current->thread = pthread_self();
+    t_current->name = "loopTask";
+    std::lock_guard<std::mutex> lock(s_tasksLock);
+    s_tasks.push_back(t_current);
+  }
+  return t_current;
+}
+
+/**
+ * @brief Entry point of a task thread.
+ */
+static void* taskEntry(void *arg) {
+  NativeTask *task = (NativeTask*)arg;
+  t_current = task;
+  pthread_setname_np(pthread_self(), task->name.substr(0, 15).c_str());
+  task->code(task->params);
+  task->alive = false;
+  return nullptr;
+}
+
+/**
+ * @brief Starts a detached pthread.
+ */
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask) {
+  (void)uxPriority;
+  NativeTask *task = new NativeTask();
+  task->code = pvTaskCode;
+  task->params = pvParameters;
+  task->name = pcName ? pcName : "";
+  task->stackDepth = usStackDepth;
+  // As in FreeRTOS the handle is valid before the task runs
+  if (pxCreatedTask) *pxCreatedTask = task;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int rc = pthread_create(&task->thread, &attr, taskEntry, task);
+  pthread_attr_destroy(&attr);
+  if (rc != 0) {
+    if (pxCreatedTask) *pxCreatedTask = nullptr;
+    delete task;
+    return pdFAIL;
+  }
+  std::lock_guard<std::mutex> lock(s_tasksLock);
+  s_tasks.push_back(task);
+  return pdPASS;
+}
+
+/**
+ * @brief Like xTaskCreate(); the core affinity is ignored.
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID) {
+  (void)xCoreID;
+  return xTaskCreate(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask);
+}
+
+/**
+ * @brief Ends the calling task or cancels another one.
+ */
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+  NativeTask *task = xTaskToDelete ? xTaskToDelete : currentTask();
+  task->alive = false;
+  if (task == t_current) pthread_exit(nullptr);
+  pthread_cancel(task->thread);
+}
+
+/**
+ * @brief Sleeps for a number of ticks; 0 only yields.
+ */
+void vTaskDelay(TickType_t xTicksToDelay) {
+  if (xTicksToDelay == 0) sched_yield();
+  else std::this_thread::sleep_for(std::chrono::milliseconds(xTicksToDelay * portTICK_PERIOD_MS));
+}
+
+/**
+ * @brief Gets the ticks since start.
+ */
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)millis() / portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief Gets the handle of the calling task.
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask();
+}
+
+/**
+ * @brief Gets the name of a task.
+ */
+const char* pcTaskGetName(TaskHandle_t xTaskToQuery) {
+  return (xTaskToQuery ? xTaskToQuery : currentTask())->name.c_str();
+}
+
+/**
+ * @brief Finds the newest running task with a name.
+ */
+TaskHandle_t xTaskGetHandle(const char *pcNameToQuery) {
+  std::lock_guard<std::mutex> lock(s_tasksLock);
+  for (auto it = s_tasks.rbegin(); it != s_tasks.rend(); ++it) {
+    if ((*it)->alive && (*it)->name == pcNameToQuery) return *it;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Gets the stack depth the task was created with.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+  return (xTask ? xTask : currentTask())->stackDepth;
+}
+
+/**
+ * @brief Waits for notifications of the calling task.
+ */
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+  NativeTask *task = currentTask();
+  std::unique_lock<std::mutex> lock(task->lock);
+  if (!waitTicks(task->wake, lock, xTicksToWait, [task] { return task->notified > 0; })) return 0;
+  uint32_t value = task->notified;
+  task->notified = xClearCountOnExit ? 0 : value - 1;
+  return value;
+}
+
+/**
+ * @brief Notifies a task.
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+  std::lock_guard<std::mutex> lock(xTaskToNotify->lock);
+  xTaskToNotify->notified++;
+  xTaskToNotify->wake.notify_one();
+  return pdPASS;
+}
+
+/**
+ * @brief Creates a queue.
+ */
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+  if (uxQueueLength == 0) return nullptr;
+  NativeQueue *q = new NativeQueue();
+  q->itemSize = uxItemSize;
+  q->length = uxQueueLength;
+  q->ring.resize((size_t)uxQueueLength * uxItemSize);
+  return q;
+}
+
+/**
+ * @brief Deletes a queue.
+ */
+void vQueueDelete(QueueHandle_t xQueue) {
+  delete xQueue;
+}
+
+/**
+ * @brief Copies an item into a queue, at the back or the front.
+ */
+static BaseType_t queueSend(QueueHandle_t q, const void *item, TickType_t ticks, bool front) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitTicks(q->notFull, lock, ticks, [q] { return q->count < q->length; })) return pdFALSE;
+  size_t index;
+  if (front) {
+    q->head = (q->head + q->length - 1) % q->length;
+    index = q->head;
+  } else {
+    index = (q->head + q->count) % q->length;
+  }
+  memcpy(q->ring.data() + index * q->itemSize, item, q->itemSize);
+  q->count++;
+  q->notEmpty.notify_one();
+  return pdTRUE;
+}
+
+/**
+ * @brief Copies an item to the back of a queue.
+ */
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait) {
+  return queueSend(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+/**
+ * @brief Copies an item to the front of a queue.
+ */
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait) {
+  return queueSend(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+/**
+ * @brief Takes the oldest item from a queue.
+ */
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait) {
+  NativeQueue *q = xQueue;
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitTicks(q->notEmpty, lock, xTicksToWait, [q] { return q->count > 0; })) return pdFALSE;
+  memcpy(pvBuffer, q->ring.data() + q->head * q->itemSize, q->itemSize);
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  q->notFull.notify_one();
+  return pdTRUE;
+}
+
+/**
+ * @brief Gets the number of items waiting.
+ */
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+  std::lock_guard<std::mutex> lock(xQueue->lock);
+  return (UBaseType_t)xQueue->count;
+}
+
+/**
+ * @brief Gets the number of free places.
+ */
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue) {
+  std::lock_guard<std::mutex> lock(xQueue->lock);
+  return (UBaseType_t)(xQueue->length - xQueue->count);
+}
+
+/**
+ * @brief Creates a semaphore.
+ */
+static NativeSemaphore* newSemaphore(UBaseType_t maxCount, UBaseType_t initial, bool recursive) {
+  NativeSemaphore *s = new NativeSemaphore();
+  s->maxCount = maxCount;
+  s->count = initial;
+  s->recursive = recursive;
+  return s;
+}
+
+/**
+ * @brief Creates a mutex, initially free.
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return newSemaphore(1, 1, false);
+}
+
+/**
+ * @brief Creates a recursive mutex, initially free.
+ */
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return newSemaphore(1, 1, true);
+}
+
+/**
+ * @brief Creates a binary semaphore, initially taken.
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return newSemaphore(1, 0, false);
+}
+
+/**
+ * @brief Creates a counting semaphore.
+ */
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount) {
+  return newSemaphore(uxMaxCount, uxInitialCount, false);
+}
+
+/**
+ * @brief Deletes a semaphore.
+ */
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+  delete xSemaphore;
+}
+
+/**
+ * @brief Takes a semaphore or mutex.
+ */
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait) {
+  if (xSemaphore->recursive) return xSemaphoreTakeRecursive(xSemaphore, xTicksToWait);
+  std::unique_lock<std::mutex> lock(xSemaphore->lock);
+  if (!waitTicks(xSemaphore->released, lock, xTicksToWait, [xSemaphore] { return xSemaphore->count > 0; })) return pdFALSE;
+  xSemaphore->count--;
+  return pdTRUE;
+}
+
+/**
+ * @brief Gives a semaphore or mutex.
+ */
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+  if (xSemaphore->recursive) return xSemaphoreGiveRecursive(xSemaphore);
+  std::lock_guard<std::mutex> lock(xSemaphore->lock);
+  if (xSemaphore->count >= xSemaphore->maxCount) return pdFALSE;
+  xSemaphore->count++;
+  xSemaphore->released.notify_one();
+  return pdTRUE;
+}
+
+/**
+ * @brief Takes a recursive mutex; the owner may take it again.
+ */
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xTicksToWait) {
+  pthread_t self = pthread_self();
+  std::unique_lock<std::mutex> lock(xMutex->lock);
+  if (xMutex->owned && pthread_equal(xMutex->owner, self)) {
+    xMutex->depth++;
+    return pdTRUE;
+  }
+  if (!waitTicks(xMutex->released, lock, xTicksToWait, [xMutex] { return !xMutex->owned; })) return pdFALSE;
+  xMutex->owned = true;
+  xMutex->owner = self;
+  xMutex->depth = 1;
+  return pdTRUE;
+}
+
+/**
+ * @brief Gives a recursive mutex once; it is released when every take is matched.
+ */
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex) {
+  std::lock_guard<std::mutex> lock(xMutex->lock);
+  if (!xMutex->owned || !pthread_equal(xMutex->owner, pthread_self())) return pdFALSE;
+  if (--xMutex->depth == 0) {
+    xMutex->owned = false;
+    xMutex->released.notify_one();
+  }
+  return pdTRUE;
+}
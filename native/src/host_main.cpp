@@ -0,0 +1,176 @@
+/**
+ * @file host_main.cpp
+ * @author Masyukov Pavel
+ * @brief Host runner of the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ *
+ * Boots SystemManager and TaskManager the way setup() does, minus the radio
+ * and the web server, then drives the create, run and list paths and reports
+ * their timings. Run it under perf to profile them:
+ *
+ *   pio run -e native
+ *   perf record -g .pio/build/native/program -n 50 -r 20
+ *
+ * Options: -n tasks (20), -r runs per task (5), -l list requests (100),
+ * -s script file (a small built-in loop), -k keep the existing filesystem.
+ * The filesystem lives in WASH_FS_ROOT, by default .pio/native_fs.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+#include "SystemManager.h"
+#include "TaskManager.h"
+#include "JsonListStream.h"
+#include "EventHub.h"
+#include "Logger.h"
+
+SystemManager sys;         ///< Same globals as the firmware.
+TaskManager tasks;
+AsyncWebServer server(80);
+EventHub events;
+
+static const char DEFAULT_SCRIPT[] =
+  "local s = 0\n"
+  "for i = 1, 20000 do s = s + i % 7 end\n"
+  "log('sum ' .. s)\n";
+
+/**
+ * @brief Measures the wall time of a phase.
+ */
+class Phase {
+public:
+  explicit Phase(const char *name) : _name(name), _start(std::chrono::steady_clock::now()) {}
+
+  /**
+   * @brief Prints the time per operation.
+   */
+  void report(size_t ops) {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+    fprintf(stderr, "%-8s %6zu ops %10.2f ms %10.1f us/op\n", _name, ops, ms, ops ? ms * 1000.0 / ops : 0.0);
+  }
+
+private:
+  const char *_name;
+  std::chrono::steady_clock::time_point _start;
+};
+
+/**
+ * @brief Reads a whole host file.
+ */
+static bool readHostFile(const char *path, String &out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::stringstream ss;
+  ss << in.rdbuf();
+  out = String(ss.str());
+  return true;
+}
+
+/**
+ * @brief Fetches the task list as GET /api/tasks does.
+ * @return The size of the response body.
+ */
+static size_t listTasks() {
+  AsyncWebServerRequest request(HTTP_GET, "/api/tasks");
+  std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+  JsonListStream::send(&request, std::make_shared<JsonListStream>("tasks",
+    [next](JsonObject obj) { return tasks.getTaskEntryJSON((*next)++, obj); },
+    nullptr,
+    [](JsonObject obj) { tasks.getQueueJSON(obj); }));
+  return request.response() ? request.response()->content().length() : 0;
+}
+
+/**
+ * @brief Entry point.
+ */
+int main(int argc, char **argv) {
+  size_t taskCount = 20, runsPerTask = 5, listCount = 100;
+  const char *scriptPath = nullptr;
+  bool keep = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:l:s:k")) != -1) {
+    switch (opt) {
+      case 'n': taskCount = strtoul(optarg, nullptr, 10); break;
+      case 'r': runsPerTask = strtoul(optarg, nullptr, 10); break;
+      case 'l': listCount = strtoul(optarg, nullptr, 10); break;
+      case 's': scriptPath = optarg; break;
+      case 'k': keep = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-n tasks] [-r runs] [-l lists] [-s script.lua] [-k]\n", argv[0]);
+        return 2;
+    }
+  }
+  String script = DEFAULT_SCRIPT;
+  if (scriptPath && !readHostFile(scriptPath, script)) {
+    fprintf(stderr, "cannot read %s\n", scriptPath);
+    return 2;
+  }
+
+  if (!LittleFS.begin()) {
+    fprintf(stderr, "cannot mount %s\n", getenv("WASH_FS_ROOT") ? getenv("WASH_FS_ROOT") : NATIVE_FS_ROOT);
+    return 1;
+  }
+  if (!keep) LittleFS.format();
+  Logger::begin();
+  sys.begin();
+  sys.ota().checkBoot();
+  tasks.begin();
+  sys.setTaskManager(&tasks);
+  events.begin(server);
+  tasks.setEventHub(&events);
+  fprintf(stderr, "filesystem %s, %u tasks loaded\n", LittleFS.root(), (unsigned)tasks.scriptCount());
+
+  std::vector<String> ids;
+  Phase create("create");
+  for (size_t i = 0; i < taskCount; i++) {
+    String id = tasks.createTask(String("bench-") + (unsigned)i);
+    if (id.length() == 0 || !tasks.saveScript(id, String("bench-") + (unsigned)i, script)) {
+      fprintf(stderr, "create failed at %zu\n", i);
+      return 1;
+    }
+    ids.push_back(id);
+  }
+  create.report(ids.size());
+
+  size_t runs = 0;
+  Phase run("run");
+  for (size_t round = 0; round < runsPerTask; round++) {
+    std::vector<uint32_t> active;
+    for (const String &id : ids) {
+      uint32_t handle = 0;
+      TaskManager::RunStatus rc;
+      while ((rc = tasks.startRun(id, 0, &handle)) == TaskManager::RUN_QUEUE_FULL) {
+        events.pump();
+        delay(1);
+      }
+      if (rc == TaskManager::RUN_OK) {
+        active.push_back(handle);
+        runs++;
+      }
+    }
+    for (uint32_t handle : active) {
+      while (tasks.isRunActive(handle)) {
+        events.pump();
+        delay(1);
+      }
+    }
+  }
+  run.report(runs);
+
+  size_t bytes = 0;
+  Phase list("list");
+  for (size_t i = 0; i < listCount; i++) bytes += listTasks();
+  list.report(listCount);
+
+  tasks.flush();
+  fprintf(stderr, "list body %zu bytes, free heap %u, min free heap %u\n",
+          listCount ? bytes / listCount : 0, (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap());
+  delay(LOG_DRAIN_MS * 2); // let the drain task print the last lines
+  return 0;
+}
@@ -0,0 +1,100 @@
+"""
+Compares task engine benchmark results with the stored baseline.
+
+The results come from the native-bench program (native/bench/bench_main.cpp).
+Every case is matched with the baseline by name, task count and script size,
+and the change of ns/op, allocations per op and peak heap is printed. The
+exit status is 1 if any case got slower or allocates more than the threshold
+(in percent), so the comparison can gate a change to the task engine.
+
+    python scripts/bench_compare.py [results] [--baseline file] [--threshold pct]
+    python scripts/bench_compare.py [results] --update
+
+--update stores the results as the new baseline; record it on the machine
+the comparisons run on, since timings from different hosts do not compare.
+"""
+import argparse
+import json
+import os
+import shutil
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_RESULTS = os.path.join(ROOT, ".pio", "bench.json")
+DEFAULT_BASELINE = os.path.join(ROOT, "native", "bench", "baseline.json")
+
+
+def load(path):
+    """Reads a results file into a dict keyed by (name, tasks, size)."""
+    with open(path) as f:
+        doc = json.load(f)
+    return {(r["name"], r["tasks"], r["size"]): r for r in doc["results"]}
+
+
+def change(new, old):
+    """Relative change in percent, None when there is no base to compare with."""
+    if not old:
+        return None
+    return (new - old) * 100.0 / old
+
+
+def fmt(pct):
+    return "     n/a" if pct is None else "%+7.1f%%" % pct
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("results", nargs="?", default=DEFAULT_RESULTS)
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed slowdown of ns/op in percent (default 10)")
+    parser.add_argument("--update", action="store_true", help="store the results as the baseline")
+    args = parser.parse_args()
+
+    if args.update:
+        load(args.results)  # refuse to store a broken file
+        shutil.copyfile(args.results, args.baseline)
+        print("baseline updated: %s" % args.baseline)
+        return 0
+    if not os.path.exists(args.baseline):
+        print("no baseline at %s; store one with --update" % args.baseline)
+        return 1
+
+    new = load(args.results)
+    old = load(args.baseline)
+    failed = []
+    print("%-18s %5s %6s %12s %8s %10s %8s %10s" %
+          ("case", "tasks", "size", "ns/op", "delta", "allocs/op", "delta", "peak"))
+    for key in sorted(new, key=lambda k: (k[0], k[1], k[2])):
+        r = new[key]
+        base = old.get(key)
+        if base is None:
+            print("%-18s %5d %6d %12.0f %8s %10.1f %8s %10d  (new)" %
+                  (key + (r["ns_per_op"], "", r["allocs_per_op"], "", r["peak_heap"])))
+            continue
+        dt = change(r["ns_per_op"], base["ns_per_op"])
+        da = change(r["allocs_per_op"], base["allocs_per_op"])
+        mark = ""
+        if dt is not None and dt > args.threshold:
+            mark = "  SLOWER"
+            failed.append(key)
+        # Background threads add a little noise to the process-wide counts
+        if da is not None and da > args.threshold and r["allocs_per_op"] - base["allocs_per_op"] > 0.5:
+            mark += "  MORE ALLOCS"
+            if key not in failed:
+                failed.append(key)
+        print("%-18s %5d %6d %12.0f %s %10.1f %s %10d%s" %
+              (key[0], key[1], key[2], r["ns_per_op"], fmt(dt), r["allocs_per_op"], fmt(da),
+               r["peak_heap"], mark))
+    for key in sorted(set(old) - set(new)):
+        print("%-18s %5d %6d  missing from the results" % key)
+
+    if failed:
+        print("%d of %d cases regressed" % (len(failed), len(new)))
+        return 1
+    print("no regressions in %d cases" % len(new))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,123 @@
+"""
+Build step for the web UI assets.
+
+As a PlatformIO pre-script it copies data/ to $BUILD_DIR/data before the
+filesystem image is built, stores the text assets (.html, .js, .css, .json,
+.svg) gzip-compressed as "<name>.gz" where that makes them smaller, and points
+the image builder at the copy. WebUI serves the ".gz" files with
+Content-Encoding: gzip.
+
+With -DWEBUI_EMBED_ASSETS in build_flags it also generates
+$BUILD_DIR/webui/WebAssets.h, which embeds the same files in flash as PROGMEM
+arrays, so the UI works without a filesystem image.
+
+It can also be run by hand:
+    python scripts/compress_assets.py [data_dir] [out_dir] [header]
+"""
+import gzip
+import os
+import shutil
+import sys
+
+COMPRESS = {".html", ".htm", ".js", ".css", ".json", ".svg", ".txt"}
+
+MIME = {
+    ".html": "text/html", ".htm": "text/html", ".js": "application/javascript",
+    ".css": "text/css", ".json": "application/json", ".svg": "image/svg+xml",
+    ".png": "image/png", ".jpg": "image/jpeg", ".gif": "image/gif",
+    ".ico": "image/x-icon", ".txt": "text/plain",
+}
+
+
+def fnv1a(data, h=2166136261):
+    """FNV-1a, as ScriptCache::hash() computes it on the device."""
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def build_assets(src, dst):
+    """Copies src to dst, compressing text assets. Returns (url, content, gzip, mime) tuples."""
+    shutil.rmtree(dst, ignore_errors=True)
+    assets = []
+    saved = 0
+    for root, dirs, files in os.walk(src):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, src).replace(os.sep, "/")
+            ext = os.path.splitext(name)[1].lower()
+            with open(path, "rb") as f:
+                data = f.read()
+            out = os.path.join(dst, rel)
+            os.makedirs(os.path.dirname(out), exist_ok=True)
+            packed = gzip.compress(data, 9, mtime=0) if ext in COMPRESS else None
+            if packed is not None and len(packed) < len(data):
+                with open(out + ".gz", "wb") as f:
+                    f.write(packed)
+                saved += len(data) - len(packed)
+                assets.append(("/" + rel, packed, True, MIME.get(ext, "text/plain")))
+            else:
+                shutil.copyfile(path, out)
+                assets.append(("/" + rel, data, False, MIME.get(ext, "application/octet-stream")))
+    print("compress_assets: %d files, %d bytes saved" % (len(assets), saved))
+    return assets
+
+
+def write_header(assets, path):
+    """Writes the PROGMEM table read by WebUI in WEBUI_EMBED_ASSETS builds."""
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    lines = [
+        "// Generated by scripts/compress_assets.py, do not edit.",
+        "#pragma once",
+        "",
+        "#include <pgmspace.h>",
+        '#include "WebUI.h"',
+        "",
+    ]
+    for i, (url, data, _, _) in enumerate(assets):
+        lines.append("static const uint8_t WEB_ASSET_%d[] PROGMEM = {" % i)
+        for off in range(0, len(data), 16):
+            lines.append("  " + ",".join("0x%02x" % b for b in data[off:off + 16]) + ",")
+        lines.append("};")
+    lines.append("")
+    lines.append("static const WebAsset WEB_ASSETS[] = {")
+    for i, (url, data, packed, mime) in enumerate(assets):
+        lines.append('  { "%s", "%s", WEB_ASSET_%d, %d, "\\"%08x\\"", %s },'
+                     % (url, mime, i, len(data), fnv1a(data), "true" if packed else "false"))
+    lines.append("};")
+    lines.append("static const size_t WEB_ASSET_COUNT = %d;" % len(assets))
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main(argv):
+    src = argv[1] if len(argv) > 1 else "data"
+    dst = argv[2] if len(argv) > 2 else os.path.join(".pio", "data_gz")
+    assets = build_assets(src, dst)
+    if len(argv) > 3:
+        write_header(assets, argv[3])
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+except NameError:
+    env = None
+
+if env is not None:
+    build_dir = env.subst("$BUILD_DIR")
+    flags = env.GetProjectOption("build_flags", "")
+    if isinstance(flags, str):
+        flags = flags.splitlines()
+    embed = any(f.strip().split("=")[0] == "-DWEBUI_EMBED_ASSETS" for f in flags)
+    fs_targets = {"buildfs", "uploadfs", "uploadfsota"}
+    if embed or fs_targets & set(COMMAND_LINE_TARGETS):  # noqa: F821
+        out_dir = os.path.join(build_dir, "data")
+        assets = build_assets(env.subst("$PROJECT_DATA_DIR"), out_dir)
+        env.Replace(PROJECT_DATA_DIR=out_dir)
+        if embed:
+            header_dir = os.path.join(build_dir, "webui")
+            write_header(assets, os.path.join(header_dir, "WebAssets.h"))
+            env.Append(CPPPATH=[header_dir])
+elif __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,203 @@
+/**
+ * @file AtomicFile.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the AtomicFile class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "AtomicFile.h"
+#include "Logger.h"
+
+static const char FOOTER_PREFIX[] = "\n--crc32:";
+
+/**
+ * @brief Starts replacing a file.
+ */
+AtomicFile::AtomicFile(const String &path, bool checksum)
+  : _path(path), _tmp(path + ".tmp"), _checksum(checksum) {
+  _file = LittleFS.open(_tmp, FILE_WRITE);
+  _ok = (bool)_file;
+}
+
+/**
+ * @brief Discards the new content unless it was committed.
+ */
+AtomicFile::~AtomicFile() {
+  abort();
+}
+
+/**
+ * @brief Appends data to the new content.
+ */
+size_t AtomicFile::write(const uint8_t *data, size_t len) {
+  if (!_ok) return 0;
+  size_t n = _file.write(data, len);
+  if (_checksum) _crc = crc32(data, n, _crc);
+  if (n != len) _ok = false;
+  return n;
+}
+
+/**
+ * @brief Writes the footer, flushes the temp file and renames it over the target.
+ */
+bool AtomicFile::commit() {
+  if (!_file) return false;
+  if (_ok && _checksum) {
+    char footer[FOOTER_SIZE + 1];
+    snprintf(footer, sizeof(footer), "%s%08x\n", FOOTER_PREFIX, (unsigned)_crc);
+    _ok = _file.write((const uint8_t*)footer, FOOTER_SIZE) == FOOTER_SIZE;
+  }
+  // The content must be on flash before the rename makes it visible
+  if (_ok) _file.flush();
+  _file.close();
+  if (_ok) _ok = replace(_tmp, _path);
+  if (!_ok) {
+    LittleFS.remove(_tmp);
+    Logger::error("fs", nullptr, "failed to save %s", _path.c_str());
+  }
+  return _ok;
+}
+
+/**
+ * @brief Removes the temp file.
+ */
+void AtomicFile::abort() {
+  if (!_file) return;
+  _file.close();
+  LittleFS.remove(_tmp);
+  _ok = false;
+}
+
+/**
+ * @brief Replaces a file with the given content in one step.
+ */
+bool AtomicFile::write(const String &path, const uint8_t *data, size_t len, bool checksum) {
+  AtomicFile f(path, checksum);
+  f.write(data, len);
+  return f.commit();
+}
+
+/**
+ * @brief Parses a footer.
+ */
+bool AtomicFile::_parseFooter(const char *tail, uint32_t &crc) {
+  size_t prefix = sizeof(FOOTER_PREFIX) - 1;
+  if (memcmp(tail, FOOTER_PREFIX, prefix) != 0 || tail[FOOTER_SIZE - 1] != '\n') return false;
+  crc = 0;
+  for (size_t i = prefix; i < FOOTER_SIZE - 1; i++) {
+    char c = tail[i];
+    uint8_t v;
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else return false;
+    crc = (crc << 4) | v;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a file, removing a checksum footer.
+ */
+AtomicStatus AtomicFile::read(const String &path, String &content) {
+  content = "";
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) return ATOMIC_MISSING;
+  content = f.readString();
+  f.close();
+  uint32_t crc;
+  if (content.length() < FOOTER_SIZE ||
+      !_parseFooter(content.c_str() + content.length() - FOOTER_SIZE, crc)) return ATOMIC_UNCHECKED;
+  content.remove(content.length() - FOOTER_SIZE);
+  return crc32((const uint8_t*)content.c_str(), content.length()) == crc ? ATOMIC_OK : ATOMIC_CORRUPT;
+}
+
+/**
+ * @brief Checks the footer of a file without loading it into RAM.
+ */
+AtomicStatus AtomicFile::verify(const String &path) {
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f || f.isDirectory()) return ATOMIC_MISSING;
+  size_t size = f.size();
+  char tail[FOOTER_SIZE];
+  uint32_t expected;
+  if (size < FOOTER_SIZE || !f.seek(size - FOOTER_SIZE) ||
+      f.read((uint8_t*)tail, FOOTER_SIZE) != FOOTER_SIZE || !_parseFooter(tail, expected)) {
+    f.close();
+    return ATOMIC_UNCHECKED;
+  }
+  f.seek(0);
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  size_t left = size - FOOTER_SIZE;
+  while (left > 0) {
+    size_t n = f.read(buf, left < sizeof(buf) ? left : sizeof(buf));
+    if (n == 0) break;
+    crc = crc32(buf, n, crc);
+    left -= n;
+  }
+  f.close();
+  return left == 0 && crc == expected ? ATOMIC_OK : ATOMIC_CORRUPT;
+}
+
+/**
+ * @brief Gets the length of an open file without its checksum footer.
+ */
+size_t AtomicFile::contentLength(File &file) {
+  size_t size = file.size();
+  char tail[FOOTER_SIZE];
+  uint32_t crc;
+  bool footer = size >= FOOTER_SIZE && file.seek(size - FOOTER_SIZE) &&
+                file.read((uint8_t*)tail, FOOTER_SIZE) == FOOTER_SIZE && _parseFooter(tail, crc);
+  file.seek(0);
+  return footer ? size - FOOTER_SIZE : size;
+}
+
+/**
+ * @brief Removes a trailing checksum footer from a string.
+ */
+bool AtomicFile::stripFooter(String &content) {
+  uint32_t crc;
+  if (content.length() < FOOTER_SIZE ||
+      !_parseFooter(content.c_str() + content.length() - FOOTER_SIZE, crc)) return false;
+  content.remove(content.length() - FOOTER_SIZE);
+  return true;
+}
+
+/**
+ * @brief Finishes or discards an interrupted save of a file.
+ */
+bool AtomicFile::recover(const String &path) {
+  String tmp = path + ".tmp";
+  if (!LittleFS.exists(tmp)) return false;
+  // Without the target the temp file may be the only copy left by replace()
+  if (!LittleFS.exists(path) && verify(tmp) == ATOMIC_OK && LittleFS.rename(tmp, path)) {
+    Logger::warn("fs", nullptr, "completed interrupted save of %s", path.c_str());
+    return true;
+  }
+  LittleFS.remove(tmp);
+  Logger::warn("fs", nullptr, "discarded interrupted save of %s", path.c_str());
+  return true;
+}
+
+/**
+ * @brief Renames a file over another one.
+ */
+bool AtomicFile::replace(const String &from, const String &to) {
+  if (LittleFS.rename(from, to)) return true;
+  LittleFS.remove(to);
+  return LittleFS.rename(from, to);
+}
+
+/**
+ * @brief Computes a CRC-32 (IEEE 802.3) checksum.
+ */
+uint32_t AtomicFile::crc32(const uint8_t *data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file EventHub.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the EventHub class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "EventHub.h"
+#include <ArduinoJson.h>
+
+/**
+ * @brief Creates the hub.
+ */
+EventHub::EventHub(const char *url) : _source(url) {}
+
+/**
+ * @brief Registers the event stream with the web server.
+ */
+void EventHub::begin(AsyncWebServer &server) {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  _source.onConnect([this](AsyncEventSourceClient *client) { _replay(client); });
+  server.addHandler(&_source);
+}
+
+/**
+ * @brief Queues an event for the clients.
+ */
+bool EventHub::publish(const char *event, const char *data) {
+  size_t len = strlen(data);
+  if (len >= EVENT_DATA_SIZE) {
+    _dropped++;
+    return false;
+  }
+  if (!_mutex || xSemaphoreTake(_mutex, pdMS_TO_TICKS(EVENT_LOCK_MS)) != pdTRUE) {
+    _dropped++;
+    return false;
+  }
+  // A full ring loses its oldest unsent event
+  if (_next - _sent >= EVENT_RING_SIZE) {
+    _sent++;
+    _dropped++;
+  }
+  Event &e = _ring[_next % EVENT_RING_SIZE];
+  e.seq = _next++;
+  strlcpy(e.name, event, sizeof(e.name));
+  memcpy(e.data, data, len + 1);
+  xSemaphoreGive(_mutex);
+  return true;
+}
+
+/**
+ * @brief Publishes a task transition.
+ */
+bool EventHub::publishTask(const char *id, const char *state, uint32_t run) {
+  StaticJsonDocument<128> doc;
+  doc["id"] = id;
+  doc["state"] = state;
+  doc["run"] = run;
+  char data[EVENT_DATA_SIZE];
+  serializeJson(doc, data, sizeof(data));
+  return publish("task", data);
+}
+
+/**
+ * @brief Publishes a line logged by a script.
+ */
+bool EventHub::publishLog(const char *id, uint32_t run, const char *msg) {
+  char line[EVENT_DATA_SIZE];
+  size_t len = strlen(msg);
+  if (len >= sizeof(line)) len = sizeof(line) - 1;
+  memcpy(line, msg, len);
+  StaticJsonDocument<128> doc;
+  doc["id"] = id;
+  doc["run"] = run;
+  char data[EVENT_DATA_SIZE];
+  while (true) {
+    // Escapes may grow the text; shorten it (on a UTF-8 boundary) until it fits
+    while (len > 0 && ((uint8_t)msg[len] & 0xC0) == 0x80) len--;
+    line[len] = '\0';
+    doc["msg"] = (const char*)line;
+    if (measureJson(doc) < sizeof(data) || len == 0) break;
+    len = len * 3 / 4;
+  }
+  serializeJson(doc, data, sizeof(data));
+  return publish("log", data);
+}
+
+/**
+ * @brief Copies the event with a given sequence number out of the ring.
+ */
+bool EventHub::_read(uint32_t seq, Event &out) {
+  if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return false;
+  const Event &e = _ring[seq % EVENT_RING_SIZE];
+  bool ok = e.seq == seq;
+  if (ok) out = e;
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Sends the retained events after the client's last ID to a reconnecting client.
+ */
+void EventHub::_replay(AsyncEventSourceClient *client) {
+  uint32_t last = client->lastId();
+  if (last == 0 || !_mutex) return; // a new subscriber starts with live events
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  uint32_t first = _next > EVENT_RING_SIZE ? _next - EVENT_RING_SIZE : 1;
+  uint32_t end = _sent; // newer events reach the client through pump()
+  xSemaphoreGive(_mutex);
+  if (last >= end) return; // nothing missed, or an ID from before a restart
+  for (uint32_t seq = last + 1 < first ? first : last + 1; seq < end; seq++) {
+    Event e;
+    if (_read(seq, e)) client->send(e.data, e.name, e.seq);
+  }
+}
+
+/**
+ * @brief Hands queued events to the clients.
+ */
+void EventHub::pump() {
+  if (!_mutex) return;
+  if (_source.count() == 0) {
+    // Without subscribers the events only stay available for replay
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _sent = _next;
+    xSemaphoreGive(_mutex);
+    _reported = _dropped.load();
+    return;
+  }
+  uint32_t dropped = _dropped.load();
+  if (dropped != _reported) {
+    char data[32];
+    snprintf(data, sizeof(data), "{\"count\":%u}", (unsigned)(dropped - _reported));
+    _source.send(data, "dropped");
+    _reported = dropped;
+  }
+  for (int i = 0; i < EVENT_PUMP_BATCH; i++) {
+    // Slow clients keep the events in the ring instead of in their send queues
+    if (_source.avgPacketsWaiting() >= EVENT_CLIENT_QUEUE) break;
+    Event e;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    bool pending = _sent != _next;
+    if (pending) e = _ring[_sent++ % EVENT_RING_SIZE];
+    xSemaphoreGive(_mutex);
+    if (!pending) break;
+    _source.send(e.data, e.name, e.seq);
+  }
+}
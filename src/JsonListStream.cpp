@@ -0,0 +1,111 @@
+/**
+ * @file JsonListStream.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the JsonListStream class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "JsonListStream.h"
+#include "Logger.h"
+
+/**
+ * @brief Creates a stream.
+ */
+JsonListStream::JsonListStream(const char *key, Producer next, Fields head, Fields tail)
+  : _key(key), _next(next), _head(head), _tail(tail) {}
+
+/**
+ * @brief Sends a stream as a chunked application/json response.
+ */
+void JsonListStream::send(AsyncWebServerRequest *request, std::shared_ptr<JsonListStream> stream, const String &etag) {
+  // The filler owns the stream; it is destroyed together with the response
+  AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+    [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return stream->read(buffer, maxLen);
+    });
+  if (etag.length() > 0) {
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+  }
+  request->send(response);
+}
+
+/**
+ * @brief Writes the next part of the response.
+ */
+size_t JsonListStream::read(uint8_t *buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (_pos == _len) {
+      _pos = _len = 0;
+      if (!_fill()) break;
+    }
+    size_t n = _len - _pos;
+    if (n > maxLen - written) n = maxLen - written;
+    memcpy(buffer + written, _pending + _pos, n);
+    _pos += n;
+    written += n;
+  }
+  return written;
+}
+
+/**
+ * @brief Serializes a set of fields without their enclosing braces.
+ */
+size_t JsonListStream::_fields(const Fields &fields, char *out, size_t size) {
+  if (!fields) return 0;
+  StaticJsonDocument<JSON_STREAM_ENTRY_SIZE> doc;
+  fields(doc.to<JsonObject>());
+  if (doc.overflowed() || measureJson(doc) >= size) {
+    Logger::warn("json", nullptr, "fields of '%s' do not fit", _key.c_str());
+    return 0;
+  }
+  size_t n = serializeJson(doc, out, size);
+  if (n <= 2) return 0; // "{}"
+  memmove(out, out + 1, n - 2);
+  return n - 2;
+}
+
+/**
+ * @brief Serializes the next piece of the response into the pending buffer.
+ */
+bool JsonListStream::_fill() {
+  const size_t size = sizeof(_pending);
+  switch (_phase) {
+    case PHASE_HEAD: {
+      _pending[_len++] = '{';
+      size_t n = _fields(_head, _pending + _len, size - _len - _key.length() - 6);
+      _len += n;
+      _len += snprintf(_pending + _len, size - _len, "%s\"%s\":[", n ? "," : "", _key.c_str());
+      _phase = PHASE_ENTRIES;
+      return true;
+    }
+    case PHASE_ENTRIES:
+      while (true) {
+        StaticJsonDocument<JSON_STREAM_ENTRY_SIZE> doc;
+        if (!_next(doc.to<JsonObject>())) break;
+        if (doc.overflowed() || measureJson(doc) > JSON_STREAM_BUFFER_SIZE) {
+          Logger::warn("json", nullptr, "skipped an oversized entry of '%s'", _key.c_str());
+          continue;
+        }
+        if (_entries++ > 0) _pending[_len++] = ',';
+        _len += serializeJson(doc, _pending + _len, size - _len);
+        return true;
+      }
+      _phase = PHASE_TAIL;
+      // fall through
+    case PHASE_TAIL: {
+      _pending[_len++] = ']';
+      size_t n = _fields(_tail, _pending + _len + 1, size - _len - 2);
+      if (n) {
+        _pending[_len] = ',';
+        _len += n + 1;
+      }
+      _pending[_len++] = '}';
+      _phase = PHASE_DONE;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
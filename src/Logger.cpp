@@ -0,0 +1,238 @@
+/**
+ * @file Logger.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the Logger class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Logger.h"
+#include <LittleFS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @struct LogSlot
+ * @brief A ring slot: the entry and its state word.
+ *
+ * The state is the sequence number of the committed entry, or that number with
+ * LOG_SLOT_BUSY set while a producer writes the slot.
+ */
+struct LogSlot {
+  std::atomic<uint32_t> state;
+  LogEntry entry;
+};
+
+static const uint32_t LOG_SLOT_BUSY = 0x80000000u;
+static const uint32_t LOG_SEQ_MASK = 0x7FFFFFFFu;
+
+static LogSlot s_ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> s_next{1};     // next sequence number
+static std::atomic<uint32_t> s_dropped{0};  // entries lost before they were drained
+static uint32_t s_drained = 1;              // next entry for the drain task
+static uint8_t s_stalled = 0;               // drain passes spent waiting for s_drained
+static char s_fileBuf[1024];                // lines waiting for the log file
+static size_t s_fileLen = 0;
+static uint32_t s_fileSince = 0;            // millis() of the oldest buffered line
+static TaskHandle_t s_drainHandle = nullptr;
+
+/**
+ * @brief Starts the drain task.
+ */
+void Logger::begin() {
+  if (s_drainHandle) return;
+  if (!LittleFS.exists("/logs")) LittleFS.mkdir("/logs");
+  xTaskCreate(_drainTask, "logDrain", 4096, nullptr, 1, &s_drainHandle);
+}
+
+/**
+ * @brief Records a log line.
+ */
+void Logger::write(LogLevel level, const char *tag, const char *task, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _vwrite(level, tag, task, fmt, args);
+  va_end(args);
+}
+
+/**
+ * @brief Records an error.
+ */
+void Logger::error(const char *tag, const char *task, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _vwrite(LOG_LEVEL_ERROR, tag, task, fmt, args);
+  va_end(args);
+}
+
+/**
+ * @brief Records a warning.
+ */
+void Logger::warn(const char *tag, const char *task, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _vwrite(LOG_LEVEL_WARN, tag, task, fmt, args);
+  va_end(args);
+}
+
+/**
+ * @brief Records an informational line.
+ */
+void Logger::info(const char *tag, const char *task, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _vwrite(LOG_LEVEL_INFO, tag, task, fmt, args);
+  va_end(args);
+}
+
+/**
+ * @brief Records a debug line.
+ */
+void Logger::debug(const char *tag, const char *task, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  _vwrite(LOG_LEVEL_DEBUG, tag, task, fmt, args);
+  va_end(args);
+}
+
+/**
+ * @brief Formats a line into its own slot of the ring.
+ */
+void Logger::_vwrite(LogLevel level, const char *tag, const char *task, const char *fmt, va_list args) {
+  if (level > LOG_LEVEL) return;
+  uint32_t seq = s_next.fetch_add(1, std::memory_order_relaxed) & LOG_SEQ_MASK;
+  LogSlot &slot = s_ring[seq & (LOG_RING_SIZE - 1)];
+  // Claim the slot; it may still be written by a producer one lap behind, or
+  // already hold a newer entry if this producer was preempted for a whole lap
+  uint32_t cur = slot.state.load(std::memory_order_acquire);
+  if ((cur & LOG_SLOT_BUSY) || (int32_t)(cur - seq) > 0 ||
+      !slot.state.compare_exchange_strong(cur, seq | LOG_SLOT_BUSY, std::memory_order_acq_rel)) {
+    s_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  LogEntry &e = slot.entry;
+  e.seq = seq;
+  e.ms = millis();
+  e.level = level;
+  strlcpy(e.tag, tag ? tag : "", sizeof(e.tag));
+  strlcpy(e.task, task ? task : "", sizeof(e.task));
+  vsnprintf(e.msg, sizeof(e.msg), fmt, args);
+  slot.state.store(seq, std::memory_order_release);
+}
+
+/**
+ * @brief Copies an entry out of the ring.
+ */
+bool Logger::read(uint32_t seq, LogEntry &out) {
+  const LogSlot &slot = s_ring[seq & (LOG_RING_SIZE - 1)];
+  if (slot.state.load(std::memory_order_acquire) != seq) return false;
+  out = slot.entry;
+  // A producer that claimed the slot meanwhile has changed the state
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.state.load(std::memory_order_relaxed) == seq;
+}
+
+/**
+ * @brief Gets the sequence number the next entry will get.
+ */
+uint32_t Logger::next() {
+  return s_next.load(std::memory_order_relaxed) & LOG_SEQ_MASK;
+}
+
+/**
+ * @brief Gets the oldest sequence number that may still be in the ring.
+ */
+uint32_t Logger::oldest() {
+  uint32_t n = next();
+  return n > LOG_RING_SIZE ? n - LOG_RING_SIZE : 1;
+}
+
+/**
+ * @brief Gets the number of entries lost before they were drained.
+ */
+uint32_t Logger::dropped() {
+  return s_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Gets the name of a level.
+ */
+const char* Logger::levelName(uint8_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR: return "error";
+    case LOG_LEVEL_WARN:  return "warn";
+    case LOG_LEVEL_INFO:  return "info";
+    default:              return "debug";
+  }
+}
+
+/**
+ * @brief The drain task.
+ */
+void Logger::_drainTask(void *pvParameters) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    _drain();
+  }
+}
+
+/**
+ * @brief Forwards the new entries to Serial and the file buffer.
+ */
+void Logger::_drain() {
+  uint32_t end = next();
+  if (end - s_drained > LOG_RING_SIZE) {
+    // Lapped: the producers overwrote entries that were never drained
+    s_dropped.fetch_add(end - LOG_RING_SIZE - s_drained, std::memory_order_relaxed);
+    s_drained = end - LOG_RING_SIZE;
+  }
+  while (s_drained != end) {
+    LogEntry e;
+    if (!read(s_drained, e)) {
+      uint32_t state = s_ring[s_drained & (LOG_RING_SIZE - 1)].state.load(std::memory_order_acquire);
+      bool newer = !(state & LOG_SLOT_BUSY) && (int32_t)(state - s_drained) > 0;
+      // A producer may be between reserving the number and committing the
+      // slot; give it a few passes, then treat the entry as lost
+      if (!newer && ++s_stalled < 3) break;
+      s_stalled = 0;
+      s_drained++;
+      continue;
+    }
+    s_stalled = 0;
+    s_drained++;
+
+    char line[LOG_MSG_SIZE + 48];
+    int len = snprintf(line, sizeof(line), "[%7lu][%c][%s]%s%s%s %s\n", (unsigned long)e.ms,
+                       "EWID"[e.level & 3], e.tag, e.task[0] ? "[" : "", e.task, e.task[0] ? "]" : "", e.msg);
+    if (len <= 0) continue;
+    if ((size_t)len >= sizeof(line)) len = sizeof(line) - 1;
+    Serial.write((const uint8_t*)line, len);
+    if (e.level <= LOG_FILE_LEVEL) {
+      if (s_fileLen + len > sizeof(s_fileBuf)) _flushFile();
+      if (s_fileLen == 0) s_fileSince = millis();
+      memcpy(s_fileBuf + s_fileLen, line, len);
+      s_fileLen += len;
+    }
+  }
+  if (s_fileLen && millis() - s_fileSince >= LOG_FILE_FLUSH_MS) _flushFile();
+}
+
+/**
+ * @brief Appends the file buffer to the log file, rotating it when full.
+ */
+void Logger::_flushFile() {
+  if (s_fileLen == 0) return;
+  File f = LittleFS.open(LOG_FILE_PATH, FILE_APPEND);
+  if (!f) {
+    s_fileLen = 0; // without a filesystem the lines only go to Serial
+    return;
+  }
+  f.write((const uint8_t*)s_fileBuf, s_fileLen);
+  size_t size = f.size();
+  f.close();
+  s_fileLen = 0;
+  if (size >= LOG_FILE_MAX) {
+    LittleFS.remove(LOG_FILE_PATH ".1");
+    LittleFS.rename(LOG_FILE_PATH, LOG_FILE_PATH ".1");
+  }
+}
@@ -0,0 +1,168 @@
+/**
+ * @file LuaArena.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the LuaArena class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "LuaArena.h"
+#include <esp_heap_caps.h>
+
+// Payload sizes of the size classes; larger blocks come from the heap
+const uint16_t LuaArena::CLASS_SIZE[LuaArena::CLASS_COUNT] = { 8, 16, 24, 32, 48, 64, 96, 128, 192 };
+
+/**
+ * @brief Creates an empty arena.
+ */
+LuaArena::LuaArena(bool usePsram) {
+  _psram = usePsram && heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+/**
+ * @brief Releases the chunks.
+ */
+LuaArena::~LuaArena() {
+  while (_chunkList) {
+    void *next = *(void**)_chunkList;
+    heap_caps_free(_chunkList);
+    _chunkList = next;
+  }
+}
+
+/**
+ * @brief Gets the smallest size class holding a payload of n bytes.
+ */
+uint8_t LuaArena::_classOf(size_t n) {
+  for (uint8_t c = 0; c < CLASS_COUNT; c++) {
+    if (n <= CLASS_SIZE[c]) return c;
+  }
+  return CLASS_HEAP;
+}
+
+/**
+ * @brief Gets the payload capacity of a block.
+ */
+size_t LuaArena::_capacity(const Header *h, size_t size) {
+  return h->cls == CLASS_HEAP ? size : CLASS_SIZE[h->cls];
+}
+
+/**
+ * @brief Accounts n bytes to an owner, refusing to exceed its cap.
+ */
+bool LuaArena::_charge(uint8_t owner, size_t n) {
+  if (owner && _limit[owner] && _used[owner] + n > _limit[owner]) return false;
+  _used[owner] += n;
+  if (_used[owner] > _peak[owner]) _peak[owner] = _used[owner];
+  return true;
+}
+
+/**
+ * @brief Returns n bytes to the budget of an owner.
+ */
+void LuaArena::_credit(uint8_t owner, size_t n) {
+  // Blocks that outlive their run (e.g. shared strings) may be freed after
+  // the owner was reset
+  _used[owner] = _used[owner] > n ? _used[owner] - n : 0;
+}
+
+/**
+ * @brief Takes a block of a size class from the newest chunk.
+ */
+void* LuaArena::_carve(uint8_t cls) {
+  size_t block = sizeof(Header) + CLASS_SIZE[cls];
+  if (_left < block) {
+    if (_chunks >= LUA_ARENA_MAX_CHUNKS) return nullptr;
+    // Chunks stay in internal RAM; small objects are accessed most often
+    uint8_t *chunk = (uint8_t*)heap_caps_malloc(LUA_ARENA_CHUNK_SIZE, MALLOC_CAP_8BIT);
+    if (!chunk) return nullptr;
+    *(void**)chunk = _chunkList;
+    _chunkList = chunk;
+    _chunks++;
+    _bump = chunk + sizeof(void*);
+    _left = LUA_ARENA_CHUNK_SIZE - sizeof(void*);
+  }
+  void *p = _bump;
+  _bump += block;
+  _left -= block;
+  return p;
+}
+
+/**
+ * @brief Allocates a block with a payload of n bytes for the current owner.
+ */
+void* LuaArena::_allocate(size_t n) {
+  if (!_charge(_owner, n)) return nullptr;
+  uint8_t cls = _classOf(n);
+  Header *h = nullptr;
+  if (cls != CLASS_HEAP) {
+    if (_free[cls]) {
+      h = (Header*)_free[cls];
+      _free[cls] = *(void**)(h + 1);
+    } else {
+      h = (Header*)_carve(cls);
+    }
+    if (!h) cls = CLASS_HEAP; // arena exhausted, use the heap
+  }
+  if (!h) {
+    size_t size = sizeof(Header) + n;
+    if (_psram) h = (Header*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!h) h = (Header*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    if (!h) {
+      _credit(_owner, n);
+      return nullptr;
+    }
+  }
+  h->owner = _owner;
+  h->cls = cls;
+  return h + 1;
+}
+
+/**
+ * @brief Frees a block whose payload is n bytes as seen by Lua.
+ */
+void LuaArena::_release(void *ptr, size_t n) {
+  Header *h = (Header*)ptr - 1;
+  _credit(h->owner, n);
+  if (h->cls == CLASS_HEAP) {
+    heap_caps_free(h);
+    return;
+  }
+  *(void**)ptr = _free[h->cls];
+  _free[h->cls] = h;
+}
+
+/**
+ * @brief Resets the counters of an owner and sets its cap.
+ */
+void LuaArena::beginOwner(uint8_t owner, uint32_t limit) {
+  if (owner == 0 || owner >= LUA_ARENA_OWNERS) return;
+  _used[owner] = 0;
+  _peak[owner] = 0;
+  _limit[owner] = limit;
+}
+
+/**
+ * @brief The lua_Alloc function.
+ */
+void* LuaArena::alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+  LuaArena *a = (LuaArena*)ud;
+  if (nsize == 0) {
+    if (ptr) a->_release(ptr, osize);
+    return nullptr;
+  }
+  // Without a block osize only tells the type of the new object
+  if (!ptr) return a->_allocate(nsize);
+
+  Header *h = (Header*)ptr - 1;
+  if (nsize <= _capacity(h, osize)) {
+    // Fits in place; shrinking never fails, as Lua requires
+    if (nsize > osize && !a->_charge(h->owner, nsize - osize)) return nullptr;
+    if (nsize < osize) a->_credit(h->owner, osize - nsize);
+    return ptr;
+  }
+  void *grown = a->_allocate(nsize);
+  if (!grown) return nullptr;
+  memcpy(grown, ptr, osize);
+  a->_release(ptr, osize);
+  return grown;
+}
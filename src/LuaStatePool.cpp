@@ -0,0 +1,134 @@
+/**
+ * @file LuaStatePool.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the LuaStatePool class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "LuaStatePool.h"
+#include "LuaArena.h"
+#include <lua/lua.hpp>
+#include "Logger.h"
+
+// Registry key of the metatable shared by all sandbox environments
+static const char *ENV_META = "wp.envmeta";
+
+/**
+ * @brief Reports an unprotected Lua error before the runtime aborts.
+ */
+static int panic(lua_State *L) {
+  const char *msg = lua_tostring(L, -1);
+  Serial.printf("PANIC: unprotected error in Lua: %s\n", msg ? msg : "?");
+  return 0;
+}
+
+/**
+ * @brief Creates the states handed out first.
+ */
+void LuaStatePool::begin(size_t size, InitFunction init, bool usePsram) {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  _init = init;
+  _psram = usePsram;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  while (_idle.size() < size) {
+    lua_State *L = _create();
+    if (!L) break;
+    _idle.push_back(L);
+  }
+  Logger::info("lua", nullptr, "%u states ready", (unsigned)_idle.size());
+  xSemaphoreGive(_mutex);
+}
+
+/**
+ * @brief __index of the run environments (upvalue 1: the shared globals).
+ * A name read for the first time is copied into the environment, so later
+ * reads are plain lookups. Tables, i.e. the libraries, are copied one level
+ * deep: a run that sets string.x or math.random changes only its own copy.
+ */
+static int envIndex(lua_State *L) {
+  lua_pushvalue(L, 2);
+  if (lua_rawget(L, lua_upvalueindex(1)) == LUA_TNIL) return 1;
+  if (lua_type(L, -1) == LUA_TTABLE) {
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -3)) {
+      lua_pushvalue(L, -2);
+      lua_insert(L, -2);
+      lua_rawset(L, -4);
+    }
+    lua_remove(L, -2);
+  }
+  lua_pushvalue(L, 2);
+  lua_pushvalue(L, -2);
+  lua_rawset(L, 1);
+  return 1;
+}
+
+/**
+ * @brief Creates and initializes a new state.
+ */
+lua_State* LuaStatePool::_create() {
+  // Every state gets its own arena allocator
+  LuaArena *arena = new LuaArena(_psram);
+  lua_State *L = lua_newstate(LuaArena::alloc, arena);
+  if (!L) {
+    delete arena;
+    return nullptr;
+  }
+  lua_atpanic(L, panic);
+  luaL_openlibs(L);
+  if (_init) _init(L);
+  // { __index = envIndex } for the per-run environments
+  lua_newtable(L);
+  lua_pushglobaltable(L);
+  lua_pushcclosure(L, envIndex, 1);
+  lua_setfield(L, -2, "__index");
+  lua_setfield(L, LUA_REGISTRYINDEX, ENV_META);
+  // Strings index the shared string table; hide it from getmetatable("")
+  lua_pushliteral(L, "");
+  if (lua_getmetatable(L, -1)) {
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "__metatable");
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  lua_gc(L, LUA_GCCOLLECT, 0);
+  return L;
+}
+
+/**
+ * @brief Takes a prepared state, or creates one if none is left.
+ */
+lua_State* LuaStatePool::acquire() {
+  lua_State *L = nullptr;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  if (!_idle.empty()) {
+    L = _idle.back();
+    _idle.pop_back();
+  }
+  xSemaphoreGive(_mutex);
+  return L ? L : _create();
+}
+
+/**
+ * @brief Gets the arena allocator of a state created by the pool.
+ */
+LuaArena* LuaStatePool::arena(lua_State *L) {
+  void *ud = nullptr;
+  lua_getallocf(L, &ud);
+  return (LuaArena*)ud;
+}
+
+/**
+ * @brief Gives the function on top of the stack a fresh environment.
+ */
+void LuaStatePool::sandbox(lua_State *L) {
+  lua_newtable(L);
+  lua_getfield(L, LUA_REGISTRYINDEX, ENV_META);
+  lua_setmetatable(L, -2);
+  // _G of the run is its environment, so _G.x = ... stays in the run
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "_G");
+  // The first upvalue of a main chunk is its _ENV
+  if (!lua_setupvalue(L, -2, 1)) lua_pop(L, 1);
+}
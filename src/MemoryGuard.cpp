@@ -0,0 +1,102 @@
+/**
+ * @file MemoryGuard.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the MemoryGuard class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "MemoryGuard.h"
+#include <esp_heap_caps.h>
+#include <atomic>
+#include "Logger.h"
+
+static const char *const USE_NAMES[MEM_USE_COUNT] = { "run", "response" };
+
+static std::atomic<uint32_t> s_admitted[MEM_USE_COUNT]; // work that was allowed to start
+static std::atomic<uint32_t> s_refused[MEM_USE_COUNT];  // work answered with "low memory"
+static std::atomic<uint32_t> s_deferred{0};             // runs held back by a worker
+static std::atomic<uint32_t> s_minLargest{UINT32_MAX};  // smallest largest free block seen
+static std::atomic<bool> s_low{false};                  // result of the last check
+static std::atomic<uint32_t> s_lastLog{0};              // millis() of the last warning
+
+/**
+ * @brief Checks whether an allocation fits, without counting a decision.
+ */
+bool MemoryGuard::available(size_t bytes) {
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  uint32_t seen = s_minLargest.load();
+  while (largest < seen && !s_minLargest.compare_exchange_weak(seen, largest)) {}
+  bool ok = largest >= bytes + MEM_GUARD_RESERVE && ESP.getFreeHeap() >= bytes + MEM_GUARD_MIN_FREE;
+  s_low = !ok;
+  return ok;
+}
+
+/**
+ * @brief Decides whether work may start, counting and logging the decision.
+ */
+bool MemoryGuard::admit(MemoryUse use, size_t bytes) {
+  if (available(bytes)) {
+    s_admitted[use]++;
+    return true;
+  }
+  refused(use);
+  // One line per interval is enough to explain a burst of refusals
+  uint32_t now = millis();
+  uint32_t last = s_lastLog.load();
+  if (now - last >= MEM_GUARD_LOG_MS && s_lastLog.compare_exchange_strong(last, now)) {
+    Logger::warn("memory", nullptr, "low memory, %s of %u bytes refused (free %u, largest block %u)",
+                 USE_NAMES[use], (unsigned)bytes, (unsigned)ESP.getFreeHeap(),
+                 (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  }
+  return false;
+}
+
+/**
+ * @brief Counts a run that a worker holds back until memory is available.
+ */
+void MemoryGuard::deferred() {
+  s_deferred++;
+}
+
+/**
+ * @brief Counts refused work.
+ */
+void MemoryGuard::refused(MemoryUse use) {
+  s_refused[use]++;
+}
+
+/**
+ * @brief Checks whether the last check found the heap too low.
+ */
+bool MemoryGuard::low() {
+  return s_low;
+}
+
+/**
+ * @brief Gets the section of /api/metrics with the decisions and the watermarks.
+ */
+MetricsStream::Section MemoryGuard::metricsSection() {
+  std::shared_ptr<bool> done = std::make_shared<bool>(false);
+  return [done](String &out) {
+    if (*done) return false;
+    *done = true;
+    Metrics::family(out, "wash_mem_admitted_total", "counter", "Work started after a memory check.");
+    for (uint8_t i = 0; i < MEM_USE_COUNT; i++) {
+      Metrics::sample(out, "wash_mem_admitted_total", Metrics::label("use", USE_NAMES[i]).c_str(), (uint64_t)s_admitted[i]);
+    }
+    Metrics::family(out, "wash_mem_refused_total", "counter", "Work refused with 503 because the heap was too low or fragmented.");
+    for (uint8_t i = 0; i < MEM_USE_COUNT; i++) {
+      Metrics::sample(out, "wash_mem_refused_total", Metrics::label("use", USE_NAMES[i]).c_str(), (uint64_t)s_refused[i]);
+    }
+    Metrics::family(out, "wash_mem_deferred_total", "counter", "Queued runs a worker held back until memory was available.");
+    Metrics::sample(out, "wash_mem_deferred_total", nullptr, (uint64_t)s_deferred);
+    Metrics::family(out, "wash_mem_low", "gauge", "1 if the last memory check failed.");
+    Metrics::sample(out, "wash_mem_low", nullptr, (uint64_t)(s_low ? 1 : 0));
+    uint32_t seen = s_minLargest;
+    Metrics::family(out, "wash_heap_largest_free_block_min_bytes", "gauge",
+                    "Smallest largest free block seen by a memory check since boot.");
+    Metrics::sample(out, "wash_heap_largest_free_block_min_bytes", nullptr,
+                    (uint64_t)(seen == UINT32_MAX ? heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) : seen));
+    return true;
+  };
+}
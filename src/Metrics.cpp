@@ -0,0 +1,193 @@
+/**
+ * @file Metrics.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the Metrics and MetricsStream classes for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "Metrics.h"
+
+static const uint32_t BUCKET_US[] = { 1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000 };
+static const char *const BUCKET_LE[] = { "0.001", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5" };
+static const size_t BUCKET_COUNT = sizeof(BUCKET_US) / sizeof(BUCKET_US[0]);
+
+/**
+ * @struct RouteCounters
+ * @brief Counters of one route.
+ */
+struct RouteCounters {
+  String labels;                  ///< Formatted method and route labels.
+  uint32_t count;                 ///< Requests served.
+  uint64_t sumUs;                 ///< Total handler time.
+  uint32_t buckets[BUCKET_COUNT]; ///< Requests per duration bucket, not cumulative.
+};
+
+static std::vector<RouteCounters> s_routes; ///< Registered routes, in registration order.
+
+/**
+ * @brief Sends a stream as a chunked response.
+ */
+void MetricsStream::send(AsyncWebServerRequest *request, std::shared_ptr<MetricsStream> stream) {
+  // The filler owns the stream; it is destroyed together with the response
+  AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain; version=0.0.4",
+    [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return stream->read(buffer, maxLen);
+    });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+/**
+ * @brief Writes the next part of the response.
+ */
+size_t MetricsStream::read(uint8_t *buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (_pos == _pending.length()) {
+      _pending = "";
+      _pos = 0;
+      while (_section < _sections.size() && !_sections[_section](_pending)) _section++;
+      if (_pending.length() == 0) break;
+    }
+    size_t n = _pending.length() - _pos;
+    if (n > maxLen - written) n = maxLen - written;
+    memcpy(buffer + written, _pending.c_str() + _pos, n);
+    _pos += n;
+    written += n;
+  }
+  return written;
+}
+
+/**
+ * @brief Gets the name of a method for the "method" label.
+ */
+static const char* methodName(WebRequestMethodComposite method) {
+  switch (method) {
+    case HTTP_GET: return "GET";
+    case HTTP_POST: return "POST";
+    case HTTP_DELETE: return "DELETE";
+    case HTTP_PUT: return "PUT";
+    case HTTP_PATCH: return "PATCH";
+    case HTTP_HEAD: return "HEAD";
+    case HTTP_OPTIONS: return "OPTIONS";
+    default: return "ANY";
+  }
+}
+
+/**
+ * @brief Registers a route.
+ */
+int Metrics::addRoute(WebRequestMethodComposite method, const char *path) {
+  RouteCounters r = {};
+  r.labels = label("method", methodName(method)) + "," + label("route", path);
+  s_routes.push_back(r);
+  return (int)s_routes.size() - 1;
+}
+
+/**
+ * @brief Counts a request of a route.
+ */
+void Metrics::record(int route, uint32_t us) {
+  if (route < 0 || (size_t)route >= s_routes.size()) return;
+  RouteCounters &r = s_routes[route];
+  r.count++;
+  r.sumUs += us;
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    if (us <= BUCKET_US[i]) {
+      r.buckets[i]++;
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Gets the section with the request histograms, one route per piece.
+ */
+MetricsStream::Section Metrics::routesSection() {
+  std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+  return [next](String &out) {
+    size_t i = (*next)++;
+    if (i == 0) {
+      family(out, "wash_http_request_duration_seconds", "histogram",
+             "Time spent in the handler of an API route.");
+    }
+    if (i >= s_routes.size()) return out.length() > 0;
+    const RouteCounters &r = s_routes[i];
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < BUCKET_COUNT; b++) {
+      cumulative += r.buckets[b];
+      sample(out, "wash_http_request_duration_seconds_bucket", (r.labels + ",le=\"" + BUCKET_LE[b] + "\"").c_str(), cumulative);
+    }
+    sample(out, "wash_http_request_duration_seconds_bucket", (r.labels + ",le=\"+Inf\"").c_str(), (uint64_t)r.count);
+    sample(out, "wash_http_request_duration_seconds_sum", r.labels.c_str(), r.sumUs / 1e6);
+    sample(out, "wash_http_request_duration_seconds_count", r.labels.c_str(), (uint64_t)r.count);
+    return true;
+  };
+}
+
+/**
+ * @brief Appends the # HELP and # TYPE lines of a metric family.
+ */
+void Metrics::family(String &out, const char *name, const char *type, const char *help) {
+  out += "# HELP ";
+  out += name;
+  out += " ";
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += " ";
+  out += type;
+  out += "\n";
+}
+
+/**
+ * @brief Appends the name and labels of a sample.
+ */
+static void sampleName(String &out, const char *name, const char *labels) {
+  out += name;
+  if (labels && *labels) {
+    out += "{";
+    out += labels;
+    out += "}";
+  }
+}
+
+/**
+ * @brief Appends a sample line with a floating point value.
+ */
+void Metrics::sample(String &out, const char *name, const char *labels, double value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), " %.6g\n", value);
+  sampleName(out, name, labels);
+  out += buf;
+}
+
+/**
+ * @brief Appends a sample line with an integer value.
+ */
+void Metrics::sample(String &out, const char *name, const char *labels, uint64_t value) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)value);
+  sampleName(out, name, labels);
+  out += buf;
+}
+
+/**
+ * @brief Formats a label pair, escaping backslashes, quotes and line breaks.
+ */
+String Metrics::label(const char *key, const char *value) {
+  String out = key;
+  out += "=\"";
+  for (const char *p = value ? value : ""; *p; p++) {
+    if (*p == '\\' || *p == '"') {
+      out += '\\';
+      out += *p;
+    } else if (*p == '\n') {
+      out += "\\n";
+    } else {
+      out += *p;
+    }
+  }
+  out += "\"";
+  return out;
+}
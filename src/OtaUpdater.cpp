@@ -0,0 +1,305 @@
+/**
+ * @file OtaUpdater.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the OtaUpdater class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "OtaUpdater.h"
+#include <Update.h>
+#include <Preferences.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <esp_system.h>
+#include "EventHub.h"
+#include "Logger.h"
+
+/**
+ * @brief Keeps the Arduino core from accepting a new image before its self-test.
+ * Only consulted on builds with bootloader rollback enabled.
+ */
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+/**
+ * @brief Checks whether this boot is the first of a new image.
+ */
+void OtaUpdater::checkBoot() {
+  Preferences prefs;
+  prefs.begin("ota", false);
+  String failed = prefs.getString("failed", "");
+  if (failed.length() > 0) {
+    // The previous boot restored this image; report it once
+    _boot = OTA_BOOT_ROLLED_BACK;
+    _error = failed;
+    prefs.remove("failed");
+    Logger::warn("ota", nullptr, "Update rolled back: %s", failed.c_str());
+  }
+  String pending = prefs.getString("pending", "");
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t imgState;
+  // An image flashed some other way still needs confirming on rollback-enabled builds
+  bool verifying = esp_ota_get_state_partition(running, &imgState) == ESP_OK && imgState == ESP_OTA_IMG_PENDING_VERIFY;
+  if (pending.length() == 0 && !verifying) {
+    prefs.end();
+    return;
+  }
+  if (pending.length() > 0 && (!running || pending != running->label)) {
+    // The bootloader went back to the previous image by itself
+    prefs.remove("pending");
+    prefs.end();
+    _boot = OTA_BOOT_ROLLED_BACK;
+    _error = "new image did not boot";
+    Logger::warn("ota", nullptr, "Update rolled back: %s", _error.c_str());
+    return;
+  }
+  uint8_t tries = prefs.getUChar("tries", 0) + 1;
+  prefs.putUChar("tries", tries);
+  prefs.end();
+  if (tries > OTA_BOOT_ATTEMPTS) {
+    _rollback("new image restarted before passing its self-test");
+    return;
+  }
+  _boot = OTA_BOOT_TESTING;
+  _bootMs = millis();
+  Logger::info("ota", nullptr, "New image on %s, boot %u of %u", running->label, tries, OTA_BOOT_ATTEMPTS);
+}
+
+/**
+ * @brief Runs the self-test of a new image.
+ */
+void OtaUpdater::poll() {
+  if (_boot != OTA_BOOT_TESTING || millis() - _bootMs < OTA_CONFIRM_MS) return;
+  const char *fault = _selfTest();
+  if (fault) _rollback(fault);
+  else _confirm();
+}
+
+/**
+ * @brief Checks that the new image works.
+ */
+const char* OtaUpdater::_selfTest() {
+  // Having run for OTA_CONFIRM_MS without a crash is the main part of the test
+  if (LittleFS.totalBytes() == 0) return "filesystem not mounted";
+  if (ESP.getFreeHeap() < OTA_MIN_HEAP) return "free heap too low";
+  if (!(WiFi.getMode() & WIFI_AP) && WiFi.status() != WL_CONNECTED) return "network down";
+  return nullptr;
+}
+
+/**
+ * @brief Keeps the running image.
+ */
+void OtaUpdater::_confirm() {
+  Preferences prefs;
+  prefs.begin("ota", false);
+  prefs.remove("pending");
+  prefs.remove("tries");
+  prefs.remove("prev");
+  prefs.end();
+  esp_ota_img_states_t imgState;
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (esp_ota_get_state_partition(running, &imgState) == ESP_OK && imgState == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_valid_cancel_rollback();
+  }
+  _boot = OTA_BOOT_CONFIRMED;
+  Logger::info("ota", nullptr, "New image passed its self-test");
+}
+
+/**
+ * @brief Restores the previous image and restarts.
+ */
+void OtaUpdater::_rollback(const char *reason) {
+  Logger::error("ota", nullptr, "Rolling back: %s", reason);
+  Preferences prefs;
+  prefs.begin("ota", false);
+  String prev = prefs.getString("prev", "");
+  prefs.remove("pending");
+  prefs.remove("tries");
+  prefs.remove("prev");
+  prefs.putString("failed", reason);
+  prefs.end();
+
+  esp_ota_img_states_t imgState;
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (esp_ota_get_state_partition(running, &imgState) == ESP_OK && imgState == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_invalid_rollback_and_reboot(); // does not return on success
+  }
+  const esp_partition_t *target = prev.length() > 0 ?
+    esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev.c_str()) : nullptr;
+  if (!target || esp_ota_set_boot_partition(target) != ESP_OK) {
+    Logger::error("ota", nullptr, "Previous image not available, keeping this one");
+    _boot = OTA_BOOT_NORMAL;
+    return;
+  }
+  esp_restart();
+}
+
+/**
+ * @brief Starts an update.
+ */
+bool OtaUpdater::start(size_t size, const String &sha256) {
+  if (_state == OTA_RECEIVING) _fail("superseded by a new upload");
+  _state = OTA_RECEIVING;
+  _bytes = 0;
+  _total = size;
+  _startMs = _eventMs = millis();
+  _endMs = 0;
+  _digest[0] = '\0';
+  _error = "";
+  if (sha256.length() > 0 && sha256.length() != 64) {
+    _fail("malformed sha256");
+    return false;
+  }
+  if (OTA_REQUIRE_SHA256 && sha256.length() == 0) {
+    _fail("sha256 required");
+    return false;
+  }
+  strlcpy(_expected, sha256.c_str(), sizeof(_expected));
+  for (char *c = _expected; *c; c++) *c = tolower(*c);
+  if (!Update.begin(size ? size : UPDATE_SIZE_UNKNOWN)) {
+    _fail(String("not enough space: ") + Update.errorString());
+    return false;
+  }
+  mbedtls_sha256_init(&_sha);
+  mbedtls_sha256_starts(&_sha, 0);
+  _hashing = true;
+  Logger::info("ota", nullptr, "Update started, %u bytes%s", (unsigned)size, _expected[0] ? ", sha256 given" : "");
+  _publish();
+  return true;
+}
+
+/**
+ * @brief Hashes a chunk and writes it to the update partition.
+ */
+bool OtaUpdater::write(const uint8_t *data, size_t len) {
+  if (_state != OTA_RECEIVING) return false;
+  if (len == 0) return true;
+  if (_total && _bytes + len > _total) {
+    _fail("image larger than announced");
+    return false;
+  }
+  mbedtls_sha256_update(&_sha, data, len);
+  // A short write means flash trouble; going on would only produce a broken image
+  if (Update.write(const_cast<uint8_t*>(data), len) != len) {
+    _fail(String("write failed: ") + Update.errorString());
+    return false;
+  }
+  _bytes += len;
+  if (millis() - _eventMs >= OTA_EVENT_MS) {
+    _eventMs = millis();
+    _publish();
+  }
+  return true;
+}
+
+/**
+ * @brief Verifies the digest and makes the image the boot partition.
+ */
+bool OtaUpdater::finish() {
+  if (_state != OTA_RECEIVING) return false;
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&_sha, digest);
+  mbedtls_sha256_free(&_sha);
+  _hashing = false;
+  for (int i = 0; i < 32; i++) snprintf(_digest + i * 2, 3, "%02x", digest[i]);
+  if (_total && _bytes != _total) {
+    _fail("incomplete upload");
+    return false;
+  }
+  if (_expected[0] && strcmp(_expected, _digest) != 0) {
+    _fail("sha256 mismatch");
+    return false;
+  }
+  // Record the update before the boot partition changes, so that the next
+  // boot runs the self-test even if power is lost right after Update.end()
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  const esp_partition_t *target = esp_ota_get_next_update_partition(nullptr);
+  Preferences prefs;
+  prefs.begin("ota", false);
+  prefs.putString("prev", running ? running->label : "");
+  prefs.putString("pending", target ? target->label : "");
+  prefs.putUChar("tries", 0);
+  prefs.end();
+  // Update.end() also checks the image header and the checksum esptool appends
+  if (!Update.end(true)) {
+    prefs.begin("ota", false);
+    prefs.remove("pending");
+    prefs.remove("prev");
+    prefs.end();
+    _fail(String("image rejected: ") + Update.errorString());
+    return false;
+  }
+  _state = OTA_READY;
+  _endMs = millis();
+  Logger::info("ota", nullptr, "Update verified, %u bytes, sha256 %s", (unsigned)_bytes, _digest);
+  _publish();
+  return true;
+}
+
+/**
+ * @brief Aborts the current update.
+ */
+void OtaUpdater::abort(const char *reason) {
+  if (_state == OTA_RECEIVING) _fail(reason);
+}
+
+/**
+ * @brief Aborts the update and records the reason.
+ */
+void OtaUpdater::_fail(const String &reason) {
+  if (Update.isRunning()) Update.abort();
+  if (_hashing) {
+    mbedtls_sha256_free(&_sha);
+    _hashing = false;
+  }
+  _state = OTA_FAILED;
+  _endMs = millis();
+  _error = reason;
+  Logger::error("ota", nullptr, "Update failed after %u bytes: %s", (unsigned)_bytes, reason.c_str());
+  _publish();
+}
+
+/**
+ * @brief Gets the name of an upload state.
+ */
+const char* OtaUpdater::_stateName(OtaState state) {
+  switch (state) {
+    case OTA_RECEIVING: return "receiving";
+    case OTA_READY:     return "ready";
+    case OTA_FAILED:    return "failed";
+    default:            return "idle";
+  }
+}
+
+/**
+ * @brief Fills a JSON object with the upload progress and boot state.
+ */
+void OtaUpdater::getStatusJSON(JsonObject out) {
+  uint32_t elapsed = _state == OTA_IDLE ? 0 : (_endMs ? _endMs : millis()) - _startMs;
+  out["state"] = _stateName(_state);
+  out["bytes"] = _bytes;
+  out["total"] = _total;
+  out["bytesPerSec"] = elapsed ? (uint32_t)((uint64_t)_bytes * 1000 / elapsed) : 0;
+  out["elapsedMs"] = elapsed;
+  out["sha256"] = _digest;
+  out["error"] = _error;
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  out["partition"] = running ? running->label : "";
+  static const char *const boots[] = { "normal", "testing", "confirmed", "rolledBack" };
+  out["boot"] = boots[_boot];
+}
+
+/**
+ * @brief Publishes the progress as an "ota" event.
+ */
+void OtaUpdater::_publish() {
+  if (!_events) return;
+  uint32_t elapsed = (_endMs ? _endMs : millis()) - _startMs;
+  char data[EVENT_DATA_SIZE];
+  snprintf(data, sizeof(data), "{\"state\":\"%s\",\"bytes\":%u,\"total\":%u,\"bytesPerSec\":%u}",
+           _stateName(_state), (unsigned)_bytes, (unsigned)_total,
+           elapsed ? (unsigned)((uint64_t)_bytes * 1000 / elapsed) : 0u);
+  _events->publish("ota", data);
+}
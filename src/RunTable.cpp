@@ -0,0 +1,123 @@
+/**
+ * @file RunTable.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the RunTable class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "RunTable.h"
+
+/**
+ * @brief Computes the run table key of a numeric task ID.
+ */
+uint32_t RunTable::key(const char *id) {
+  // Leading zeros would give "007" the key of "7"
+  if (*id < '1' || *id > '9') return 0;
+  uint64_t value = 0;
+  for (const char *p = id; *p; p++) {
+    if (*p < '0' || *p > '9') return 0;
+    value = value * 10 + (uint32_t)(*p - '0');
+    if (value >= KEY_ASSIGNED) return 0;
+  }
+  return (uint32_t)value;
+}
+
+/**
+ * @brief Finds the slot of a task.
+ */
+int RunTable::find(uint32_t task) const {
+  for (int i = 0; i < RUN_TABLE_SIZE; i++) {
+    if (_slots[i].task.load(std::memory_order_acquire) == task) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Adds a queued run of a task.
+ */
+int RunTable::claim(uint32_t task, uint32_t run, uint32_t parent) {
+  int slot = find(0);
+  if (slot < 0) return -1;
+  Slot &s = _slots[slot];
+  s.word.store(_word(run, TASK_QUEUED), std::memory_order_relaxed);
+  s.parent.store(parent, std::memory_order_relaxed);
+  s.waitingOn.store(0, std::memory_order_relaxed);
+  // Publishing the key makes the slot visible to readers
+  s.task.store(task, std::memory_order_release);
+  return slot;
+}
+
+/**
+ * @brief Changes the state of a run if it is still current in its slot.
+ */
+bool RunTable::setState(int slot, uint32_t run, uint8_t state) {
+  if (slot < 0 || slot >= RUN_TABLE_SIZE) return false;
+  uint32_t cur = _slots[slot].word.load(std::memory_order_acquire);
+  if ((cur >> 2) != run) return false;
+  return _slots[slot].word.compare_exchange_strong(cur, _word(run, state), std::memory_order_acq_rel);
+}
+
+/**
+ * @brief Removes the run of a task from the table.
+ */
+bool RunTable::release(uint32_t task, uint32_t run) {
+  if (!task) return false; // 0 marks free slots
+  int slot = find(task);
+  if (slot < 0) return false;
+  Slot &s = _slots[slot];
+  if (run && (s.word.load(std::memory_order_acquire) >> 2) != run) return false;
+  s.word.store(0, std::memory_order_release);
+  s.task.store(0, std::memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Records which run a run is joining.
+ */
+void RunTable::setWaiting(uint32_t run, uint32_t waitingOn) {
+  int slot = findRun(run);
+  if (slot >= 0) _slots[slot].waitingOn.store(waitingOn, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Gets the state of a task.
+ */
+uint8_t RunTable::state(uint32_t task) const {
+  int slot = task ? find(task) : -1;
+  if (slot < 0) return TASK_STOPPED;
+  uint32_t word = _slots[slot].word.load(std::memory_order_acquire);
+  // The slot may have been released between the two loads
+  if (_slots[slot].task.load(std::memory_order_acquire) != task || word == 0) return TASK_STOPPED;
+  return word & 3;
+}
+
+/**
+ * @brief Checks whether a run still occupies the given slot.
+ */
+bool RunTable::isCurrent(int slot, uint32_t run) const {
+  if (slot < 0 || slot >= RUN_TABLE_SIZE) return false;
+  return (_slots[slot].word.load(std::memory_order_acquire) >> 2) == run;
+}
+
+/**
+ * @brief Finds the slot of an active run.
+ */
+int RunTable::findRun(uint32_t run) const {
+  if (!run) return -1;
+  for (int i = 0; i < RUN_TABLE_SIZE; i++) {
+    if ((_slots[i].word.load(std::memory_order_acquire) >> 2) == run) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Counts the runs in a given state.
+ */
+size_t RunTable::count(uint8_t state) const {
+  size_t n = 0;
+  for (int i = 0; i < RUN_TABLE_SIZE; i++) {
+    uint32_t word = _slots[i].word.load(std::memory_order_relaxed);
+    if (word != 0 && (word & 3) == state) n++;
+  }
+  return n;
+}
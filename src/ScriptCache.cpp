@@ -0,0 +1,193 @@
+/**
+ * @file ScriptCache.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the ScriptCache class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "ScriptCache.h"
+#include <LittleFS.h>
+#include <lua/lua.hpp>
+#include "AtomicFile.h"
+#include "Logger.h"
+
+static const uint32_t CACHE_MAGIC = 0x43425057; // "WPBC"
+
+/**
+ * @struct CacheHeader
+ * @brief Header in front of the dumped chunk in a .luac file.
+ */
+struct __attribute__((packed)) CacheHeader {
+  uint32_t magic;
+  uint32_t sourceHash;
+};
+
+/**
+ * @struct FileReader
+ * @brief lua_load() reader state that streams a file through a small buffer,
+ * optionally hashing what it reads.
+ */
+struct FileReader {
+  File *file;
+  size_t left;   ///< Bytes still to hand to Lua; stops short of a checksum footer.
+  uint32_t hash;
+  bool hashing;
+  char buf[256];
+};
+
+static String sourcePath(const String &id) { return String("/scripts/") + id + ".lua"; }
+static String cachePath(const String &id) { return String("/scripts/") + id + ".luac"; }
+
+/**
+ * @brief lua_load() reader callback for FileReader.
+ */
+static const char *readFile(lua_State *L, void *ud, size_t *size) {
+  FileReader *r = (FileReader*)ud;
+  *size = r->left ? r->file->read((uint8_t*)r->buf, r->left < sizeof(r->buf) ? r->left : sizeof(r->buf)) : 0;
+  r->left -= *size;
+  if (r->hashing && *size) r->hash = ScriptCache::hash(r->buf, *size, r->hash);
+  return *size ? r->buf : nullptr;
+}
+
+/**
+ * @brief lua_dump() writer callback that streams bytecode into an AtomicFile.
+ */
+static int writeFile(lua_State *L, const void *p, size_t sz, void *ud) {
+  AtomicFile *f = (AtomicFile*)ud;
+  return f->write((const uint8_t*)p, sz) == sz ? 0 : 1;
+}
+
+/**
+ * @brief Dumps the function on top of L into the cache file of a task.
+ */
+static bool writeCache(lua_State *L, const String &id, uint32_t sourceHash) {
+  AtomicFile f(cachePath(id));
+  CacheHeader hdr = { CACHE_MAGIC, sourceHash };
+  f.write((const uint8_t*)&hdr, sizeof(hdr));
+  // Debug info is kept so errors of cached runs still name the line
+  if (!f.ok() || lua_dump(L, writeFile, &f, 0) != 0) return false;
+  return f.commit();
+}
+
+/**
+ * @brief Hashes the first @p length bytes of a file and rewinds it.
+ */
+static uint32_t hashFile(File &file, size_t length) {
+  char buf[256];
+  uint32_t h = 2166136261u;
+  while (length > 0) {
+    size_t n = file.read((uint8_t*)buf, length < sizeof(buf) ? length : sizeof(buf));
+    if (n == 0) break;
+    h = ScriptCache::hash(buf, n, h);
+    length -= n;
+  }
+  file.seek(0);
+  return h ? h : 1;
+}
+
+/**
+ * @brief Computes the FNV-1a hash of a buffer.
+ */
+uint32_t ScriptCache::hash(const char *data, size_t len, uint32_t seed) {
+  uint32_t h = seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Compiles a script and writes its bytecode cache.
+ */
+bool ScriptCache::store(const String &id, const String &source, uint32_t &hashOut) {
+  hashOut = hash(source.c_str(), source.length());
+  if (hashOut == 0) hashOut = 1; // 0 means "unknown"
+  remove(id);
+  if (source.length() == 0) return false;
+  lua_State *L = luaL_newstate();
+  if (!L) return false;
+  String chunkName = "=" + id;
+  bool ok = false;
+  if (luaL_loadbufferx(L, source.c_str(), source.length(), chunkName.c_str(), "t") == LUA_OK) {
+    ok = writeCache(L, id, hashOut);
+    if (!ok) Logger::error("cache", id.c_str(), "failed to write bytecode");
+  } else {
+    Logger::error("cache", id.c_str(), "compile error: %s", lua_tostring(L, -1));
+  }
+  lua_close(L);
+  return ok;
+}
+
+/**
+ * @brief Loads a task script as a Lua function onto the stack of L.
+ */
+int ScriptCache::load(lua_State *L, const String &id, uint32_t &knownHash) {
+  String chunkName = "=" + id;
+  FileReader reader;
+  reader.hashing = false;
+
+  // Opened only when the hash is unknown or the cache misses
+  File src;
+  size_t length = 0;
+  if (knownHash == 0) {
+    // After a boot the registry has no hashes; hashing the source is still far cheaper than compiling it
+    src = LittleFS.open(sourcePath(id), FILE_READ);
+    if (!src || src.size() == 0) {
+      if (src) src.close();
+      return -1;
+    }
+    length = AtomicFile::contentLength(src);
+    knownHash = hashFile(src, length);
+  }
+
+  File f = LittleFS.open(cachePath(id), FILE_READ);
+  CacheHeader hdr;
+  if (f && f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+      hdr.magic == CACHE_MAGIC && hdr.sourceHash == knownHash) {
+    reader.file = &f;
+    reader.left = f.size() - sizeof(hdr);
+    int rc = lua_load(L, readFile, &reader, chunkName.c_str(), "b");
+    f.close();
+    if (rc == LUA_OK) {
+      if (src) src.close();
+      return LUA_OK;
+    }
+    // Incompatible or damaged bytecode, fall back to the source
+    Logger::warn("cache", id.c_str(), "stale bytecode: %s", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+  if (f) f.close();
+
+  if (!src) {
+    src = LittleFS.open(sourcePath(id), FILE_READ);
+    if (!src || src.size() == 0) {
+      if (src) src.close();
+      return -1;
+    }
+    length = AtomicFile::contentLength(src);
+  }
+  // Hashed like store() does, over the content without the checksum footer
+  reader.file = &src;
+  reader.left = length;
+  reader.hashing = true;
+  reader.hash = 2166136261u;
+  int rc = lua_load(L, readFile, &reader, chunkName.c_str(), "t");
+  src.close();
+  uint32_t sourceHash = reader.hash ? reader.hash : 1;
+  if (rc == LUA_OK) {
+    knownHash = sourceHash;
+    if (!writeCache(L, id, sourceHash)) {
+      Logger::error("cache", id.c_str(), "failed to refresh bytecode");
+    }
+  }
+  return rc;
+}
+
+/**
+ * @brief Removes the cached bytecode of a task.
+ */
+void ScriptCache::remove(const String &id) {
+  String path = cachePath(id);
+  if (LittleFS.exists(path)) LittleFS.remove(path);
+}
@@ -6,10 +6,15 @@
  * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
  */
 #include "SystemManager.h"
+#include "TaskManager.h"
 #include <Update.h>
 #include <LittleFS.h>
 #include <WiFi.h>
 #include <esp_system.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include "Logger.h"
 
 /**
  * @brief Initializes the SystemManager.
@@ -21,6 +26,13 @@ void SystemManager::begin() {
   _licenseKey = _prefs.getString("license_key", "");
 }
 
+/**
+ * @brief Connects the TaskManager used for task statistics.
+ */
+void SystemManager::setTaskManager(TaskManager *tasks) {
+  _tasks = tasks;
+}
+
 /**
  * @brief Gets system information as a JSON string.
  */
@@ -33,30 +45,91 @@ String SystemManager::getInfoJSON() {
   doc["licenseActive"] = _prefs.getBool("license", true);
   doc["freeHeap"] = ESP.getFreeHeap();
   doc["heapSize"] = ESP.getHeapSize();
-  // count scripts
-  int scriptCount = 0;
-  if (LittleFS.exists("/scripts")) {
-    File root = LittleFS.open("/scripts");
-    if (root && root.isDirectory()) {
-      File file = root.openNextFile();
-      while (file) {
-        if (!file.isDirectory()) {
-          scriptCount++;
-        }
-        file.close();
-        file = root.openNextFile();
-      }
-      root.close();
-    }
-  }
-  doc["userScripts"] = scriptCount;
-  // running tasks count will be filled by TaskManager, for now put 0
-  doc["runningTasks"] = 0;
+  // script and running task counts come from the TaskManager registry
+  doc["userScripts"] = _tasks ? _tasks->scriptCount() : 0;
+  doc["runningTasks"] = _tasks ? _tasks->runningCount() : 0;
   String out;
   serializeJson(doc, out);
   return out;
 }
 
+/**
+ * @brief Gets the version of the system information.
+ */
+uint32_t SystemManager::infoVersion() {
+  uint32_t heap = ESP.getFreeHeap();
+  uint32_t delta = heap > _infoHeap ? heap - _infoHeap : _infoHeap - heap;
+  if (delta >= SYSTEM_INFO_HEAP_STEP) {
+    _infoHeap = heap;
+    _version++;
+  }
+  return _version;
+}
+
+/// Firmware tasks whose stack high-water marks are reported; the Lua workers are added by number.
+static const char *const METRICS_TASKS[] = { "loopTask", "async_tcp", "logDrain", "taskPersist" };
+static const uint8_t METRICS_MAX_WORKERS = 8; ///< Highest number of Lua workers looked up.
+
+/**
+ * @brief Appends the stack high-water mark of a task if it is running.
+ */
+static void stackSample(String &out, const char *name) {
+  TaskHandle_t handle = xTaskGetHandle(name);
+  if (!handle) return;
+  Metrics::sample(out, "wash_task_stack_free_bytes", Metrics::label("task", name).c_str(),
+                  (uint64_t)uxTaskGetStackHighWaterMark(handle));
+}
+
+/**
+ * @brief Gets the system section of /api/metrics.
+ */
+MetricsStream::Section SystemManager::metricsSection() {
+  std::shared_ptr<bool> done = std::make_shared<bool>(false);
+  return [this, done](String &out) {
+    if (*done) return false;
+    *done = true;
+    Metrics::family(out, "wash_uptime_seconds", "counter", "Time since boot.");
+    Metrics::sample(out, "wash_uptime_seconds", nullptr, esp_timer_get_time() / 1e6);
+
+    Metrics::family(out, "wash_heap_size_bytes", "gauge", "Size of the internal heap.");
+    Metrics::sample(out, "wash_heap_size_bytes", nullptr, (uint64_t)ESP.getHeapSize());
+    Metrics::family(out, "wash_heap_free_bytes", "gauge", "Free internal heap.");
+    Metrics::sample(out, "wash_heap_free_bytes", nullptr, (uint64_t)ESP.getFreeHeap());
+    Metrics::family(out, "wash_heap_min_free_bytes", "gauge", "Lowest free internal heap since boot.");
+    Metrics::sample(out, "wash_heap_min_free_bytes", nullptr, (uint64_t)ESP.getMinFreeHeap());
+    Metrics::family(out, "wash_heap_largest_free_block_bytes", "gauge",
+                    "Largest block that can be allocated; far below the free heap means fragmentation.");
+    Metrics::sample(out, "wash_heap_largest_free_block_bytes", nullptr,
+                    (uint64_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    if (ESP.getPsramSize() > 0) {
+      Metrics::family(out, "wash_psram_size_bytes", "gauge", "Size of the PSRAM heap.");
+      Metrics::sample(out, "wash_psram_size_bytes", nullptr, (uint64_t)ESP.getPsramSize());
+      Metrics::family(out, "wash_psram_free_bytes", "gauge", "Free PSRAM heap.");
+      Metrics::sample(out, "wash_psram_free_bytes", nullptr, (uint64_t)ESP.getFreePsram());
+    }
+
+    // usedBytes() walks the filesystem, so frequent scrapes reuse the last figures
+    if (_fsStamp == 0 || millis() - _fsStamp >= SYSTEM_METRICS_FS_MS) {
+      _fsTotal = LittleFS.totalBytes();
+      _fsUsed = LittleFS.usedBytes();
+      _fsStamp = millis() | 1;
+    }
+    Metrics::family(out, "wash_fs_size_bytes", "gauge", "Capacity of the LittleFS partition.");
+    Metrics::sample(out, "wash_fs_size_bytes", nullptr, (uint64_t)_fsTotal);
+    Metrics::family(out, "wash_fs_used_bytes", "gauge", "Used space of the LittleFS partition.");
+    Metrics::sample(out, "wash_fs_used_bytes", nullptr, (uint64_t)_fsUsed);
+
+    Metrics::family(out, "wash_task_stack_free_bytes", "gauge",
+                    "Smallest free stack a firmware task has had since it started.");
+    for (const char *name : METRICS_TASKS) stackSample(out, name);
+    for (uint8_t i = 0; i < METRICS_MAX_WORKERS; i++) stackSample(out, (String("luaWorker") + i).c_str());
+
+    Metrics::family(out, "wash_log_dropped_total", "counter", "Log lines lost because the log queue was full.");
+    Metrics::sample(out, "wash_log_dropped_total", nullptr, (uint64_t)Logger::dropped());
+    return true;
+  };
+}
+
 /**
  * @brief Gets system settings as a JSON string.
  */
@@ -78,6 +151,7 @@ String SystemManager::getSystemJSON() {
 void SystemManager::setLanguage(const String &lang) {
   _language = lang;
   _prefs.putString("lang", _language);
+  _version++;
 }
 
 /**
@@ -86,6 +160,7 @@ void SystemManager::setLanguage(const String &lang) {
 void SystemManager::setTheme(const String &theme) {
   _theme = theme;
   _prefs.putString("theme", _theme);
+  _version++;
 }
 
 /**
@@ -101,6 +176,7 @@ String SystemManager::getTheme() {
 void SystemManager::setLicenseKey(const String &key) {
   _licenseKey = key;
   _prefs.putString("license_key", _licenseKey);
+  _version++;
 }
 
 /**
@@ -115,6 +191,16 @@ String SystemManager::getLicenseKey() {
  */
 void SystemManager::setAutoUpdate(bool enabled) {
   _prefs.putBool("auto_update", enabled);
+  _version++;
+}
+
+/**
+ * @brief Gets a parameter from the query string or the form fields.
+ */
+static String uploadParam(AsyncWebServerRequest *request, const char *name) {
+  if (request->hasParam(name, true)) return request->getParam(name, true)->value();
+  if (request->hasParam(name)) return request->getParam(name)->value();
+  return String();
 }
 
 /**
@@ -122,57 +208,137 @@ void SystemManager::setAutoUpdate(bool enabled) {
  */
 void SystemManager::handleOTAUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
   if (index == 0) {
-    Serial.printf("OTA Upload Start: %s\n", filename.c_str());
-    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
-      Serial.println("Not enough space for OTA");
+    if (_ota.state() == OTA_RECEIVING && _otaRequest != request) {
+      Logger::warn("ota", nullptr, "Upload refused, another one is running");
       return;
     }
+    Logger::info("ota", nullptr, "OTA Upload Start: %s", filename.c_str());
+    _otaRequest = request;
+    // Weak links drop mid-upload; never leave the update half open
+    request->onDisconnect([this, request]() {
+      if (_otaRequest != request) return;
+      _ota.abort("connection lost");
+      _otaRequest = nullptr;
+    });
+    if (!_ota.start(uploadParam(request, "size").toInt(), uploadParam(request, "sha256"))) return;
   }
-  if (len) {
-    Update.write(data, len);
-  }
-  if (final) {
-    if (Update.end(true)) {
-      Serial.println("OTA done, will restart");
-      // schedule immediate reboot
-      ESP.restart();
-    } else {
-      Serial.printf("OTA Error: %s\n", Update.errorString());
-    }
-  }
+  if (_otaRequest != request || _ota.state() != OTA_RECEIVING) return;
+  if (len && !_ota.write(data, len)) return;
+  if (final) _ota.finish();
 }
 
 /**
  * @brief Handles file uploads to the LittleFS filesystem.
  */
 void SystemManager::handleFSUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
-  String path = "/";
-  if (request->hasParam("path")) {
-    path = request->getParam("path")->value();
-  }
-  if (!path.endsWith("/")) {
-    path += "/";
+  auto it = _fsUploads.find(request);
+  FSUpload *up = it != _fsUploads.end() ? it->second.get() : nullptr;
+  if (index == 0) {
+    String path = "/";
+    if (request->hasParam("path")) {
+      path = request->getParam("path")->value();
+    }
+    if (!path.endsWith("/")) {
+      path += "/";
+    }
+    if (!up) {
+      up = new FSUpload();
+      _fsUploads[request].reset(up);
+      // Runs when the request is done or the client is gone
+      request->onDisconnect([this, request]() { _endFSUpload(request); });
+    }
+    up->path = path + filename;
+    up->used = 0;
+    up->bytes = 0;
+    up->startMs = millis();
+    up->failed = false;
+    Logger::info("system", nullptr, "FS Upload Start: %s to %s", filename.c_str(), path.c_str());
+    up->file.reset(); // discards a file of this request that never got its final chunk
+    up->file.reset(new AtomicFile(up->path));
+    if (!up->file->ok()) {
+      Logger::error("system", nullptr, "Failed to open file for writing");
+      up->failed = true;
+    }
   }
+  if (!up || up->failed || !up->file) return;
 
-  if (index == 0) {
-    Serial.printf("FS Upload Start: %s to %s\n", filename.c_str(), path.c_str());
+  // Coalesce the small TCP chunks into whole flash blocks
+  while (len > 0) {
+    size_t n = std::min(len, (size_t)FS_UPLOAD_BUFFER - up->used);
+    memcpy(up->buf + up->used, data, n);
+    up->used += n;
+    data += n;
+    len -= n;
+    if (up->used == FS_UPLOAD_BUFFER && !_flushFSUpload(*up)) break;
   }
-  String fullPath = path + filename;
-  File f;
-  if (index == 0) {
-    f = LittleFS.open(fullPath, FILE_WRITE);
-  } else {
-    f = LittleFS.open(fullPath, FILE_APPEND);
+
+  if (final || up->failed) {
+    if (!up->failed) _flushFSUpload(*up);
+    // The target is replaced in one step, so it is never seen half written
+    if (!up->failed) up->failed = !up->file->commit();
+    up->file.reset();
+    if (up->failed) {
+      Logger::error("system", nullptr, "FS Upload Failed: %s", up->path.c_str());
+    } else {
+      Logger::info("system", nullptr, "FS Upload End: %s, size=%u, %lu ms", up->path.c_str(),
+                   (unsigned)up->bytes, (unsigned long)(millis() - up->startMs));
+    }
   }
-  if (!f) {
-    Serial.println("Failed to open file for writing");
-    return;
+}
+
+/**
+ * @brief Writes the staged data of an upload to its temp file.
+ */
+bool SystemManager::_flushFSUpload(FSUpload &up) {
+  if (up.used == 0) return true;
+  if (up.file->write(up.buf, up.used) != up.used) {
+    Logger::error("system", nullptr, "Write failed: %s (filesystem full?)", up.path.c_str());
+    up.failed = true;
+    return false;
   }
-  if (len) f.write(data, len);
-  f.close();
-  if (final) {
-    Serial.printf("FS Upload End: %s, size=%u\n", filename.c_str(), index + len);
+  up.bytes += up.used;
+  up.used = 0;
+  return true;
+}
+
+/**
+ * @brief Drops the upload context of a request, removing an unfinished temp file.
+ */
+void SystemManager::_endFSUpload(AsyncWebServerRequest *request) {
+  auto it = _fsUploads.find(request);
+  if (it == _fsUploads.end()) return;
+  FSUpload &up = *it->second;
+  if (up.file) {
+    up.file.reset(); // removes the temp file
+    Logger::warn("system", nullptr, "FS Upload Aborted: %s", up.path.c_str());
   }
+  _fsUploads.erase(it);
+}
+
+/**
+ * @brief Checks whether the file upload of a request failed.
+ */
+bool SystemManager::fsUploadFailed(AsyncWebServerRequest *request) const {
+  auto it = _fsUploads.find(request);
+  return it != _fsUploads.end() && it->second->failed;
+}
+
+/**
+ * @brief Starts the access point and joins the saved network in the background.
+ */
+void SystemManager::beginWiFi(const String &apName) {
+  _wifi.begin(apName);
+  String ssid = _prefs.getString("wifi_ssid", "");
+  if (ssid.length() > 0) _wifi.connect(ssid, _prefs.getString("wifi_pass", ""));
+}
+
+/**
+ * @brief Saves Wi-Fi credentials and joins that network in the background.
+ */
+bool SystemManager::connectWiFi(const String &ssid, const String &password) {
+  bool ok = saveWiFiCredentials(ssid, password);
+  _wifi.connect(ssid, password);
+  return ok;
 }
 
 /**
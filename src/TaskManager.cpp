@@ -9,7 +9,13 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <LittleFS.h>
+#include <esp_system.h>
+#include <algorithm>
 #include <lua/lua.hpp>
+#include "ScriptCache.h"
+#include "AtomicFile.h"
+#include "Logger.h"
+#include "MemoryGuard.h"
 
 // Pointer to the global task manager instance, set in begin()
 static TaskManager* s_taskManager = nullptr;
@@ -21,7 +27,8 @@ static TaskManager* s_taskManager = nullptr;
  */
 static int l_log(lua_State *L) {
     const char *msg = luaL_checkstring(L, 1);
-    if (msg) Serial.printf("[LUA] %s\n", msg);
+    if (s_taskManager) s_taskManager->scriptLog(L, msg);
+    else Logger::info("lua", nullptr, "%s", msg);
     return 0;
 }
 
@@ -39,34 +46,137 @@ static int l_setLED(lua_State *L) {
     return 0;
 }
 
+/**
+ * @brief Gets the number of the task run executing on a Lua thread.
+ * Workers register the thread of every run in the registry.
+ * @return The run number, or 0 if L is not the thread of a task run.
+ */
+static uint32_t currentRun(lua_State *L) {
+    lua_rawgetp(L, LUA_REGISTRYINDEX, L);
+    uint32_t run = (uint32_t)lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return run;
+}
+
 /**
  * @brief Lua-callable function to delay execution.
+ * Inside a task run the coroutine yields to its worker, which resumes it once the
+ * time has passed and runs other scripts meanwhile. Where yielding is not possible
+ * (e.g. inside a callback of a C function) the call blocks the worker; in the
+ * onStop handler only for what is left of its budget, then it raises an error.
  * @param L The Lua state. Expects one integer argument (milliseconds).
  * @return 0.
  */
 static int l_delay(lua_State *L) {
-    int ms = luaL_checkinteger(L, 1);
+    lua_Integer ms = luaL_checkinteger(L, 1);
+    if (ms < 0) ms = 0;
+    if (currentRun(L) && lua_isyieldable(L)) {
+        lua_pushinteger(L, ms);
+        return lua_yield(L, 1);
+    }
+    // The debug hook only fires between instructions, never during the sleep
+    int32_t left = s_taskManager ? s_taskManager->onStopTimeLeft(L) : -1;
+    if (left >= 0 && ms >= left) {
+        if (left > 0) delay(left);
+        return luaL_error(L, "onStop exceeded %d ms", TASK_ONSTOP_BUDGET_MS);
+    }
     if (ms > 0) delay(ms);
     return 0;
 }
 
 /**
  * @brief Lua-callable function to start another task.
+ * The task is queued and the call returns immediately; the caller does not wait
+ * for the other script. Starting a task that already started the caller (directly
+ * or through other tasks) is refused as a cycle.
  * @param L The Lua state. Expects one string argument (task ID).
- * @return 0.
+ * @return 1 (the run handle) on success, 2 (nil and the reason) otherwise.
  */
 static int l_startTask(lua_State *L) {
     const char *id = luaL_checkstring(L, 1);
-    if (id && s_taskManager) {
-        String baseId = id;
-        if (baseId.endsWith(".json")) {
-            baseId.remove(baseId.length() - 5);
+    if (!s_taskManager) return 0;
+    uint32_t run = 0;
+    switch (s_taskManager->startRun(id, currentRun(L), &run)) {
+        case TaskManager::RUN_OK:
+            lua_pushinteger(L, run);
+            return 1;
+        case TaskManager::RUN_NOT_FOUND:      lua_pushnil(L); lua_pushstring(L, "not found"); break;
+        case TaskManager::RUN_ALREADY_ACTIVE: lua_pushnil(L); lua_pushstring(L, "already running"); break;
+        case TaskManager::RUN_CYCLE:          lua_pushnil(L); lua_pushstring(L, "cycle"); break;
+        case TaskManager::RUN_LOW_MEMORY:     lua_pushnil(L); lua_pushstring(L, "low memory"); break;
+        default:                              lua_pushnil(L); lua_pushstring(L, "queue full"); break;
+    }
+    return 2;
+}
+
+/**
+ * @brief Continuation of join(): checks the awaited run and yields until it is over.
+ * @param ctx The deadline in millis(), 0 to wait without a timeout.
+ */
+static int joinCheck(lua_State *L, int status, lua_KContext ctx) {
+    uint32_t handle = (uint32_t)luaL_checkinteger(L, 1);
+    uint32_t deadline = (uint32_t)ctx;
+    bool done = !s_taskManager->isRunActive(handle);
+    if (done || (deadline && (int32_t)(millis() - deadline) >= 0)) {
+        s_taskManager->setWaiting(currentRun(L), 0);
+        lua_pushboolean(L, done);
+        return 1;
+    }
+    lua_pushinteger(L, TASK_JOIN_POLL_MS);
+    return lua_yieldk(L, 1, ctx, joinCheck);
+}
+
+/**
+ * @brief Lua-callable function to wait for a run started with startTask().
+ * The caller yields to its worker while waiting. A join that would wait for
+ * itself (a run that is joining the caller) raises an error. The onStop handler,
+ * which cannot yield, polls in place and raises an error once its budget is used up.
+ * @param L The Lua state. Expects the run handle and an optional timeout in milliseconds.
+ * @return 1 (true if the run is over, false on timeout).
+ */
+static int l_join(lua_State *L) {
+    uint32_t handle = (uint32_t)luaL_checkinteger(L, 1);
+    lua_Integer timeout = luaL_optinteger(L, 2, -1);
+    uint32_t self = currentRun(L);
+    if (!s_taskManager) return 0;
+    if (!self || !lua_isyieldable(L)) {
+        int32_t left = s_taskManager->onStopTimeLeft(L);
+        if (left < 0) return luaL_error(L, "join: not called from a task run");
+        uint32_t start = millis();
+        while (s_taskManager->isRunActive(handle)) {
+            uint32_t waited = millis() - start;
+            if (timeout >= 0 && waited >= (uint64_t)timeout) {
+                lua_pushboolean(L, false);
+                return 1;
+            }
+            if (waited >= (uint32_t)left) return luaL_error(L, "onStop exceeded %d ms", TASK_ONSTOP_BUDGET_MS);
+            uint32_t step = (uint32_t)left - waited;
+            if (timeout >= 0 && (uint64_t)timeout - waited < step) step = (uint32_t)(timeout - waited);
+            delay(step < TASK_JOIN_POLL_MS ? step : TASK_JOIN_POLL_MS);
         }
-        // This is a recursive call. It will run the other task's script to completion
-        // before returning. This is simple but can lead to deep recursion if tasks call each other.
-        s_taskManager->runTask(baseId);
+        lua_pushboolean(L, true);
+        return 1;
     }
-    return 0;
+    if (!s_taskManager->setWaiting(self, handle)) {
+        return luaL_error(L, "join: run %d waits for this task (deadlock)", (int)handle);
+    }
+    uint32_t deadline = 0;
+    if (timeout >= 0) {
+        deadline = millis() + (uint32_t)timeout;
+        if (deadline == 0) deadline = 1; // 0 means "no timeout"
+    }
+    return joinCheck(L, LUA_OK, (lua_KContext)deadline);
+}
+
+/**
+ * @brief Lua-callable function to check whether a task is queued or running.
+ * @param L The Lua state. Expects one string argument (task ID).
+ * @return 1 (boolean).
+ */
+static int l_isRunning(lua_State *L) {
+    const char *id = luaL_checkstring(L, 1);
+    lua_pushboolean(L, s_taskManager && s_taskManager->isRunning(id));
+    return 1;
 }
 
 /**
@@ -76,50 +186,325 @@ static int l_startTask(lua_State *L) {
  */
 static int l_stopTask(lua_State *L) {
     const char *id = luaL_checkstring(L, 1);
-    if (id && s_taskManager) {
-        String baseId = id;
-        if (baseId.endsWith(".json")) {
-            baseId.remove(baseId.length() - 5);
-        }
-        // This simply updates the state in the JSON file.
-        s_taskManager->stopTask(baseId);
-    }
+    // Detaches the run; its debug hook cancels it and the state is flushed later
+    if (id && s_taskManager) s_taskManager->stopTask(id);
     return 0;
 }
 
+/**
+ * @brief Registers the builtin C functions in a new Lua state.
+ * @param L The Lua state.
+ */
+static void registerBuiltins(lua_State *L) {
+  lua_register(L, "log", l_log);
+  lua_register(L, "setLED", l_setLED);
+  lua_register(L, "delay", l_delay);
+  lua_register(L, "wait", l_delay);
+  lua_register(L, "startTask", l_startTask);
+  lua_register(L, "join", l_join);
+  lua_register(L, "isRunning", l_isRunning);
+  lua_register(L, "stopTask", l_stopTask);
+}
+
+/**
+ * @brief Scoped holder for the registry lock.
+ */
+class RegistryLock {
+public:
+  explicit RegistryLock(SemaphoreHandle_t mutex) : _mutex(mutex) {
+    if (_mutex) xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+  }
+  ~RegistryLock() {
+    if (_mutex) xSemaphoreGiveRecursive(_mutex);
+  }
+private:
+  SemaphoreHandle_t _mutex;
+};
+
+/**
+ * @class FlushLock
+ * @brief Scoped holder of the flush mutex.
+ *
+ * Taken by every path that writes task records, so a flush cannot write an
+ * older copy of a record after it. Always taken before the registry lock.
+ */
+class FlushLock {
+public:
+  explicit FlushLock(SemaphoreHandle_t mutex) : _mutex(mutex) {
+    if (_mutex) xSemaphoreTake(_mutex, portMAX_DELAY);
+  }
+  ~FlushLock() {
+    if (_mutex) xSemaphoreGive(_mutex);
+  }
+private:
+  SemaphoreHandle_t _mutex;
+};
+
+/**
+ * @brief Strips an optional ".json" suffix from a task ID.
+ */
+static String baseTaskId(const String &id) {
+  String baseId = id;
+  if (baseId.endsWith(".json")) {
+    baseId.remove(baseId.length() - 5);
+  }
+  return baseId;
+}
+
+/**
+ * @brief Shutdown handler that persists pending task state before a restart.
+ */
+static void flushTasksOnShutdown() {
+  if (s_taskManager) s_taskManager->flush();
+}
+
+/**
+ * @brief Configures the worker pool.
+ */
+void TaskManager::configureWorkers(uint8_t workers, uint8_t queueDepth, bool pinToCores) {
+  if (_runQueue) {
+    Logger::warn("tasks", nullptr, "workers already started, configuration ignored");
+    return;
+  }
+  if (workers < 1) workers = 1;
+  if (workers > TASK_MAX_WORKERS) workers = TASK_MAX_WORKERS;
+  _workerCount = workers;
+  _queueDepth = queueDepth > 0 ? queueDepth : 1;
+  _pinWorkers = pinToCores;
+}
+
 /**
  * @brief Initializes the TaskManager.
  */
 void TaskManager::begin() {
   s_taskManager = this;
+  if (!_lock) _lock = xSemaphoreCreateRecursiveMutex();
+  if (!_flushLock) _flushLock = xSemaphoreCreateMutex();
   // ensure directories
-  if (!LittleFS.exists("/tasks")) {
-    LittleFS.mkdir("/tasks");
-  }
   if (!LittleFS.exists("/scripts")) {
     LittleFS.mkdir("/scripts");
   }
+  _store.begin();
+  reload();
+  _repairScripts();
+  _luaPool.begin(TASK_LUA_POOL_SIZE, registerBuiltins, TASK_LUA_USE_PSRAM);
+
+  // Scripts run on a fixed set of long-lived workers fed by the run queue
+  if (!_runQueue) {
+    _runQueue = xQueueCreate(_queueDepth, sizeof(RunRequest));
+    for (uint8_t i = 0; i < _workerCount; i++) {
+      _workers[i] = {this, i, nullptr};
+      if (!_spawnWorker(i)) Logger::error("tasks", nullptr, "failed to start Lua worker %u", i);
+    }
+  }
+
+  // Runtime state changes are persisted by a low-priority background task
+  if (!_persistHandle) {
+    xTaskCreate(_persistTask, "taskPersist", 4096, this, 1, &_persistHandle);
+    esp_register_shutdown_handler(flushTasksOnShutdown);
+  }
+}
+
+/**
+ * @brief Sets the write-behind flush interval.
+ */
+void TaskManager::setFlushInterval(uint32_t ms) {
+  _flushIntervalMs = ms > 0 ? ms : 1;
+}
+
+/**
+ * @brief Background task that periodically flushes pending task state.
+ */
+void TaskManager::_persistTask(void* pvParameters) {
+  TaskManager* self = (TaskManager*)pvParameters;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(self->_flushIntervalMs));
+    self->flush();
+  }
+}
+
+/**
+ * @brief Writes all pending task state changes to the filesystem.
+ */
+void TaskManager::flush() {
+  if (!_flushLock) return;
+  FlushLock flushLock(_flushLock);
+  // Collect dirty records under the registry lock, write them without it so
+  // state changes never wait for flash. Every other writer of task records
+  // holds _flushLock as well, so none of them can put a newer copy of a
+  // record between the copy and the write (the last record in the log wins),
+  // and deleteTask() cannot remove a record that is about to be rewritten.
+  std::vector<TaskRecord> dirty;
+  {
+    RegistryLock lock(_lock);
+    for (TaskRecord &rec : _tasks) {
+      if (rec.state != rec.savedState) {
+        dirty.push_back(rec);
+        rec.savedState = rec.state;
+      }
+    }
+  }
+  if (!_store.putMany(dirty)) {
+    Logger::error("tasks", nullptr, "failed to persist state of %u tasks", (unsigned)dirty.size());
+    RegistryLock lock(_lock);
+    for (const TaskRecord &rec : dirty) {
+      TaskRecord *cur = _findTask(rec.id);
+      if (cur) cur->savedState = 0xFF; // retry on the next flush
+    }
+  }
+  if (_store.needsCompaction()) {
+    RegistryLock lock(_lock);
+    _store.compact(_tasks);
+  }
+}
+
+/**
+ * @brief Rebuilds the in-memory task registry from the task store.
+ */
+void TaskManager::reload() {
+  std::vector<TaskRecord> loaded;
+  if (!_store.load(loaded)) {
+    Logger::error("tasks", nullptr, "failed to load task store");
+  }
+
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  std::vector<TaskRecord> stale;
+  for (TaskRecord &rec : loaded) {
+    // Only tasks with an active run in the run table can be queued or running;
+    // anything else is a stale flag left behind by a reset and is cleared in the
+    // store as well.
+    TaskRecord *cur = _findTask(rec.id);
+    if (cur) {
+      rec.memPeak = cur->memPeak;
+      rec.stats = cur->stats;
+      rec.runKey = cur->runKey; // an active run stays findable
+    } else {
+      _assignRunKey(rec);
+    }
+    uint8_t active = _runs.state(rec.runKey);
+    if (active != TASK_STOPPED) {
+      rec.state = active;
+    } else if (rec.state != TASK_STOPPED) {
+      rec.state = TASK_STOPPED;
+      rec.savedState = TASK_STOPPED;
+      stale.push_back(rec);
+    }
+  }
+  _store.putMany(stale);
+  _tasks.swap(loaded);
+  _changed();
+  Logger::info("tasks", nullptr, "%u tasks loaded", (unsigned)_tasks.size());
+}
+
+/**
+ * @brief Completes interrupted script saves and retires damaged scripts.
+ */
+void TaskManager::_repairScripts() {
+  std::vector<String> pending;
+  File dir = LittleFS.open("/scripts");
+  if (dir && dir.isDirectory()) {
+    File file = dir.openNextFile();
+    while (file) {
+      String name = file.name();
+      name = name.substring(name.lastIndexOf('/') + 1);
+      if (name.endsWith(".tmp")) pending.push_back(String("/scripts/") + name.substring(0, name.length() - 4));
+      file.close();
+      file = dir.openNextFile();
+    }
+    dir.close();
+  }
+  for (const String &path : pending) AtomicFile::recover(path);
+
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  for (TaskRecord &rec : _tasks) {
+    if (!rec.hasScript) continue;
+    String path = String("/scripts/") + rec.id + ".lua";
+    AtomicStatus status = AtomicFile::verify(path);
+    if (status == ATOMIC_OK || status == ATOMIC_UNCHECKED) continue;
+    if (status == ATOMIC_CORRUPT) {
+      // Keep the damaged source for inspection, but never run it
+      LittleFS.remove(path + ".bad");
+      LittleFS.rename(path, path + ".bad");
+      Logger::error("tasks", rec.id, "script fails its checksum, moved to %s.bad", path.c_str());
+    } else {
+      Logger::warn("tasks", rec.id, "script file is missing");
+    }
+    ScriptCache::remove(rec.id);
+    rec.hasScript = false;
+    rec.scriptHash = 0;
+    if (_store.put(rec)) rec.savedState = rec.state;
+    _changed();
+  }
+}
+
+/**
+ * @brief Finds a task in the registry.
+ */
+TaskRecord* TaskManager::_findTask(const String &id) {
+  for (TaskRecord &rec : _tasks) {
+    if (strcmp(rec.id, id.c_str()) == 0) return &rec;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Gives a new registry record its run table key.
+ */
+void TaskManager::_assignRunKey(TaskRecord &rec) {
+  rec.runKey = RunTable::key(rec.id);
+  if (rec.runKey) return;
+  // Never the key of a numeric ID; unique until 2^31 keys have been handed out
+  _lastRunKey = (_lastRunKey + 1) & (RunTable::KEY_ASSIGNED - 1);
+  rec.runKey = RunTable::KEY_ASSIGNED | _lastRunKey;
+}
+
+/**
+ * @brief Gets the run table key of a task.
+ */
+uint32_t TaskManager::_runKey(const String &id) {
+  TaskRecord *rec = _findTask(id);
+  return rec ? rec->runKey : 0;
+}
+
+/**
+ * @brief Serializes a registry record into a JSON object.
+ */
+void TaskManager::_recordToJSON(const TaskRecord &rec, JsonObject obj) {
+  obj["id"] = rec.id;
+  obj["name"] = rec.name;
+  switch (_runs.state(rec.runKey)) {
+    case TASK_RUNNING: obj["state"] = "running"; break;
+    case TASK_QUEUED:  obj["state"] = "queued"; break;
+    default:           obj["state"] = "stopped"; break;
+  }
+  obj["hasScript"] = rec.hasScript;
+  obj["memLimit"] = rec.memLimit ? rec.memLimit : (uint32_t)TASK_LUA_MEM_LIMIT;
+  obj["memPeak"] = rec.memPeak;
 }
 
 /**
  * @brief Creates a new task with a given name.
  */
 String TaskManager::createTask(const String &name) {
-  String baseName = name;
-  if (baseName.endsWith(".json")) {
-    baseName.remove(baseName.length() - 5);
-  }
-  String id = String((uint32_t)millis());
-  DynamicJsonDocument doc(512);
-  doc["id"] = id;
-  doc["name"] = baseName;
-  doc["state"] = "stopped";
-  doc["hasScript"] = false;
-  String out; serializeJson(doc, out);
-  File f = LittleFS.open(String("/tasks/") + id + ".json", FILE_WRITE);
-  if (!f) return "";
-  f.print(out);
-  f.close();
+  String baseName = baseTaskId(name);
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  uint32_t stamp = (uint32_t)millis();
+  String id = String(stamp);
+  while (_findTask(id)) id = String(++stamp); // IDs are millis()-based; keep them unique
+  TaskRecord rec = {};
+  strlcpy(rec.id, id.c_str(), sizeof(rec.id));
+  strlcpy(rec.name, baseName.c_str(), sizeof(rec.name));
+  rec.state = TASK_STOPPED;
+  rec.savedState = TASK_STOPPED;
+  rec.hasScript = false;
+  _assignRunKey(rec);
+
+  if (!_store.put(rec)) return "";
+  _tasks.push_back(rec);
+  _changed();
   return id;
 }
 
@@ -127,194 +512,527 @@ String TaskManager::createTask(const String &name) {
  * @brief Saves a script for a task and/or updates its name.
  */
 bool TaskManager::saveScript(const String &id, const String &name, const String &content) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
-  }
+  String baseId = baseTaskId(id);
   bool ok = true;
+  // Text read back from the file still ends with its checksum line; it gets a fresh one below
+  String script = content;
+  AtomicFile::stripFooter(script);
 
   // Always write script file (including empty content, so "Save" clears or updates correctly)
   String path = String("/scripts/") + baseId + ".lua";
-  Serial.printf("TaskManager::saveScript path=%s len=%u\n", path.c_str(), content.length());
-  File f = LittleFS.open(path, "w");
-  if (!f) {
-    Serial.println("Failed to open script file for writing");
+  Logger::debug("tasks", baseId.c_str(), "saving script %s, %u bytes", path.c_str(), script.length());
+  // Replaced in one step with a checksum, so a reset mid-save keeps the old script
+  if (!AtomicFile::write(path, script, script.length() > 0)) {
+    Logger::error("tasks", baseId.c_str(), "failed to write %s", path.c_str());
     return false;
   }
-  size_t written = f.print(content);
-  f.close();
-  Serial.printf("Wrote %u bytes to %s\n", written, path.c_str());
-  if (written != content.length()) {
-    Serial.println("Warning: script file write size mismatch");
-    ok = false;
-  }
 
-  // update task's json file (name, hasScript flag)
-  String tpath = String("/tasks/") + baseId + ".json";
-  if (LittleFS.exists(tpath)) {
-    File tf = LittleFS.open(tpath, "r");
-    if (!tf) {
-      Serial.printf("Failed to open task file for read: %s\n", tpath.c_str());
+  // Precompile into the bytecode cache so runs can skip the compiler
+  uint32_t scriptHash = 0;
+  ScriptCache::store(baseId, script, scriptHash);
+
+  // update the registry (name, hasScript flag) and write it through
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  TaskRecord *rec = _findTask(baseId);
+  if (rec) {
+    if (name.length() > 0) {
+      strlcpy(rec->name, name.c_str(), sizeof(rec->name));
+    } // else, keep the old name
+    rec->hasScript = true;
+    rec->scriptHash = ok ? scriptHash : 0;
+    _changed();
+    if (!_store.put(*rec)) {
+      Logger::error("tasks", baseId.c_str(), "failed to update task record");
       ok = false;
     } else {
-      String s = tf.readString();
-      tf.close();
-      DynamicJsonDocument doc(4096); // Increased size to handle larger scripts if they were stored here
-      DeserializationError err = deserializeJson(doc, s);
-      if (err) {
-        Serial.printf("Failed to parse task json %s: %s\n", tpath.c_str(), err.c_str());
-        // try to preserve minimal structure
-        doc.clear();
-        doc["id"] = baseId;
-        doc["name"] = "";
-      }
-      if (name.length() > 0) {
-        doc["name"] = name;
-      } // else, keep the old name
-      doc["hasScript"] = LittleFS.exists(String("/scripts/") + baseId + ".lua"); // Recalculate hasScript
-      String out; serializeJson(doc, out);
-      File tfw = LittleFS.open(tpath, "w");
-      if (!tfw) {
-        Serial.printf("Failed to open task file for rewrite: %s\n", tpath.c_str());
-        ok = false;
-      } else {
-        size_t w2 = tfw.print(out);
-        tfw.close();
-        Serial.printf("Rewrote %u bytes to %s\n", w2, tpath.c_str());
-        if (w2 == 0 && out.length() > 0) {
-          Serial.println("Warning: 0 bytes written when updating task file"); ok = false;
-        }
-      }
+      rec->savedState = rec->state;
     }
   } else {
-    Serial.printf("Task file not found to update script: %s\n", tpath.c_str()); ok = false; }
+    Logger::warn("tasks", baseId.c_str(), "task not found to update script"); ok = false; }
 
   return ok;
 }
 
 /**
- * @brief Static task runner for executing a Lua script.
- * This function is executed in its own FreeRTOS task.
- * @param pvParameters Pointer to LuaTaskParams struct.
+ * @brief Starts (or restarts) the worker thread of a slot.
  */
-void TaskManager::_luaTaskRunner(void* pvParameters) {
-  LuaTaskParams* params = (LuaTaskParams*)pvParameters;
-  TaskManager* self = params->instance;
-  String taskId = params->taskId;
+bool TaskManager::_spawnWorker(uint8_t slot) {
+  Worker &w = _workers[slot];
+  w.handle = nullptr;
+  String name = String("luaWorker") + slot;
+  BaseType_t created;
+  if (_pinWorkers) {
+    created = xTaskCreatePinnedToCore(_workerTask, name.c_str(), TASK_WORKER_STACK, &w, 5,
+                                      &w.handle, slot % portNUM_PROCESSORS);
+  } else {
+    created = xTaskCreate(_workerTask, name.c_str(), TASK_WORKER_STACK, &w, 5, &w.handle);
+  }
+  return created == pdPASS;
+}
 
-  // Get script content
-  String scriptContent = self->getScript(taskId);
+/**
+ * @brief Worker thread that executes queued runs as coroutines.
+ */
+void TaskManager::_workerTask(void* pvParameters) {
+  Worker* worker = (Worker*)pvParameters;
+  TaskManager* self = worker->instance;
+  // All runs of this worker are threads of one host state
+  worker->current = nullptr;
+  worker->seenGeneration = self->_stopGeneration;
+  self->_attachHost(worker);
+  std::vector<Coroutine*> sleeping; // min-heap on wakeAt
+  // Heap order: the coroutine that wakes up first is on top (wrap-safe)
+  auto later = [](const Coroutine *a, const Coroutine *b) {
+    return (int32_t)(a->wakeAt - b->wakeAt) > 0;
+  };
+  RunRequest req;
+  bool held = false;     // req waits for memory
+  uint32_t heldSince = 0;
 
-  if (scriptContent.length() > 0) {
-    Serial.printf("Running script for task %s in a new thread\n", taskId.c_str());
-    lua_State *L = luaL_newstate();
-    if (L) {
-      luaL_openlibs(L);
+  for (;;) {
+    // Sleep until the next timer is due, but wake up regularly while coroutines
+    // are parked so that stopped runs are released without waiting for their timer.
+    TickType_t wait = portMAX_DELAY;
+    if (!sleeping.empty()) {
+      int32_t left = (int32_t)(sleeping.front()->wakeAt - millis());
+      if (left < 0) left = 0;
+      if (left > TASK_EXECUTOR_TICK_MS) left = TASK_EXECUTOR_TICK_MS;
+      wait = pdMS_TO_TICKS(left);
+    }
+    // A held run is retried every tick; no further runs are taken meanwhile
+    if (held && wait > pdMS_TO_TICKS(TASK_EXECUTOR_TICK_MS)) wait = pdMS_TO_TICKS(TASK_EXECUTOR_TICK_MS);
 
-      // Register C functions
-      lua_register(L, "log", l_log);
-      lua_register(L, "setLED", l_setLED);
-      lua_register(L, "delay", l_delay);
-      lua_register(L, "startTask", l_startTask);
-      lua_register(L, "stopTask", l_stopTask);
+    // A worker hosting its maximum of coroutines leaves new runs to the others
+    bool received = false;
+    if (held) {
+      vTaskDelay(wait);
+      received = true;
+    } else if (sleeping.size() < TASK_MAX_COROUTINES) {
+      received = xQueueReceive(self->_runQueue, &req, wait) == pdTRUE;
+    } else {
+      vTaskDelay(wait);
+    }
 
-      // Execute the script
-      int result = luaL_dostring(L, scriptContent.c_str());
-      if (result != LUA_OK) {
-        const char *error = lua_tostring(L, -1);
-        Serial.printf("Lua error in task %s: %s\n", taskId.c_str(), error);
+    if (received) {
+      if (!worker->host) self->_attachHost(worker);
+      // Queued runs wait here while the heap is low; the parked ones can finish
+      // and give memory back. A run stopped in the meantime is dropped by _spawnCoroutine().
+      bool wasHeld = held;
+      held = self->_runs.findRun(req.run) >= 0 && !MemoryGuard::available(MEM_GUARD_RUN_BYTES);
+      if (held && !wasHeld) {
+        heldSince = millis();
+        MemoryGuard::deferred();
       }
+      if (held && millis() - heldSince >= MEM_GUARD_DEFER_MS) {
+        held = false;
+        MemoryGuard::refused(MEM_USE_RUN);
+        Logger::warn("tasks", req.id, "low memory for %u ms, run %u dropped", (unsigned)MEM_GUARD_DEFER_MS, (unsigned)req.run);
+        self->_endRun(req.id, req.run);
+      } else if (!held) {
+        Coroutine *co = self->_spawnCoroutine(worker, req);
+        if (co && self->_resumeCoroutine(worker, co)) {
+          sleeping.push_back(co);
+          std::push_heap(sleeping.begin(), sleeping.end(), later);
+        }
+      }
+    }
 
-      lua_close(L);
-    } else {
-      Serial.printf("Failed to create Lua state for task %s\n", taskId.c_str());
+    // Resume every coroutine that is due. Runs that yield again are collected
+    // first, so delay(0) and preempted runs cannot starve the queue.
+    uint32_t now = millis();
+    std::vector<Coroutine*> due;
+    while (!sleeping.empty() && (int32_t)(now - sleeping.front()->wakeAt) >= 0) {
+      std::pop_heap(sleeping.begin(), sleeping.end(), later);
+      due.push_back(sleeping.back());
+      sleeping.pop_back();
+    }
+    // Parked runs that were stopped in the meantime are released right away
+    for (size_t i = 0; i < sleeping.size();) {
+      if (self->_isCurrentRun(sleeping[i])) { i++; continue; }
+      due.push_back(sleeping[i]);
+      sleeping.erase(sleeping.begin() + i);
+      std::make_heap(sleeping.begin(), sleeping.end(), later);
     }
+    for (Coroutine *co : due) {
+      if (self->_resumeCoroutine(worker, co)) {
+        sleeping.push_back(co);
+        std::push_heap(sleeping.begin(), sleeping.end(), later);
+      }
+    }
+
+    // Reclaim the garbage of finished runs once the worker is idle
+    if (sleeping.empty() && !due.empty() && worker->host) lua_gc(worker->host, LUA_GCCOLLECT, 0);
   }
+}
 
-  // After script execution, set the task state back to "stopped"
-  self->stopTask(taskId);
+/**
+ * @brief Gives a worker the host state it keeps for good.
+ */
+void TaskManager::_attachHost(Worker *worker) {
+  worker->host = _luaPool.acquire();
+  worker->arena = worker->host ? LuaStatePool::arena(worker->host) : nullptr;
+  // Every thread of the host inherits this pointer, so the hook finds its worker
+  if (worker->host) *(Worker**)lua_getextraspace(worker->host) = worker;
+}
 
-  // Remove task from the running list as it has now finished
-  self->_runningTasks.erase(taskId);
+/**
+ * @brief Debug hook that cancels stopped runs and preempts long-running ones.
+ */
+void TaskManager::_hook(lua_State *L, lua_Debug *ar) {
+  Worker *worker = *(Worker**)lua_getextraspace(L);
+  if (!worker || !worker->current) return;
+  Coroutine *co = worker->current;
+  bool overdue = (int32_t)(millis() - worker->sliceEnd) >= 0;
 
-  // Clean up and delete the task
-  delete params;
-  vTaskDelete(NULL);
+  if (co->stopping) {
+    // The onStop handler gets a fixed budget
+    if (overdue) luaL_error(L, "onStop exceeded %d ms", TASK_ONSTOP_BUDGET_MS);
+    return;
+  }
+  // Only look up the run when some task was stopped since the last check
+  TaskManager *self = worker->instance;
+  if (!co->cancelled && worker->seenGeneration != self->_stopGeneration) {
+    worker->seenGeneration = self->_stopGeneration;
+    co->cancelled = !self->_isCurrentRun(co);
+  }
+  bool own = L == co->thread && lua_isyieldable(L);
+  if (co->cancelled) {
+    // Suspend the run for good; the worker then drops it. Inside a nested
+    // coroutine or a C call the error unwinds to where yielding is possible.
+    if (own) {
+      lua_yield(L, 0);
+      return;
+    }
+    luaL_error(L, "task stopped");
+  }
+  // Time slice used up: let the other runs of this worker continue first
+  if (overdue && own) lua_yield(L, 0);
 }
 
 /**
- * @brief Runs a specific task, executing its Lua script if it exists.
+ * @brief Starts a queued run as a new coroutine of the host state.
  */
-bool TaskManager::runTask(const String &id) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
+TaskManager::Coroutine* TaskManager::_spawnCoroutine(Worker *worker, const RunRequest &req) {
+  String taskId = req.id;
+  uint32_t run = req.run;
+  uint32_t scriptHash = 0;
+  uint32_t memLimit = TASK_LUA_MEM_LIMIT;
+  {
+    // A request whose run was stopped or deleted while waiting is dropped
+    RegistryLock lock(_lock);
+    TaskRecord *rec = _findTask(taskId);
+    if (!rec || !_runs.setState(req.slot, run, TASK_RUNNING)) return nullptr;
+    rec->state = TASK_RUNNING;
+    _changed();
+    _publish(rec->id, "running", run);
+    scriptHash = rec->scriptHash;
+    if (rec->memLimit) memLimit = rec->memLimit;
   }
 
-  // 1. Check if task exists and is not already running
-  String tpath = String("/tasks/") + baseId + ".json";
-  if (!LittleFS.exists(tpath)) {
-    Serial.printf("Cannot run task, not found: %s\n", tpath.c_str());
+  lua_State *host = worker->host;
+  if (!host) {
+    Logger::error("tasks", taskId.c_str(), "failed to create Lua state");
+    _endRun(taskId, run);
+    return nullptr;
+  }
+
+  Coroutine *co = new Coroutine();
+  strlcpy(co->id, req.id, sizeof(co->id));
+  co->run = run;
+  co->slot = req.slot;
+  co->thread = lua_newthread(host);
+  co->ref = luaL_ref(host, LUA_REGISTRYINDEX);
+  co->envRef = LUA_NOREF;
+  co->wakeAt = 0;
+  co->cancelled = false;
+  co->stopping = false;
+  co->startedAt = millis();
+
+  // Load the precompiled chunk (or compile the source on a cache miss) onto the
+  // new thread and give it its own environment. The run's memory is accounted to
+  // its run table slot; unprotected API calls stay with the uncapped host.
+  worker->arena->beginOwner(co->slot + 1, memLimit);
+  uint32_t loadedHash = scriptHash;
+  worker->arena->setOwner(co->slot + 1);
+  int result = ScriptCache::load(co->thread, taskId, loadedHash);
+  worker->arena->setOwner(0);
+  if (loadedHash != scriptHash) {
+    // The hash was computed from the source (unknown after a boot, or the cache
+    // was refreshed); remember it unless the script was saved again meanwhile.
+    RegistryLock lock(_lock);
+    TaskRecord *rec = _findTask(taskId);
+    if (rec && rec->scriptHash == scriptHash) rec->scriptHash = loadedHash;
+  }
+  if (result != LUA_OK) {
+    if (result > LUA_OK) {
+      Logger::error("lua", taskId.c_str(), "%s", lua_tostring(co->thread, -1));
+    }
+    _finishCoroutine(worker, co);
+    return nullptr;
+  }
+  LuaStatePool::sandbox(co->thread);
+  // Keep the environment for the onStop handler
+  if (lua_getupvalue(co->thread, -1, 1)) co->envRef = luaL_ref(co->thread, LUA_REGISTRYINDEX);
+  lua_sethook(co->thread, _hook, LUA_MASKCOUNT, TASK_HOOK_COUNT);
+  // Register the thread with its run number so that the builtins can identify
+  // the run and delay() may yield it
+  lua_pushinteger(host, run);
+  lua_rawsetp(host, LUA_REGISTRYINDEX, co->thread);
+  Logger::info("tasks", taskId.c_str(), "running script on %s", pcTaskGetName(NULL));
+  return co;
+}
+
+/**
+ * @brief Resumes a coroutine until it yields or finishes.
+ */
+bool TaskManager::_resumeCoroutine(Worker *worker, Coroutine *co) {
+  if (!_isCurrentRun(co)) co->cancelled = true;
+  if (co->cancelled) {
+    _finishCoroutine(worker, co);
     return false;
   }
+  worker->current = co;
+  worker->sliceEnd = millis() + TASK_TIME_SLICE_MS;
+  worker->arena->setOwner(co->slot + 1);
+  int result = lua_resume(co->thread, worker->host, 0);
+  worker->arena->setOwner(0);
+  worker->current = nullptr;
+  if (result == LUA_YIELD && !co->cancelled) {
+    // delay() yields the number of milliseconds to sleep; a preempted run
+    // (yielded by the hook without a value) continues after the others.
+    lua_Integer ms = lua_gettop(co->thread) > 0 ? lua_tointeger(co->thread, -1) : 0;
+    lua_settop(co->thread, 0);
+    co->wakeAt = millis() + (uint32_t)(ms > 0 ? ms : 0);
+    return true;
+  }
+  if (result == LUA_ERRMEM && !co->cancelled) {
+    Logger::error("lua", co->id, "exceeded its memory limit (peak %u bytes)",
+                  (unsigned)worker->arena->peak(co->slot + 1));
+  } else if (result > LUA_YIELD && !co->cancelled) {
+    Logger::error("lua", co->id, "%s", lua_tostring(co->thread, -1));
+  }
+  _finishCoroutine(worker, co);
+  return false;
+}
 
-  DynamicJsonDocument doc(1024);
-  File tf = LittleFS.open(tpath, FILE_READ);
-  if (tf) {
-    deserializeJson(doc, tf);
-    tf.close();
-    String state = doc["state"];
-    if (state == "running") {
-      Serial.printf("Task %s is already running. Skipping.\n", baseId.c_str());
-      return false; // Prevent multiple instances
+/**
+ * @brief Calls the onStop handler of a cancelled run.
+ */
+void TaskManager::_runOnStop(Worker *worker, Coroutine *co) {
+  lua_State *host = worker->host;
+  // The cancelled thread is suspended and cannot call functions; use a new one
+  lua_State *T = lua_newthread(host);
+  lua_rawgeti(T, LUA_REGISTRYINDEX, co->envRef);
+  // The handler runs outside the run's memory cap, it may be called because of it
+  if (lua_getfield(T, -1, "onStop") == LUA_TFUNCTION) {
+    co->stopping = true;
+    worker->current = co;
+    worker->sliceEnd = millis() + TASK_ONSTOP_BUDGET_MS;
+    lua_sethook(T, _hook, LUA_MASKCOUNT, TASK_HOOK_COUNT);
+    if (lua_pcall(T, 0, 0, 0) != LUA_OK) {
+      Logger::error("lua", co->id, "error in onStop: %s", lua_tostring(T, -1));
     }
-    // Set state to "running"
-    doc["state"] = "running";
-    String out;
-    serializeJson(doc, out);
-    File tfw = LittleFS.open(tpath, FILE_WRITE);
-    if (tfw) {
-      tfw.print(out);
-      tfw.close();
-    } else {
-      return false; // Failed to update state
+    worker->current = nullptr;
+  }
+  lua_pop(host, 1); // the thread
+}
+
+/**
+ * @brief Releases a coroutine and ends its run.
+ */
+void TaskManager::_finishCoroutine(Worker *worker, Coroutine *co) {
+  lua_State *host = worker->host;
+  if (co->cancelled) {
+    Logger::info("tasks", co->id, "cancelled run %u", (unsigned)co->run);
+    if (co->envRef != LUA_NOREF) _runOnStop(worker, co);
+  }
+  // Dropping the references makes the thread, its stack and the environment
+  // garbage; nothing else of the run stays alive.
+  lua_pushnil(host);
+  lua_rawsetp(host, LUA_REGISTRYINDEX, co->thread);
+  luaL_unref(host, LUA_REGISTRYINDEX, co->envRef);
+  luaL_unref(host, LUA_REGISTRYINDEX, co->ref);
+  _endRun(co->id, co->run, worker->arena->peak(co->slot + 1), (int32_t)(millis() - co->startedAt));
+  delete co;
+  lua_gc(host, LUA_GCSTEP, 0);
+}
+
+/**
+ * @brief Ends a run in the registry unless the task was restarted in the meantime.
+ */
+void TaskManager::_endRun(const String &taskId, uint32_t run, uint32_t memPeak, int32_t elapsedMs) {
+  RegistryLock lock(_lock);
+  TaskRecord *rec = _findTask(taskId);
+  if (rec && memPeak) rec->memPeak = memPeak;
+  if (rec && elapsedMs >= 0) {
+    TaskRunStats &st = rec->stats;
+    st.runs++;
+    st.lastMs = (uint32_t)elapsedMs;
+    st.totalMs += (uint32_t)elapsedMs;
+    if (st.lastMs > st.maxMs) st.maxMs = st.lastMs;
+    if (memPeak > st.memPeakMax) st.memPeakMax = memPeak;
+  }
+  _changed();
+  // A deleted task has no record; deleteTask() already released its run
+  if (!rec || !_runs.release(rec->runKey, run)) return;
+  rec->state = TASK_STOPPED; // the background flush persists it
+  _publish(taskId.c_str(), "stopped", run);
+}
+
+/**
+ * @brief Logs a line on behalf of the script running on a Lua thread.
+ */
+void TaskManager::scriptLog(lua_State *L, const char *msg) {
+  // Every run executes on a worker host state, whose extraspace points to the worker
+  Worker *worker = *(Worker**)lua_getextraspace(L);
+  Coroutine *co = worker ? worker->current : nullptr;
+  Logger::info("lua", co ? co->id : nullptr, "%s", msg);
+  if (_events && co) _events->publishLog(co->id, co->run, msg);
+}
+
+/**
+ * @brief Gets the time left to the onStop handler running on a Lua thread.
+ */
+int32_t TaskManager::onStopTimeLeft(lua_State *L) {
+  Worker *worker = *(Worker**)lua_getextraspace(L);
+  Coroutine *co = worker ? worker->current : nullptr;
+  if (!co || !co->stopping) return -1;
+  int32_t left = (int32_t)(worker->sliceEnd - millis());
+  return left > 0 ? left : 0;
+}
+
+/**
+ * @brief Runs a specific task, executing its Lua script if it exists.
+ */
+bool TaskManager::runTask(const String &id) {
+  return startRun(id) == RUN_OK;
+}
+
+/**
+ * @brief Requests a run of a task.
+ */
+TaskManager::RunStatus TaskManager::startRun(const String &id, uint32_t parentRun, uint32_t *runOut) {
+  String baseId = baseTaskId(id);
+
+  // 1. Check if task exists and is not already queued or running
+  RegistryLock lock(_lock);
+  TaskRecord *rec = _findTask(baseId);
+  if (!rec) {
+    Logger::warn("tasks", baseId.c_str(), "cannot run task, not found");
+    return RUN_NOT_FOUND;
+  }
+  // A task may not be started by a run it (indirectly) started itself
+  uint32_t key = rec->runKey;
+  uint32_t ancestor = parentRun;
+  for (int depth = 0; ancestor && depth < RUN_TABLE_SIZE; depth++) {
+    int slot = _runs.findRun(ancestor);
+    if (slot < 0) break;
+    if (_runs.task(slot) == key) {
+      Logger::warn("tasks", baseId.c_str(), "already part of the calling chain, skipping");
+      return RUN_CYCLE;
     }
-  } else {
-    return false; // Failed to read task file
+    ancestor = _runs.parent(slot);
+  }
+  if (_runs.state(key) != TASK_STOPPED) {
+    Logger::warn("tasks", baseId.c_str(), "already active, skipping");
+    return RUN_ALREADY_ACTIVE; // Prevent multiple instances
+  }
+  // A run started on a fragmented heap could fail halfway; refuse it up front
+  if (!MemoryGuard::admit(MEM_USE_RUN, MEM_GUARD_RUN_BYTES)) {
+    Logger::warn("tasks", baseId.c_str(), "low memory, not started");
+    return RUN_LOW_MEMORY;
   }
 
-  // 2. Create parameters for the new task
-  LuaTaskParams* params = new LuaTaskParams{this, baseId};
+  // 2. Hand the task to the run queue without waiting; a full queue (or run
+  // table) means the workers are saturated and the request is refused.
+  _runCounter = (_runCounter + 1) & 0x3FFFFFFF; // run numbers share a word with the state
+  if (_runCounter == 0) _runCounter = 1;
+  RunRequest req = {};
+  strlcpy(req.id, rec->id, sizeof(req.id));
+  req.run = _runCounter;
+  req.slot = _runs.claim(key, req.run, parentRun);
+  if (req.slot < 0 || !_runQueue || xQueueSend(_runQueue, &req, 0) != pdTRUE) {
+    if (req.slot >= 0) _runs.release(key, req.run);
+    Logger::warn("tasks", baseId.c_str(), "run queue full, not started");
+    return RUN_QUEUE_FULL;
+  }
+  // Set state to "queued"; the background flush persists it.
+  rec->state = TASK_QUEUED;
+  _changed();
+  _publish(rec->id, "queued", req.run);
+  if (runOut) *runOut = req.run;
+  return RUN_OK;
+}
+
+/**
+ * @brief Checks whether a task is queued or running.
+ */
+bool TaskManager::isRunning(const String &id) {
+  String baseId = baseTaskId(id);
+  // Only numeric IDs can skip the registry
+  uint32_t key = RunTable::key(baseId.c_str());
+  if (!key) {
+    RegistryLock lock(_lock);
+    key = _runKey(baseId);
+  }
+  return _runs.state(key) != TASK_STOPPED;
+}
 
-  TaskHandle_t taskHandle = NULL;
+/**
+ * @brief Checks whether a run is still queued or running.
+ */
+bool TaskManager::isRunActive(uint32_t run) {
+  return _runs.findRun(run) >= 0;
+}
 
-  // 3. Create and start the FreeRTOS task
-  BaseType_t taskCreated = xTaskCreate(_luaTaskRunner, ("lua_" + baseId).c_str(), 8192, params, 5, &taskHandle);
+/**
+ * @brief Records that a run waits for another one.
+ */
+bool TaskManager::setWaiting(uint32_t waiter, uint32_t run) {
+  RegistryLock lock(_lock);
+  if (_runs.findRun(waiter) < 0) return true;
+  // Follow the chain of waits starting at the awaited run; reaching the waiter
+  // means the runs would wait for each other forever.
+  uint32_t next = run;
+  for (int depth = 0; next && depth <= RUN_TABLE_SIZE; depth++) {
+    if (next == waiter) return false;
+    int slot = _runs.findRun(next);
+    if (slot < 0) break;
+    next = _runs.waitingOn(slot);
+  }
+  _runs.setWaiting(waiter, run);
+  return true;
+}
 
-  _runningTasks[baseId] = taskHandle;
-  if (taskCreated != pdPASS) {
-    Serial.printf("Failed to create task for script %s\n", baseId.c_str());
-    delete params; // Clean up if task creation failed
-    stopTask(baseId); // Revert state to "stopped"
+/**
+ * @brief Sets the Lua memory cap of a task's runs.
+ */
+bool TaskManager::setMemoryLimit(const String &id, uint32_t bytes) {
+  String baseId = baseTaskId(id);
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  TaskRecord *rec = _findTask(baseId);
+  if (!rec) {
+    Logger::warn("tasks", baseId.c_str(), "cannot set memory limit, task not found");
     return false;
   }
-
-  return true; // Task creation request was successful
+  rec->memLimit = bytes;
+  _changed();
+  if (!_store.put(*rec)) return false;
+  rec->savedState = rec->state;
+  return true;
 }
 
 /**
  * @brief Retrieves the script content for a given task.
  */
 String TaskManager::getScript(const String &id) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
-  }
+  String baseId = baseTaskId(id);
   String path = String("/scripts/") + baseId + ".lua";
-  if (!LittleFS.exists(path)) return "";
-  File f = LittleFS.open(path, FILE_READ);
-  if (!f) return "";
-  String s = f.readString(); f.close(); return s;
+  String s;
+  AtomicFile::read(path, s); // without the checksum footer
+  return s;
 }
 
 /**
@@ -322,165 +1040,237 @@ String TaskManager::getScript(const String &id) {
  */
 bool TaskManager::deleteTask(const String &id) {
   if (id.isEmpty()) {
-    Serial.println("Error: deleteTask called with an empty ID.");
+    Logger::error("tasks", nullptr, "deleteTask called with an empty ID");
     return false;
   }
 
   // The ID might come with ".json" extension from the API call.
   // We need the base ID to correctly construct both paths.
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
-  }
+  String baseId = baseTaskId(id);
 
-  String tpath = String("/tasks/") + baseId + ".json";
   String spath = String("/scripts/") + baseId + ".lua";
 
-  Serial.printf("--- Deleting Task ID: %s ---\n", baseId.c_str());
+  Logger::info("tasks", baseId.c_str(), "deleting task");
 
-  // The concept of stopping a task is just changing its state in the JSON file.
-  // Since we are about to delete the file, there is no need to write "stopped" to it first.
-  // The task will cease to exist, which is the ultimate "stopped" state.
+  // A running script is stopped first. There is no need to store "stopped" for it,
+  // the task will cease to exist, which is the ultimate "stopped" state.
+  // A flush in progress is allowed to finish so it cannot resurrect the task.
+  FlushLock flushLock(_flushLock);
+  RegistryLock lock(_lock);
+  // The debug hook of the run cancels it; its worker releases the coroutine
+  if (_runs.release(_runKey(baseId))) _stopGeneration++;
 
-  // Per user request, delete script file first, then the task file.
+  // Per user request, delete script file first, then the task record.
   bool scriptFileRemoved = false;
   if (LittleFS.exists(spath)) {
     scriptFileRemoved = LittleFS.remove(spath);
-    Serial.printf("  > %s script file: %s\n", scriptFileRemoved ? "Deleted" : "FAILED to delete", spath.c_str());
+    Logger::write(scriptFileRemoved ? LOG_LEVEL_DEBUG : LOG_LEVEL_ERROR, "tasks", baseId.c_str(), "%s script file %s", scriptFileRemoved ? "deleted" : "failed to delete", spath.c_str());
   } else {
-    Serial.printf("  > Script file not found, skipping: %s\n", spath.c_str());
+    Logger::debug("tasks", baseId.c_str(), "script file %s not found, skipping", spath.c_str());
     scriptFileRemoved = true; // If it doesn't exist, consider it "removed".
   }
+  ScriptCache::remove(baseId);
 
-  bool taskFileRemoved = false;
-  if (LittleFS.exists(tpath)) {
-    taskFileRemoved = LittleFS.remove(tpath);
-    Serial.printf("  > %s task file: %s\n", taskFileRemoved ? "Deleted" : "FAILED to delete", tpath.c_str());
+  bool taskRecordRemoved = true;
+  if (_findTask(baseId)) {
+    taskRecordRemoved = _store.remove(baseId.c_str());
+    Logger::write(taskRecordRemoved ? LOG_LEVEL_DEBUG : LOG_LEVEL_ERROR, "tasks", baseId.c_str(), "%s task record", taskRecordRemoved ? "deleted" : "failed to delete");
   } else {
-    Serial.printf("  > Task file not found (already deleted?): %s\n", tpath.c_str());
-    taskFileRemoved = true; // If it doesn't exist, consider it "removed".
+    Logger::warn("tasks", baseId.c_str(), "task record not found (already deleted?)");
   }
 
-  return taskFileRemoved && scriptFileRemoved;
+  for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+    if (strcmp(it->id, baseId.c_str()) == 0) {
+      _tasks.erase(it);
+      break;
+    }
+  }
+  _changed();
+  _publish(baseId.c_str(), "deleted", 0);
+
+  return taskRecordRemoved && scriptFileRemoved;
 }
 
 /**
  * @brief Stops a specific task.
  */
 bool TaskManager::stopTask(const String &id) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
-  }
-  String tpath = String("/tasks/") + baseId + ".json";
+  String baseId = baseTaskId(id);
+  RegistryLock lock(_lock);
 
-  // If the task is actively running, stop its FreeRTOS task
-  if (_runningTasks.count(baseId)) {
-    TaskHandle_t handle = _runningTasks[baseId];
-    if (handle) {
-      vTaskDelete(handle);
-      _runningTasks.erase(baseId);
-      Serial.printf("Force-stopped running task: %s\n", baseId.c_str());
-    }
+  // Detaching the run is enough: its debug hook notices within a few thousand
+  // instructions, the worker drops the coroutine and calls the script's onStop
+  // handler. A queued task only needs its state reset; the worker skips the request.
+  if (_runs.release(_runKey(baseId))) {
+    _stopGeneration++; // lets the debug hook of the run notice
+    Logger::info("tasks", baseId.c_str(), "stopping running task");
+    _publish(baseId.c_str(), "stopped", 0);
   }
-  if (!LittleFS.exists(tpath)) {
-    Serial.printf("Cannot stop task, not found: %s\n", tpath.c_str());
+  TaskRecord *rec = _findTask(baseId);
+  if (!rec) {
+    Logger::warn("tasks", baseId.c_str(), "cannot stop task, not found");
     return false;
   }
-  File tf = LittleFS.open(tpath, FILE_READ);
-  if (!tf) return false;
-  String s = tf.readString();
-  tf.close();
+  rec->state = TASK_STOPPED; // Mark as stopped; the background flush persists it
+  _changed();
+  return true;
+}
 
-  DynamicJsonDocument doc(1024);
-  deserializeJson(doc, s);
-  doc["state"] = "stopped"; // Mark as stopped
-  String out;
-  serializeJson(doc, out);
+/**
+ * @brief Gets the number of tasks that have a script attached.
+ */
+size_t TaskManager::scriptCount() {
+  RegistryLock lock(_lock);
+  size_t count = 0;
+  for (const TaskRecord &rec : _tasks) {
+    if (rec.hasScript) count++;
+  }
+  return count;
+}
 
-  File tfw = LittleFS.open(tpath, FILE_WRITE);
-  if (!tfw) return false;
-  tfw.print(out);
-  tfw.close();
-  return true;
+/**
+ * @brief Gets the number of tasks that are currently running.
+ */
+size_t TaskManager::runningCount() {
+  // Served from the run table without taking the registry lock
+  return _runs.count(TASK_RUNNING);
+}
+
+/**
+ * @brief Gets the /api/metrics section of the task engine.
+ */
+MetricsStream::Section TaskManager::metricsSection() {
+  static const struct { const char *name, *type, *help; } FAMILIES[] = {
+    { "wash_task_runs_total", "counter", "Finished runs of a task since boot." },
+    { "wash_task_run_last_seconds", "gauge", "Duration of the last run of a task." },
+    { "wash_task_run_avg_seconds", "gauge", "Average run duration of a task." },
+    { "wash_task_run_max_seconds", "gauge", "Longest run of a task." },
+    { "wash_task_lua_mem_peak_bytes", "gauge", "Highest Lua memory peak of a run of a task." },
+  };
+  static const size_t FAMILY_COUNT = sizeof(FAMILIES) / sizeof(FAMILIES[0]);
+  struct Cursor { size_t family; size_t index; bool started; };
+  std::shared_ptr<Cursor> cur = std::make_shared<Cursor>(Cursor{ 0, 0, false });
+  return [this, cur](String &out) {
+    if (!cur->started) {
+      // Counters of the run table and the queue, read without the registry lock
+      cur->started = true;
+      size_t count;
+      {
+        RegistryLock lock(_lock);
+        count = _tasks.size();
+      }
+      Metrics::family(out, "wash_tasks", "gauge", "Tasks in the registry.");
+      Metrics::sample(out, "wash_tasks", nullptr, (uint64_t)count);
+      Metrics::family(out, "wash_runs", "gauge", "Runs by state.");
+      Metrics::sample(out, "wash_runs", "state=\"running\"", (uint64_t)_runs.count(TASK_RUNNING));
+      Metrics::sample(out, "wash_runs", "state=\"queued\"", (uint64_t)_runs.count(TASK_QUEUED));
+      Metrics::family(out, "wash_run_queue_pending", "gauge", "Run requests waiting for a worker.");
+      Metrics::sample(out, "wash_run_queue_pending", nullptr, (uint64_t)(_runQueue ? uxQueueMessagesWaiting(_runQueue) : 0));
+      Metrics::family(out, "wash_run_queue_capacity", "gauge", "Capacity of the run queue.");
+      Metrics::sample(out, "wash_run_queue_capacity", nullptr, (uint64_t)_queueDepth);
+      Metrics::family(out, "wash_lua_workers", "gauge", "Lua worker threads.");
+      Metrics::sample(out, "wash_lua_workers", nullptr, (uint64_t)_workerCount);
+      return true;
+    }
+    while (cur->family < FAMILY_COUNT) {
+      TaskRecord rec;
+      bool found = false;
+      {
+        RegistryLock lock(_lock);
+        if (cur->index < _tasks.size()) {
+          rec = _tasks[cur->index];
+          found = true;
+        }
+      }
+      if (!found) {
+        cur->family++;
+        cur->index = 0;
+        continue;
+      }
+      if (cur->index++ == 0) Metrics::family(out, FAMILIES[cur->family].name, FAMILIES[cur->family].type, FAMILIES[cur->family].help);
+      String labels = Metrics::label("task", rec.id) + "," + Metrics::label("name", rec.name);
+      const TaskRunStats &st = rec.stats;
+      switch (cur->family) {
+        case 0: Metrics::sample(out, FAMILIES[0].name, labels.c_str(), (uint64_t)st.runs); break;
+        case 1: Metrics::sample(out, FAMILIES[1].name, labels.c_str(), st.lastMs / 1000.0); break;
+        case 2: Metrics::sample(out, FAMILIES[2].name, labels.c_str(), st.runs ? st.totalMs / 1000.0 / st.runs : 0.0); break;
+        case 3: Metrics::sample(out, FAMILIES[3].name, labels.c_str(), st.maxMs / 1000.0); break;
+        default: Metrics::sample(out, FAMILIES[4].name, labels.c_str(), (uint64_t)st.memPeakMax); break;
+      }
+      return true;
+    }
+    return false;
+  };
 }
 
 /**
  * @brief Gets the JSON metadata for a single task.
  */
 String TaskManager::getTaskJSON(const String &id) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
+  String baseId = baseTaskId(id);
+  StaticJsonDocument<256> doc;
+  {
+    RegistryLock lock(_lock);
+    TaskRecord *rec = _findTask(baseId);
+    if (!rec) return "";
+    _recordToJSON(*rec, doc.to<JsonObject>());
   }
-  String tpath = String("/tasks/") + baseId + ".json";
-  if (!LittleFS.exists(tpath)) return "";
-  File tf = LittleFS.open(tpath, FILE_READ);
-  if (!tf) return "";
-  String s = tf.readString(); tf.close(); return s;
+  String out; serializeJson(doc, out); return out;
 }
 
 /**
  * @brief Gets a single task as JSON including its script content.
  */
-String TaskManager::getTaskWithScriptJSON(const String &id) {
-  String baseId = id;
-  if (baseId.endsWith(".json")) {
-    baseId.remove(baseId.length() - 5);
+String TaskManager::getTaskWithScriptJSON(const String &id, bool *lowMemory) {
+  String baseId = baseTaskId(id);
+  TaskRecord rec;
+  {
+    RegistryLock lock(_lock);
+    TaskRecord *found = _findTask(baseId);
+    if (!found) return "";
+    rec = *found;
   }
-  String raw = getTaskJSON(baseId);
-  if (raw.length() == 0) return "";
-  DynamicJsonDocument meta(1024);
-  DeserializationError err = deserializeJson(meta, raw);
-  if (err) return "";
   String scriptContent = getScript(baseId);
   // Reserve enough for id/name/state/hasScript + script (JSON escaping can ~double size)
   size_t scriptSerialLen = scriptContent.length() * 2 + 256;
   size_t cap = 512 + scriptSerialLen;
   if (cap < 2048) cap = 2048;
+  // The document is one block; "freeHeap" may look fine while no block is that large
+  if (!MemoryGuard::admit(MEM_USE_RESPONSE, cap)) {
+    if (lowMemory) *lowMemory = true;
+    return "";
+  }
   DynamicJsonDocument doc(cap);
   if (!doc.capacity()) return "";  // allocation failed
-  doc["id"] = meta["id"].as<String>();
-  doc["name"] = meta["name"].as<String>();
-  doc["state"] = meta["state"].as<String>();
-  doc["hasScript"] = meta.containsKey("hasScript") && meta["hasScript"].as<bool>();
-  doc["script"] = scriptContent;
+  JsonObject obj = doc.to<JsonObject>();
+  _recordToJSON(rec, obj);
+  obj["script"] = scriptContent;
   String out;
   serializeJson(doc, out);
   return out;
 }
 
 /**
- * @brief Gets a JSON string representing all tasks.
- */
-String TaskManager::getTasksJSON() {
-  DynamicJsonDocument doc(2048);
-  JsonArray arr = doc.createNestedArray("tasks");
-  int runningCount = 0;
-  File root = LittleFS.open("/tasks");
-  if (root && root.isDirectory()) {
-    File file = root.openNextFile();
-    while(file){
-      if (!file.isDirectory()) {
-        DynamicJsonDocument tdoc(1024);
-        DeserializationError error = deserializeJson(tdoc, file);
-        if (error) {
-          Serial.printf("Failed to parse task JSON from stream: %s\n", file.name());
-        } else {
-          const char* state = tdoc["state"] | "stopped";
-          if (state && strcmp(state, "running") == 0) runningCount++;
-          JsonObject obj = arr.createNestedObject();
-          obj["id"] = tdoc["id"].as<String>();
-          obj["name"] = tdoc["name"].as<String>();
-          obj["state"] = String(state);
-          obj["hasScript"] = tdoc.containsKey("hasScript") && tdoc["hasScript"].as<bool>();
-        }
-      }
-      file.close();
-      file = root.openNextFile();
-    }
-    root.close();
-  }
-  doc["runningTasks"] = runningCount;
-  String out; serializeJson(doc, out); return out;
+ * @brief Fills a JSON object describing one task of the registry.
+ */
+bool TaskManager::getTaskEntryJSON(size_t index, JsonObject obj) {
+  RegistryLock lock(_lock);
+  if (index >= _tasks.size()) return false;
+  _recordToJSON(_tasks[index], obj);
+  return true;
+}
+
+/**
+ * @brief Fills the run counters into a JSON object.
+ */
+void TaskManager::getQueueJSON(JsonObject obj) {
+  // Run states and counters come from the lock-free run table
+  size_t running = _runs.count(TASK_RUNNING);
+  obj["runningTasks"] = running;
+  JsonObject queue = obj.createNestedObject("queue");
+  queue["pending"] = _runQueue ? (unsigned)uxQueueMessagesWaiting(_runQueue) : 0u;
+  queue["capacity"] = _queueDepth;
+  queue["workers"] = _workerCount;
+  queue["active"] = running + _runs.count(TASK_QUEUED);
+  queue["slots"] = _workerCount * TASK_MAX_COROUTINES;
 }
@@ -0,0 +1,359 @@
+/**
+ * @file TaskStore.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the TaskStore class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "TaskStore.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include "AtomicFile.h"
+#include "Logger.h"
+
+static const uint32_t STORE_MAGIC = 0x53545057; // "WPTS"
+static const uint16_t STORE_VERSION = 2;
+static const uint16_t STORE_V1_RECORD_SIZE = 88; ///< Version 1 records lack memLimit.
+
+static const uint8_t OP_PUT = 1;       ///< Record holds the current version of a task.
+static const uint8_t OP_DELETE = 2;    ///< Record is a tombstone for a deleted task.
+static const uint8_t FLAG_HAS_SCRIPT = 0x01;
+
+/**
+ * @struct StoreHeader
+ * @brief File header of the task database.
+ */
+struct __attribute__((packed)) StoreHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+};
+
+/**
+ * @struct StoreRecord
+ * @brief On-disk layout of one log record.
+ */
+struct __attribute__((packed)) StoreRecord {
+  uint8_t op;
+  uint8_t state;
+  uint8_t flags;
+  uint8_t reserved;
+  char id[16];
+  char name[64];
+  uint32_t memLimit;  ///< Lua memory cap of a run in bytes, 0 for the default.
+  uint32_t crc;       ///< CRC-32 of all preceding bytes of the record.
+};
+
+/**
+ * @brief Encodes a task record into its on-disk form.
+ */
+static void encodeRecord(StoreRecord &out, uint8_t op, const TaskRecord &rec) {
+  memset(&out, 0, sizeof(out));
+  out.op = op;
+  out.state = rec.state;
+  out.flags = rec.hasScript ? FLAG_HAS_SCRIPT : 0;
+  strlcpy(out.id, rec.id, sizeof(out.id));
+  strlcpy(out.name, rec.name, sizeof(out.name));
+  out.memLimit = rec.memLimit;
+  out.crc = AtomicFile::crc32((const uint8_t*)&out, offsetof(StoreRecord, crc));
+}
+
+/**
+ * @brief Opens the store, migrating the legacy layout if needed.
+ */
+bool TaskStore::begin(const char *path) {
+  _path = path;
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  AtomicFile::recover(_path); // a compaction cut short by a reset
+  if (LittleFS.exists(_path)) return true;
+  if (LittleFS.exists("/tasks")) return _migrateLegacy();
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _writeFile(std::vector<TaskRecord>());
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Replays the log and returns all live task records.
+ */
+bool TaskStore::load(std::vector<TaskRecord> &out) {
+  out.clear();
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _live.clear();
+  _records = 0;
+  if (!LittleFS.exists(_path)) {
+    // The database was removed (e.g. through the file manager), start empty
+    bool ok = _writeFile(out);
+    xSemaphoreGive(_mutex);
+    return ok;
+  }
+  File f = LittleFS.open(_path, FILE_READ);
+  if (!f) {
+    xSemaphoreGive(_mutex);
+    return false;
+  }
+  StoreHeader hdr;
+  if (f.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != STORE_MAGIC ||
+      !((hdr.version == 1 && hdr.recordSize == STORE_V1_RECORD_SIZE) ||
+        (hdr.version == STORE_VERSION && hdr.recordSize == sizeof(StoreRecord)))) {
+    // Nothing in the file can be trusted; keep it for inspection and start empty
+    f.close();
+    Logger::error("store", nullptr, "invalid header in %s, moved to %s.bad", _path.c_str(), _path.c_str());
+    _setAside();
+    _writeFile(out);
+    xSemaphoreGive(_mutex);
+    return false;
+  }
+  // Older records are a prefix of the current layout followed by their CRC
+  bool upgrade = hdr.version != STORE_VERSION;
+  size_t recSize = hdr.recordSize;
+  uint8_t buf[sizeof(StoreRecord)];
+  StoreRecord r;
+  uint32_t offset = sizeof(StoreHeader);
+  uint32_t skipped = 0; // records failing their CRC
+  bool torn = false;    // short final record of an interrupted append
+  for (;; offset += recSize) {
+    size_t n = f.read(buf, recSize);
+    if (n == 0) break;
+    if (n != recSize) {
+      Logger::warn("store", nullptr, "torn record at offset %u, dropped", (unsigned)offset);
+      torn = true;
+      break;
+    }
+    _records++;
+    uint32_t crc;
+    memcpy(&crc, buf + recSize - sizeof(crc), sizeof(crc));
+    if (crc != AtomicFile::crc32(buf, recSize - sizeof(crc))) {
+      // Records have a fixed size, so the ones after a bad record are still readable
+      Logger::warn("store", nullptr, "damaged record at offset %u, skipped", (unsigned)offset);
+      skipped++;
+      continue;
+    }
+    memset(&r, 0, sizeof(r));
+    memcpy(&r, buf, recSize - sizeof(crc));
+    r.id[sizeof(r.id) - 1] = '\0';
+    r.name[sizeof(r.name) - 1] = '\0';
+    auto it = out.begin();
+    while (it != out.end() && strcmp(it->id, r.id) != 0) ++it;
+    if (r.op == OP_PUT) {
+      TaskRecord rec = {};
+      strlcpy(rec.id, r.id, sizeof(rec.id));
+      strlcpy(rec.name, r.name, sizeof(rec.name));
+      rec.state = r.state;
+      rec.savedState = r.state;
+      rec.hasScript = (r.flags & FLAG_HAS_SCRIPT) != 0;
+      rec.memLimit = r.memLimit;
+      if (it != out.end()) *it = rec;
+      else out.push_back(rec);
+      _setLive(r.id, true);
+    } else if (r.op == OP_DELETE) {
+      if (it != out.end()) out.erase(it);
+      _setLive(r.id, false);
+    }
+  }
+  f.close();
+  // A skipped record may have held the only copy of a change; the original
+  // file is kept before the clean one replaces it
+  if (skipped) {
+    Logger::error("store", nullptr, "%u damaged records in %s, original kept as %s.bad",
+                  (unsigned)skipped, _path.c_str(), _path.c_str());
+    _setAside();
+  }
+  if (upgrade) Logger::info("store", nullptr, "upgrading %s to version %u", _path.c_str(), STORE_VERSION);
+  // Rewritten before the lock is released, so no append can land in between
+  if (skipped || torn || upgrade) _compact(out);
+  xSemaphoreGive(_mutex);
+  return true;
+}
+
+/**
+ * @brief Appends the current version of a task record.
+ */
+bool TaskStore::put(const TaskRecord &rec) {
+  StoreRecord r;
+  encodeRecord(r, OP_PUT, rec);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _append((const uint8_t*)&r, sizeof(r), 1);
+  if (ok) _setLive(rec.id, true);
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Appends several task records with a single file open.
+ */
+bool TaskStore::putMany(const std::vector<TaskRecord> &recs) {
+  if (recs.empty()) return true;
+  std::vector<StoreRecord> buf(recs.size());
+  for (size_t i = 0; i < recs.size(); i++) encodeRecord(buf[i], OP_PUT, recs[i]);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _append((const uint8_t*)buf.data(), buf.size() * sizeof(StoreRecord), buf.size());
+  if (ok) {
+    for (const TaskRecord &rec : recs) _setLive(rec.id, true);
+  }
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Appends a tombstone for a task.
+ */
+bool TaskStore::remove(const char *id) {
+  TaskRecord rec = {};
+  strlcpy(rec.id, id, sizeof(rec.id));
+  StoreRecord r;
+  encodeRecord(r, OP_DELETE, rec);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _append((const uint8_t*)&r, sizeof(r), 1);
+  if (ok) _setLive(id, false);
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Checks whether the log should be compacted.
+ */
+bool TaskStore::needsCompaction() const {
+  return _records > 2 * _live.size() + 16;
+}
+
+/**
+ * @brief Rewrites the store so that it only contains the given records.
+ */
+bool TaskStore::compact(const std::vector<TaskRecord> &live) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _compact(live);
+  xSemaphoreGive(_mutex);
+  return ok;
+}
+
+/**
+ * @brief Rewrites the store with the given records and rebuilds the set of live IDs.
+ */
+bool TaskStore::_compact(const std::vector<TaskRecord> &live) {
+  bool ok = _writeFile(live);
+  if (ok) {
+    _live.clear();
+    _records = 0;
+    for (const TaskRecord &rec : live) _setLive(rec.id, true);
+    _records = live.size();
+    Logger::info("store", nullptr, "compacted to %u records", (unsigned)_records);
+  } else {
+    Logger::error("store", nullptr, "compaction failed");
+  }
+  return ok;
+}
+
+/**
+ * @brief Appends encoded records to the log.
+ */
+bool TaskStore::_append(const uint8_t *data, size_t len, size_t count) {
+  File f = LittleFS.open(_path, FILE_APPEND);
+  if (!f) return false;
+  size_t written = f.write(data, len);
+  f.close();
+  if (written != len) return false;
+  _records += count;
+  return true;
+}
+
+/**
+ * @brief Writes a complete store, replacing the database file.
+ */
+bool TaskStore::_writeFile(const std::vector<TaskRecord> &recs) {
+  AtomicFile f(_path);
+  StoreHeader hdr = { STORE_MAGIC, STORE_VERSION, sizeof(StoreRecord) };
+  f.write((const uint8_t*)&hdr, sizeof(hdr));
+  StoreRecord r;
+  for (size_t i = 0; f.ok() && i < recs.size(); i++) {
+    encodeRecord(r, OP_PUT, recs[i]);
+    f.write((const uint8_t*)&r, sizeof(r));
+  }
+  return f.commit();
+}
+
+/**
+ * @brief Renames the database file to "<path>.bad", replacing an older one.
+ */
+void TaskStore::_setAside() {
+  String bad = _path + ".bad";
+  LittleFS.remove(bad);
+  LittleFS.rename(_path, bad);
+}
+
+/**
+ * @brief Adds an ID to or removes it from the set of live IDs.
+ */
+void TaskStore::_setLive(const char *id, bool live) {
+  for (auto it = _live.begin(); it != _live.end(); ++it) {
+    if (strcmp(it->id, id) == 0) {
+      if (!live) _live.erase(it);
+      return;
+    }
+  }
+  if (live) {
+    LiveId e = {};
+    strlcpy(e.id, id, sizeof(e.id));
+    _live.push_back(e);
+  }
+}
+
+/**
+ * @brief Imports /tasks/<id>.json into a new store and removes the legacy files.
+ */
+bool TaskStore::_migrateLegacy() {
+  std::vector<TaskRecord> recs;
+  std::vector<String> files; // imported, removed once the store is written
+  std::vector<String> bad;   // unreadable, renamed to .bad
+  File root = LittleFS.open("/tasks");
+  if (root && root.isDirectory()) {
+    File file = root.openNextFile();
+    while (file) {
+      String fname = file.name();
+      fname = fname.substring(fname.lastIndexOf('/') + 1);
+      if (!file.isDirectory() && fname.endsWith(".json")) {
+        DynamicJsonDocument tdoc(1024);
+        DeserializationError error = deserializeJson(tdoc, file);
+        if (error) {
+          // Kept for inspection; only imported files are removed below
+          bad.push_back(String("/tasks/") + fname);
+          Logger::error("store", nullptr, "cannot parse /tasks/%s (%s), not migrated", fname.c_str(), error.c_str());
+        } else {
+          files.push_back(String("/tasks/") + fname);
+          TaskRecord rec = {};
+          String id = tdoc["id"] | "";
+          if (id.length() == 0) id = fname.substring(0, fname.length() - 5);
+          strlcpy(rec.id, id.c_str(), sizeof(rec.id));
+          strlcpy(rec.name, tdoc["name"] | "", sizeof(rec.name));
+          rec.state = TASK_STOPPED; // nothing is running across a reboot
+          rec.savedState = TASK_STOPPED;
+          rec.hasScript = (tdoc["hasScript"] | false) || LittleFS.exists(String("/scripts/") + rec.id + ".lua");
+          recs.push_back(rec);
+        }
+      }
+      file.close();
+      file = root.openNextFile();
+    }
+    root.close();
+  }
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool ok = _writeFile(recs);
+  xSemaphoreGive(_mutex);
+  if (!ok) {
+    Logger::error("store", nullptr, "migration of /tasks failed, legacy files kept");
+    return false;
+  }
+  // The store is complete on disk, the imported files can go. The directory
+  // stays while it holds unreadable ones, which are renamed so the next
+  // boot does not try them again.
+  for (const String &path : files) LittleFS.remove(path);
+  for (const String &path : bad) {
+    LittleFS.remove(path + ".bad");
+    LittleFS.rename(path, path + ".bad");
+  }
+  if (bad.empty()) LittleFS.rmdir("/tasks");
+  Logger::info("store", nullptr, "migrated %u tasks from /tasks", (unsigned)recs.size());
+  if (!bad.empty()) Logger::warn("store", nullptr, "%u task files could not be read, kept as /tasks/*.json.bad", (unsigned)bad.size());
+  return true;
+}
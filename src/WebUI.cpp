@@ -7,12 +7,153 @@
  */
 #include "WebUI.h"
 #include <LittleFS.h>
+#include "ScriptCache.h"
+#ifdef WEBUI_EMBED_ASSETS
+#include <WebAssets.h> // generated by scripts/compress_assets.py
+#endif
 
 /**
- * @brief Initializes the web UI by setting up the static file server.
+ * @brief Initializes the web UI by registering the asset handler.
  * @param server A pointer to the AsyncWebServer instance.
  */
 void WebUI::begin(AsyncWebServer *server) {
-  // serve static files from LittleFS root
-  server->serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
+  server->addHandler(this);
+}
+
+/**
+ * @brief Maps a request URL to an asset path.
+ */
+String WebUI::_assetPath(const String &url) {
+  return url.endsWith("/") ? url + "index.html" : url;
+}
+
+/**
+ * @brief Finds the file serving a path.
+ */
+String WebUI::_findFile(const String &path) {
+  if (LittleFS.exists(path)) {
+    // Directories are not assets; only "/" maps to an index page
+    File f = LittleFS.open(path, "r");
+    return f && !f.isDirectory() ? path : String();
+  }
+  String gz = path + ".gz";
+  if (LittleFS.exists(gz)) return gz;
+  return String();
+}
+
+#ifdef WEBUI_EMBED_ASSETS
+/**
+ * @brief Finds an embedded asset.
+ */
+const WebAsset* WebUI::_findEmbedded(const String &path) {
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++) {
+    if (path == WEB_ASSETS[i].path) return &WEB_ASSETS[i];
+  }
+  return nullptr;
+}
+#endif
+
+/**
+ * @brief Decides whether a request is for a UI asset.
+ */
+bool WebUI::canHandle(AsyncWebServerRequest *request) {
+  if (!(request->method() & (HTTP_GET | HTTP_HEAD))) return false;
+  if (request->url().startsWith("/api/")) return false;
+  String path = _assetPath(request->url());
+#ifdef WEBUI_EMBED_ASSETS
+  if (_findEmbedded(path)) return true;
+#endif
+  return _findFile(path).length() > 0;
+}
+
+/**
+ * @brief Gets the content-hash ETag of a file.
+ */
+String WebUI::_fileETag(const String &file) {
+  File f = LittleFS.open(file, "r");
+  if (!f) return String();
+  uint32_t size = f.size();
+  time_t mtime = f.getLastWrite();
+  ETagEntry *entry = nullptr;
+  for (ETagEntry &e : _etags) {
+    if (e.path == file) entry = &e;
+  }
+  // An edit of the same size still changes the modification time
+  if (!entry || entry->size != size || entry->mtime != mtime) {
+    // First request for this version of the file: hash it once
+    uint8_t buf[512];
+    uint32_t hash = 2166136261u;
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0) hash = ScriptCache::hash((const char*)buf, n, hash);
+    if (!entry) {
+      _etags.push_back({ file, size, mtime, hash });
+      entry = &_etags.back();
+    }
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->hash = hash;
+  }
+  f.close();
+  char etag[12];
+  snprintf(etag, sizeof(etag), "\"%08x\"", (unsigned)entry->hash);
+  return String(etag);
+}
+
+/**
+ * @brief Adds ETag and Cache-Control to a response.
+ */
+void WebUI::_cacheHeaders(AsyncWebServerResponse *response, const String &path, const String &etag, bool built) {
+  if (etag.length() > 0) response->addHeader("ETag", etag);
+  // Pages are revalidated so that new asset versions are picked up at once;
+  // scripts, logs and edited files change at run time and are revalidated too
+  if (built && !path.endsWith(".html")) response->addHeader("Cache-Control", "public, max-age=" + String(WEBUI_MAX_AGE));
+  else response->addHeader("Cache-Control", "no-cache");
+}
+
+/**
+ * @brief Answers 304 if the client holds the current version of an asset.
+ */
+bool WebUI::_notModified(AsyncWebServerRequest *request, const String &path, const String &etag, bool built) {
+  if (etag.length() == 0 || !request->hasHeader("If-None-Match")) return false;
+  if (request->header("If-None-Match").indexOf(etag) < 0) return false;
+  AsyncWebServerResponse *response = request->beginResponse(304);
+  _cacheHeaders(response, path, etag, built);
+  request->send(response);
+  return true;
+}
+
+/**
+ * @brief Serves a UI asset.
+ */
+void WebUI::handleRequest(AsyncWebServerRequest *request) {
+  String path = _assetPath(request->url());
+  String file = _findFile(path);
+  if (file.length() > 0) {
+    String etag = _fileETag(file);
+    // Only the ".gz" files come from the build step (scripts/compress_assets.py)
+    bool built = file.endsWith(".gz");
+    if (_notModified(request, path, etag, built)) return;
+    // A ".gz" file is sent as is with Content-Encoding: gzip and the type of the plain name
+    File content = LittleFS.open(file, "r");
+    if (!content) {
+      request->send(500);
+      return;
+    }
+    AsyncWebServerResponse *response = request->beginResponse(content, path, String());
+    _cacheHeaders(response, path, etag, built);
+    request->send(response);
+    return;
+  }
+#ifdef WEBUI_EMBED_ASSETS
+  const WebAsset *asset = _findEmbedded(path);
+  if (asset) {
+    if (_notModified(request, path, asset->etag, true)) return;
+    AsyncWebServerResponse *response = request->beginResponse_P(200, asset->type, asset->data, asset->size);
+    if (asset->gzip) response->addHeader("Content-Encoding", "gzip");
+    _cacheHeaders(response, path, asset->etag, true);
+    request->send(response);
+    return;
+  }
+#endif
+  request->send(404);
 }
@@ -0,0 +1,173 @@
+/**
+ * @file WiFiLink.cpp
+ * @author Masyukov Pavel
+ * @brief Implementation of the WiFiLink class for the WASH-PRO project.
+ * @version 1.0.0
+ * @see https://github.com/pavelmasyukov/WASH-PRO-CORE
+ */
+#include "WiFiLink.h"
+#include "EventHub.h"
+#include "Logger.h"
+
+static const uint8_t REASON_ASSOC_LEAVE = 8; ///< Disconnect caused by WiFi.disconnect() itself.
+
+/**
+ * @brief Starts the access point and the station interface.
+ */
+void WiFiLink::begin(const String &apName) {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  WiFi.persistent(false);       // credentials live in our preferences
+  WiFi.setAutoReconnect(false); // reconnects are paced by poll()
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(apName.c_str());
+  WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) { _onEvent(event, info); });
+}
+
+/**
+ * @brief Records Wi-Fi events for poll().
+ */
+void WiFiLink::_onEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      _gotIp = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      if (info.wifi_sta_disconnected.reason == REASON_ASSOC_LEAVE) break;
+      _reason = info.wifi_sta_disconnected.reason;
+      _lost = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      _lost = true;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Joins a network.
+ */
+void WiFiLink::connect(const String &ssid, const String &pass) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _nextSsid = ssid;
+  _nextPass = pass;
+  xSemaphoreGive(_mutex);
+  _pending = true;
+}
+
+/**
+ * @brief Advances the state machine.
+ */
+void WiFiLink::poll() {
+  uint32_t now = millis();
+  if (_pending.exchange(false)) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _ssid = _nextSsid;
+    _pass = _nextPass;
+    xSemaphoreGive(_mutex);
+    _attempts = 0;
+    _reason = 0;
+    if (_ssid.length() == 0) {
+      WiFi.disconnect();
+      _setState(WIFI_LINK_IDLE, now);
+      return;
+    }
+    _attempt(now);
+    return;
+  }
+
+  switch (_state) {
+    case WIFI_LINK_CONNECTING:
+      if (_gotIp.exchange(false)) {
+        _attempts = 0;
+        _lost = false;
+        Logger::info("wifi", nullptr, "Connected to %s, IP %s", _ssid.c_str(), WiFi.localIP().toString().c_str());
+        _setState(WIFI_LINK_CONNECTED, now);
+      } else if (_lost.exchange(false) || now - _stateMs >= WIFI_CONNECT_TIMEOUT_MS) {
+        _attempts++;
+        _retryLater(now);
+      }
+      break;
+    case WIFI_LINK_CONNECTED:
+      if (_lost.exchange(false)) {
+        Logger::warn("wifi", nullptr, "Connection to %s lost (reason %u)", _ssid.c_str(), (unsigned)_reason.load());
+        _retryLater(now);
+      }
+      break;
+    case WIFI_LINK_BACKOFF:
+      if (now - _stateMs >= _retryMs) _attempt(now);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Starts an attempt with the current credentials.
+ */
+void WiFiLink::_attempt(uint32_t now) {
+  _gotIp = false;
+  _lost = false;
+  WiFi.disconnect();
+  WiFi.begin(_ssid.c_str(), _pass.length() > 0 ? _pass.c_str() : nullptr);
+  _setState(WIFI_LINK_CONNECTING, now);
+}
+
+/**
+ * @brief Drops the attempt or connection and schedules the next attempt.
+ */
+void WiFiLink::_retryLater(uint32_t now) {
+  WiFi.disconnect();
+  uint8_t shift = _attempts > 1 ? (_attempts - 1 < 8 ? _attempts - 1 : 8) : 0;
+  _retryMs = (uint32_t)WIFI_BACKOFF_MIN_MS << shift;
+  if (_retryMs > WIFI_BACKOFF_MAX_MS) _retryMs = WIFI_BACKOFF_MAX_MS;
+  if (_attempts > 0) {
+    Logger::warn("wifi", nullptr, "Attempt %u to join %s failed (reason %u), retry in %lu ms",
+                 _attempts, _ssid.c_str(), (unsigned)_reason.load(), (unsigned long)_retryMs);
+  }
+  _setState(WIFI_LINK_BACKOFF, now);
+}
+
+/**
+ * @brief Gets the name of a state.
+ */
+const char* WiFiLink::_stateName(WiFiLinkState state) {
+  switch (state) {
+    case WIFI_LINK_CONNECTING: return "connecting";
+    case WIFI_LINK_CONNECTED:  return "connected";
+    case WIFI_LINK_BACKOFF:    return "backoff";
+    default:                   return "idle";
+  }
+}
+
+/**
+ * @brief Changes the state and publishes it.
+ */
+void WiFiLink::_setState(WiFiLinkState state, uint32_t now) {
+  _state = state;
+  _stateMs = now;
+  if (!_events) return;
+  char data[96];
+  snprintf(data, sizeof(data), "{\"state\":\"%s\",\"attempts\":%u,\"reason\":%u}",
+           _stateName(state), _attempts, (unsigned)_reason.load());
+  _events->publish("wifi", data);
+}
+
+/**
+ * @brief Fills a JSON object with the connection status.
+ */
+void WiFiLink::getStatusJSON(JsonObject out) {
+  // A network handed over by connect() counts as being joined already
+  WiFiLinkState state = _pending ? WIFI_LINK_CONNECTING : _state;
+  out["state"] = _stateName(state);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  out["ssid"] = _pending ? _nextSsid : _ssid;
+  xSemaphoreGive(_mutex);
+  out["ip"] = state == WIFI_LINK_CONNECTED ? WiFi.localIP().toString() : String();
+  out["rssi"] = state == WIFI_LINK_CONNECTED ? WiFi.RSSI() : 0;
+  out["attempts"] = _attempts;
+  out["reason"] = _reason.load();
+  uint32_t waited = millis() - _stateMs;
+  out["retryInMs"] = state == WIFI_LINK_BACKOFF && waited < _retryMs ? _retryMs - waited : 0;
+  out["apIp"] = WiFi.softAPIP().toString();
+}
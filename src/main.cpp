@@ -14,15 +14,92 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <map>
+#include <esp_system.h>
 #include "SystemManager.h"
 #include "TaskManager.h"
+#include "JsonListStream.h"
+#include "EventHub.h"
+#include "Logger.h"
 #include "WebUI.h"
+#include "AtomicFile.h"
+#include "Metrics.h"
+#include "MemoryGuard.h"
 
 SystemManager sys; ///< Global instance of the SystemManager.
 TaskManager tasks; ///< Global instance of the TaskManager.
 WebUI ui;          ///< Global instance of the WebUI manager.
 
 AsyncWebServer server(80); ///< Global instance of the asynchronous web server.
+EventHub events;           ///< Server-Sent Events channel at /api/events.
+
+/**
+ * @brief Refreshes the task registry after a task or script file was changed via the file API.
+ * Also drops the cached ETags of the web UI, which may have been edited.
+ * @param path The path that was modified.
+ */
+static void syncTaskRegistry(const String &path) {
+  if (path.startsWith("/tasks") || path.startsWith("/scripts")) {
+    tasks.reload();
+  }
+  ui.invalidate();
+}
+
+static uint32_t bootTag = 0; ///< Random per boot, so ETags from before a restart never match.
+
+/**
+ * @brief Builds an ETag from state versions.
+ * @param version The version of the response data.
+ * @param extra A second version the response depends on, 0 for none.
+ */
+static String makeETag(uint32_t version, uint32_t extra = 0) {
+  char tag[40];
+  snprintf(tag, sizeof(tag), "\"%08x-%x-%x\"", (unsigned)bootTag, (unsigned)version, (unsigned)extra);
+  return String(tag);
+}
+
+/**
+ * @brief Answers a conditional GET with 304 Not Modified if the client holds the current version.
+ * @param request The web server request object.
+ * @param etag The ETag of the current version.
+ * @return True if the request was answered.
+ */
+static bool sendNotModified(AsyncWebServerRequest *request, const String &etag) {
+  if (!request->hasHeader("If-None-Match")) return false;
+  const String &match = request->header("If-None-Match");
+  if (match != "*" && match.indexOf(etag) < 0) return false;
+  AsyncWebServerResponse *response = request->beginResponse(304);
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+  return true;
+}
+
+/**
+ * @brief Answers that the request was refused by MemoryGuard.
+ * The client should retry once runs have finished and memory was given back.
+ */
+static void sendLowMemory(AsyncWebServerRequest *request) {
+  AsyncWebServerResponse *response = request->beginResponse(503, "application/json", "{\"error\":\"low memory\"}");
+  response->addHeader("Retry-After", "5");
+  request->send(response);
+}
+
+/**
+ * @brief Registers an API route whose requests are counted in /api/metrics.
+ * @param uri The path (or regex) of the route.
+ * @param method The HTTP method(s) of the route.
+ * @param fn The request handler.
+ * @param label The route label in the metrics; the uri when nullptr.
+ */
+static AsyncCallbackWebHandler& route(const char *uri, WebRequestMethodComposite method,
+                                      ArRequestHandlerFunction fn, const char *label = nullptr) {
+  int id = Metrics::addRoute(method, label ? label : uri);
+  return server.on(uri, method, [id, fn](AsyncWebServerRequest *request) {
+    uint32_t start = micros();
+    fn(request);
+    Metrics::record(id, micros() - start);
+  });
+}
 
 /**
  * @brief Setup function, runs once on startup.
@@ -33,27 +110,39 @@ AsyncWebServer server(80); ///< Global instance of the asynchronous web server.
 void setup() {
   Serial.begin(115200);
   delay(1000);
-  Serial.println("Starting WASH-PRO-CORE...");
+  Logger::info("main", nullptr, "Starting WASH-PRO-CORE...");
+  bootTag = esp_random();
 
   if (!LittleFS.begin()) {
-    Serial.println("LittleFS mount failed");
+    Logger::error("main", nullptr, "LittleFS mount failed");
   } else {
-    Serial.println("LittleFS mounted");
+    Logger::info("main", nullptr, "LittleFS mounted");
   }
+  // Lines logged so far wait in the ring; from here on they reach Serial and /logs
+  Logger::begin();
 
   sys.begin();
+  // A fresh update is tested for a while and may be rolled back
+  sys.ota().checkBoot();
   tasks.begin();
+  sys.setTaskManager(&tasks);
+  // Task transitions and script logs are pushed to /api/events subscribers
+  events.begin(server);
+  tasks.setEventHub(&events);
+  sys.ota().setEventHub(&events);
 
-  // Start as Access Point by default
+  // Always run the Access Point, so the device stays reachable for setup
   String apName = "WASH-PRO-CORE";
   apName += "-";
   uint64_t mac = ESP.getEfuseMac();
   char buf[8];
   sprintf(buf, "%04llX", (mac & 0xFFFF));
   apName += buf;
-  WiFi.softAP(apName.c_str());
+  // The AP stays up; the station joins the saved network in the background
+  sys.beginWiFi(apName);
+  sys.wifi().setEventHub(&events);
   IPAddress ip = WiFi.softAPIP();
-  Serial.printf("AP started: %s @ %s\n", apName.c_str(), ip.toString().c_str());
+  Logger::info("main", nullptr, "AP started: %s @ %s", apName.c_str(), ip.toString().c_str());
 
   // CORS headers for all API responses
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
@@ -61,23 +150,39 @@ void setup() {
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type, Authorization");
 
   // Handle CORS preflight requests
-  server.on("/*", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+  route("/*", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
     request->send(204);
   });
 
   // API endpoint to run a task's script.
-  server.on("/api/tasks/run", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/tasks/run", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("id", true)) {
       String id = request->getParam("id", true)->value();
-      bool ok = tasks.runTask(id);
-      request->send(ok ? 200 : 500, "application/json", ok ? "{\"ok\":true}" : "{\"error\":\"failed to run\"}");
+      uint32_t run = 0;
+      switch (tasks.startRun(id, 0, &run)) {
+        case TaskManager::RUN_OK:
+          request->send(200, "application/json", String("{\"ok\":true,\"run\":") + run + "}");
+          break;
+        case TaskManager::RUN_NOT_FOUND:
+          request->send(404, "application/json", "{\"error\":\"task not found\"}");
+          break;
+        case TaskManager::RUN_ALREADY_ACTIVE:
+          request->send(409, "application/json", "{\"error\":\"task already queued or running\"}");
+          break;
+        case TaskManager::RUN_LOW_MEMORY:
+          sendLowMemory(request);
+          break;
+        default:
+          request->send(503, "application/json", "{\"error\":\"run queue full\"}");
+          break;
+      }
     } else {
       request->send(400, "application/json", "{\"error\":\"missing id\"}");
     }
   });
 
   // API endpoint to stop a task's script.
-  server.on("/api/tasks/stop", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/tasks/stop", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("id", true)) {
       String id = request->getParam("id", true)->value();
       bool ok = tasks.stopTask(id);
@@ -88,7 +193,7 @@ void setup() {
   });
 
   // API endpoint to delete a task.
-  server.on("/api/tasks/delete", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/tasks/delete", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("id", true)) {
       String id = request->getParam("id", true)->value();
       bool ok = tasks.deleteTask(id);
@@ -102,29 +207,43 @@ void setup() {
 
   
   // API endpoint to handle creating, renaming, and saving scripts for tasks.
-  server.on("/api/tasks", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/tasks", HTTP_POST, [](AsyncWebServerRequest *request){
     String id = request->hasParam("id", true) ? request->getParam("id", true)->value() : "";
     String name = request->hasParam("name", true) ? request->getParam("name", true)->value() : "";
     String script = request->hasParam("script", true) ? request->getParam("script", true)->value() : "";
 
+    // An optional Lua memory cap (bytes, 0 = default) can accompany any update
+    if (id.length() > 0 && request->hasParam("memLimit", true)) {
+      uint32_t limit = (uint32_t)request->getParam("memLimit", true)->value().toInt();
+      if (!tasks.setMemoryLimit(id, limit)) {
+        request->send(404, "application/json", "{\"error\":\"not found\"}");
+        return;
+      }
+      if (!request->hasParam("script", true) && name.length() == 0) {
+        request->send(200, "application/json", "{\"ok\":true}");
+        return;
+      }
+    }
+
     // Logic: if 'script' is present, we are saving a script. Otherwise, creating/renaming
     if (request->hasParam("script", true)) { // This is a script save operation
       if (id.length() == 0) {
         request->send(400, "application/json", "{\"error\":\"missing id for script save\"}");
         return;
       }
-      Serial.printf("Saving script for id=%s, name=%s, script_len=%u\n", id.c_str(), name.c_str(), script.length());
+      Logger::debug("api", id.c_str(), "saving script, name=%s, script_len=%u", name.c_str(), script.length());
       bool ok = tasks.saveScript(id, name, script); // name might be empty if only script is updated
+      ui.invalidate(); // /scripts/<id>.lua changed
       request->send(ok ? 200 : 500, "application/json", ok ? "{\"ok\":true}" : "{\"error\":\"failed to save script\"}");
     } else if (name.length() > 0) { // This is a create or rename operation
       if (id.length() > 0) {
         // This is a rename operation
-        Serial.printf("Renaming task id=%s to name=%s\n", id.c_str(), name.c_str());
+        Logger::info("api", id.c_str(), "renaming task to %s", name.c_str());
         bool ok = tasks.saveScript(id, name, ""); // Use saveScript to update name, with empty script content
         request->send(ok ? 200 : 404, "application/json", ok ? "{\"ok\":true}" : "{\"error\":\"not found\"}");
       } else {
         // This is a create operation
-        Serial.printf("Creating task name=%s\n", name.c_str());
+        Logger::info("api", nullptr, "Creating task name=%s", name.c_str());
         String newId = tasks.createTask(name);
         if (newId.length() > 0) {
           request->send(200, "application/json", tasks.getTaskJSON(newId));
@@ -138,32 +257,87 @@ void setup() {
   });
 
 // API endpoint to get the list of all tasks.
-  server.on("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(200, "application/json", tasks.getTasksJSON());
+  route("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request){
+    // The version is taken first: a change while streaming only makes the next poll refetch
+    String etag = makeETag(tasks.stateVersion());
+    if (sendNotModified(request, etag)) return;
+    // Streamed entry by entry, so the size of the registry does not matter
+    std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+    JsonListStream::send(request, std::make_shared<JsonListStream>("tasks",
+      [next](JsonObject obj) { return tasks.getTaskEntryJSON((*next)++, obj); },
+      nullptr,
+      [](JsonObject obj) { tasks.getQueueJSON(obj); }), etag);
   });
 
   // API endpoint to get a single task with its script.
   // This uses a regex to capture the ID from the path, e.g., /api/tasks/12345.json
-  server.on("^\\/api\\/tasks\\/([a-zA-Z0-9_.-]+)$", HTTP_GET, [](AsyncWebServerRequest *request) {
+  route("^\\/api\\/tasks\\/([a-zA-Z0-9_.-]+)$", HTTP_GET, [](AsyncWebServerRequest *request) {
     String id = request->pathArg(0);
     if (!id.isEmpty()) {
-      String json = tasks.getTaskWithScriptJSON(id);
+      bool lowMemory = false;
+      String json = tasks.getTaskWithScriptJSON(id, &lowMemory);
       if (json.length() > 0) {
         request->send(200, "application/json", json);
+      } else if (lowMemory) {
+        sendLowMemory(request);
       } else {
         request->send(404, "application/json", "{\"error\":\"task not found\"}");
       }
     }
+  }, "/api/tasks/{id}");
+
+
+
+
+
+
+  // API endpoint to read the log ring; "since" is the last sequence number the client has.
+  route("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){
+    struct Cursor { uint32_t seq, end, last; };
+    uint32_t since = request->hasParam("since") ? (uint32_t)strtoul(request->getParam("since")->value().c_str(), nullptr, 10) : 0;
+    uint32_t end = Logger::next();
+    if (since >= end) since = 0; // a number from before a restart
+    uint32_t first = since + 1 > Logger::oldest() ? since + 1 : Logger::oldest();
+    std::shared_ptr<Cursor> cur = std::make_shared<Cursor>(Cursor{ first, end, since });
+    JsonListStream::send(request, std::make_shared<JsonListStream>("logs",
+      [cur](JsonObject obj) {
+        LogEntry e;
+        while (cur->seq < cur->end) {
+          uint32_t seq = cur->seq++;
+          if (!Logger::read(seq, e)) continue; // overwritten meanwhile
+          obj["seq"] = e.seq;
+          obj["ms"] = e.ms;
+          obj["level"] = Logger::levelName(e.level);
+          obj["tag"] = e.tag;
+          if (e.task[0]) obj["task"] = e.task;
+          obj["msg"] = e.msg;
+          cur->last = seq;
+          return true;
+        }
+        return false;
+      },
+      nullptr,
+      [cur](JsonObject obj) {
+        obj["last"] = cur->last;
+        obj["dropped"] = Logger::dropped();
+      }));
   });
 
-
-
-
-
-
   // API endpoint to get general system information.
-  server.on("/api/info", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(200, "application/json", sys.getInfoJSON());
+  route("/api/info", HTTP_GET, [](AsyncWebServerRequest *request){
+    String etag = makeETag(sys.infoVersion(), tasks.stateVersion());
+    if (sendNotModified(request, etag)) return;
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/json", sys.getInfoJSON());
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+  });
+
+  // API endpoint with runtime counters in the Prometheus text format, streamed
+  // section by section so scraping every few seconds stays cheap.
+  route("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    MetricsStream::send(request, std::make_shared<MetricsStream>(std::vector<MetricsStream::Section>{
+      sys.metricsSection(), tasks.metricsSection(), MemoryGuard::metricsSection(), Metrics::routesSection() }));
   });
 
   
@@ -171,8 +345,8 @@ void setup() {
 
 
   // API endpoint to provide a list of built-in Lua functions for the script editor.
-  server.on("/api/builtins", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(200, "application/json", "[\"log\",\"setLED\",\"delay\",\"startTask\",\"stopTask\"]");
+  route("/api/builtins", HTTP_GET, [](AsyncWebServerRequest *request){
+    request->send(200, "application/json", "[\"log\",\"setLED\",\"delay\",\"wait\",\"startTask\",\"join\",\"isRunning\",\"stopTask\"]");
   });
 
 
@@ -209,7 +383,7 @@ void setup() {
   };
 
   // API endpoint to list files in a directory.
-  server.on("/api/files", HTTP_GET, [](AsyncWebServerRequest *request){
+  route("/api/files", HTTP_GET, [](AsyncWebServerRequest *request){
     String path = "/";
     if (request->hasParam("path")) {
       path = request->arg("path");
@@ -218,29 +392,25 @@ void setup() {
       path = "/" + path;
     }
 
-    DynamicJsonDocument doc(4096);
-    doc["path"] = path;
-    JsonArray files = doc.createNestedArray("files");
-    File root = LittleFS.open(path);
-    if (root && root.isDirectory()) {
-      File file = root.openNextFile();
-      while (file) {
-        JsonObject fileObj = files.createNestedObject();
+    // The directory stays open while the entries are streamed
+    std::shared_ptr<File> root = std::make_shared<File>(LittleFS.open(path));
+    JsonListStream::send(request, std::make_shared<JsonListStream>("files",
+      [root](JsonObject fileObj) {
+        if (!*root || !root->isDirectory()) return false;
+        File file = root->openNextFile();
+        if (!file) return false;
         String fullPath = String(file.name());
         fileObj["name"] = fullPath.substring(fullPath.lastIndexOf('/') + 1);
         fileObj["size"] = file.size();
         fileObj["isDir"] = file.isDirectory();
         file.close();
-        file = root.openNextFile();
-      }
-      root.close();
-    }
-    String out; serializeJson(doc, out);
-    request->send(200, "application/json", out);
+        return true;
+      },
+      [path](JsonObject obj) { obj["path"] = path; }));
   });
 
   // API endpoint to delete a file or directory.
-  server.on("/api/files/delete", HTTP_POST, [deleteRecursive](AsyncWebServerRequest *request){
+  route("/api/files/delete", HTTP_POST, [deleteRecursive](AsyncWebServerRequest *request){
     if (request->hasParam("path", true)) {
       String path = request->getParam("path", true)->value();
       if (path.startsWith("/") && LittleFS.exists(path)) {
@@ -250,6 +420,7 @@ void setup() {
         f.close();
         if (isDir) deleteRecursive(path);
         else LittleFS.remove(path);
+        syncTaskRegistry(path);
         request->send(200, "application/json", "{\"ok\":true}");
       } else {
         request->send(404, "application/json", "{\"error\":\"failed to remove\"}");
@@ -260,13 +431,14 @@ void setup() {
   });
 
   // API endpoint to rename a file.
-  server.on("/api/files/rename", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/files/rename", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("path", true) && request->hasParam("newName", true)) {
       String path = request->getParam("path", true)->value();
       String newName = request->getParam("newName", true)->value();
       String parentPath = path.substring(0, path.lastIndexOf('/'));
       String newPath = parentPath + "/" + newName;
       if (LittleFS.rename(path, newPath)) {
+        syncTaskRegistry(path);
         request->send(200, "application/json", "{\"ok\":true}");
       } else {
         request->send(500, "application/json", "{\"error\":\"rename failed\"}");
@@ -277,13 +449,14 @@ void setup() {
   });
 
   // API endpoint to save content to a file.
-  server.on("/api/files/save", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/files/save", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("path", true) && request->hasParam("content", true)) {
       String path = request->getParam("path", true)->value();
       String content = request->getParam("content", true)->value();
-      File f = LittleFS.open(path, FILE_WRITE);
-      if (f && f.print(content)) {
-        f.close();
+      // A footer in edited content is stale; the file gets a fresh one
+      bool checksum = AtomicFile::stripFooter(content);
+      if (AtomicFile::write(path, content, checksum)) {
+        syncTaskRegistry(path);
         request->send(200, "application/json", "{\"ok\":true}");
       } else {
         request->send(500, "application/json", "{\"error\":\"write failed\"}");
@@ -294,16 +467,16 @@ void setup() {
   });
 
   // API endpoint to get system settings.
-  server.on("/api/system", HTTP_GET, [](AsyncWebServerRequest *request){
+  route("/api/system", HTTP_GET, [](AsyncWebServerRequest *request){
     request->send(200, "application/json", sys.getSystemJSON());
   });
 
   // API endpoint to set the system language.
-  server.on("/api/setlanguage", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/setlanguage", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("lang", true)) {
       String lang = request->getParam("lang", true)->value();
       sys.setLanguage(lang);
-      Serial.printf("Language set via API: %s\n", lang.c_str());
+      Logger::info("api", nullptr, "Language set via API: %s", lang.c_str());
       request->send(200, "application/json", "{\"ok\":true}");
     } else {
       request->send(400, "application/json", "{\"error\":\"no lang\"}");
@@ -311,11 +484,11 @@ void setup() {
   });
 
   // API endpoint to set the license key.
-  server.on("/api/setlicense", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/setlicense", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("key", true)) {
       String key = request->getParam("key", true)->value();
       sys.setLicenseKey(key);
-      Serial.printf("License key set via API.\n");
+      Logger::info("api", nullptr, "License key set via API.");
       request->send(200, "application/json", "{\"ok\":true}");
     } else {
       request->send(400, "application/json", "{\"error\":\"no key\"}");
@@ -323,16 +496,16 @@ void setup() {
   });
 
   // API endpoint to get the list of available themes.
-  server.on("/api/themes", HTTP_GET, [](AsyncWebServerRequest *request){
+  route("/api/themes", HTTP_GET, [](AsyncWebServerRequest *request){
     request->send(200, "application/json", "[\"gp_dark\",\"gp_light\",\"gp_gray\",\"gp_blue\",\"gp_new\",\"gp_modern\",\"gp_future\"]");
   });
 
   // API endpoint to set the system theme.
-  server.on("/api/settheme", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/settheme", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("theme", true)) {
       String theme = request->getParam("theme", true)->value();
       sys.setTheme(theme);
-      Serial.printf("Theme set via API: %s\n", theme.c_str());
+      Logger::info("api", nullptr, "Theme set via API: %s", theme.c_str());
       request->send(200, "application/json", "{\"ok\":true}");
     } else {
       request->send(400, "application/json", "{\"error\":\"no theme\"}");
@@ -340,7 +513,7 @@ void setup() {
   });
 
   // API endpoint to set the auto-update preference.
-  server.on("/api/autoupdate", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/autoupdate", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("enabled", true)) {
       String enabledStr = request->getParam("enabled", true)->value();
       bool enabled = (enabledStr == "true");
@@ -360,35 +533,73 @@ void setup() {
     }
   });
 
-  // Dummy POST handlers for upload endpoints to satisfy the frontend.
-  server.on("/api/upload/firmware", HTTP_POST, [](AsyncWebServerRequest *request){ request->send(200); });
-  server.on("/api/upload/fs", HTTP_POST, [](AsyncWebServerRequest *request){ request->send(200); });
+  // Answers a firmware upload once the body is in. The reboot into a verified
+  // image is delayed so the response still reaches the client.
+  route("/api/upload/firmware", HTTP_POST, [](AsyncWebServerRequest *request){
+    OtaUpdater &ota = sys.ota();
+    if (!sys.isOTARequest(request)) {
+      if (ota.state() == OTA_RECEIVING) request->send(409, "application/json", "{\"error\":\"another update is running\"}");
+      else request->send(400, "application/json", "{\"error\":\"no firmware file\"}");
+      return;
+    }
+    DynamicJsonDocument doc(512);
+    ota.getStatusJSON(doc.to<JsonObject>());
+    String out;
+    serializeJson(doc, out);
+    if (ota.state() == OTA_READY) {
+      request->send(200, "application/json", out);
+      sys.scheduleReboot(1, true);
+    } else {
+      request->send(ota.state() == OTA_FAILED ? 400 : 500, "application/json", out);
+    }
+  });
+
+  // API endpoint with the progress of a firmware update and the state of the running image.
+  route("/api/ota", HTTP_GET, [](AsyncWebServerRequest *request){
+    DynamicJsonDocument doc(512);
+    sys.ota().getStatusJSON(doc.to<JsonObject>());
+    String out;
+    serializeJson(doc, out);
+    request->send(200, "application/json", out);
+  });
+
+  // Answers a filesystem upload once the body is in.
+  route("/api/upload/fs", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (request->hasParam("path")) syncTaskRegistry(request->getParam("path")->value());
+    if (sys.fsUploadFailed(request)) {
+      request->send(500, "application/json", "{\"error\":\"upload failed\"}");
+      return;
+    }
+    request->send(200);
+  });
 
-  // API endpoint to configure and connect to a Wi-Fi network.
-  server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request){
+  // API endpoint to configure and connect to a Wi-Fi network. Joining takes
+  // seconds, so it only hands the credentials over and points to the status.
+  route("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request){
     if (request->hasParam("ssid", true) && request->hasParam("pass", true)) {
       String ssid = request->getParam("ssid", true)->value();
       String pass = request->getParam("pass", true)->value();
-      sys.saveWiFiCredentials(ssid, pass);
-      // try connect
-      WiFi.begin(ssid.c_str(), pass.c_str()); 
-      uint8_t tries = 0;
-      while (WiFi.status() != WL_CONNECTED && tries < 30) {
-        delay(200); 
-        tries++;
-      }
-      if (WiFi.status() == WL_CONNECTED) {
-        request->send(200, "application/json", "{\"ok\":true}");
-      } else {
-        request->send(500, "application/json", "{\"error\":\"connection failed\"}");
-      }
+      sys.connectWiFi(ssid, pass);
+      AsyncWebServerResponse *response = request->beginResponse(202, "application/json",
+        "{\"ok\":true,\"status\":\"/api/wifi/status\"}");
+      response->addHeader("Location", "/api/wifi/status");
+      request->send(response);
     } else {
       request->send(400, "application/json", "{\"error\":\"missing params\"}");
     }
   });
 
+  // API endpoint with the state of the station connection.
+  route("/api/wifi/status", HTTP_GET, [](AsyncWebServerRequest *request){
+    DynamicJsonDocument doc(384);
+    sys.wifi().getStatusJSON(doc.to<JsonObject>());
+    String out;
+    serializeJson(doc, out);
+    request->send(200, "application/json", out);
+  });
+
   // API endpoint to schedule a system reboot.
-  server.on("/api/reboot", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/reboot", HTTP_POST, [](AsyncWebServerRequest *request){
     String type = "hard";
     uint32_t delaySec = 0;
     if (request->hasParam("type", true)) type = request->getParam("type", true)->value();
@@ -407,8 +618,13 @@ void setup() {
 /**
  * @brief Main loop function.
  *
- * This function is empty as all operations (web server, tasks) are handled asynchronously.
+ * The web server and the tasks run in the background; the loop only forwards
+ * queued events to the /api/events subscribers, advances the Wi-Fi connection
+ * and runs the self-test of a freshly updated image.
  */
 void loop() {
-  // nothing to do; server and tasks run in background
+  events.pump();
+  sys.wifi().poll();
+  sys.ota().poll();
+  delay(EVENT_PUMP_MS);
 }
@@ -0,0 +1,312 @@
+"""
+Нагрузочный тест HTTP API.
+
+Имитирует одновременную работу нескольких клиентов:
+  * UI-клиенты (киоски, телефоны) опрашивают /api/info и /api/tasks каждые
+    5 секунд, как это делает data/app.js, с If-None-Match от прошлого ответа;
+  * пачки запусков и остановок задач (/api/tasks/run, /api/tasks/stop);
+  * сохранение файлов через /api/files/save.
+
+Для каждого вида запросов выводятся число запросов, доля ошибок, задержки
+p50/p99/p999 и гистограмма. Ошибкой считается таймаут, обрыв соединения или
+ответ с кодом 400 и выше.
+
+Работает как с устройством, так и с хостовой сборкой прошивки
+([env:native-server] в platformio.ini):
+
+    python test/load_test.py --clients 8 --duration 60
+    python test/load_test.py --url http://127.0.0.1:8080 --ramp 1,2,4,8,16,32
+
+В режиме --ramp число UI-клиентов растёт по шагам, пока доля ошибок или p99
+не выйдут за пределы (--max-errors, --max-p99); итог - наибольшее число
+клиентов, которое контроллер выдержал.
+"""
+import argparse
+import json
+import random
+import sys
+import threading
+import time
+
+import requests
+
+from test_utils import BASE_URL, random_string
+
+POLL_INTERVAL = 5.0  # период опроса в data/app.js, секунды
+BUCKETS_MS = [1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000]
+BURST_SCRIPT = "for i = 1, 100 do delay(50) end\n"
+
+
+class Recorder:
+    """Собирает задержки и ошибки запросов по видам, потокобезопасно."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.samples = {}
+        self.errors = {}
+
+    def record(self, label, seconds, error=None):
+        with self.lock:
+            self.samples.setdefault(label, []).append(seconds * 1000.0)
+            if error:
+                kinds = self.errors.setdefault(label, {})
+                kinds[error] = kinds.get(error, 0) + 1
+
+    def summary(self):
+        """Сводка по каждому виду запросов и по всем вместе."""
+        with self.lock:
+            labels = {k: list(v) for k, v in self.samples.items()}
+            errors = {k: dict(v) for k, v in self.errors.items()}
+        result = {}
+        everything = []
+        for label in sorted(labels):
+            everything += labels[label]
+            result[label] = describe(labels[label], errors.get(label, {}))
+        result["all"] = describe(everything, merge_errors(errors.values()))
+        return result
+
+
+def merge_errors(groups):
+    """Складывает счётчики ошибок нескольких видов запросов."""
+    total = {}
+    for group in groups:
+        for kind, n in group.items():
+            total[kind] = total.get(kind, 0) + n
+    return total
+
+
+def percentile(ordered, p):
+    """Процентиль по рангу из отсортированного списка."""
+    if not ordered:
+        return 0.0
+    rank = max(0, min(len(ordered) - 1, int(round(p / 100.0 * len(ordered) + 0.5)) - 1))
+    return ordered[rank]
+
+
+def describe(latencies, errors):
+    """Считает процентили, долю ошибок и гистограмму для списка задержек (мс)."""
+    ordered = sorted(latencies)
+    failed = sum(errors.values())
+    histogram = [0] * (len(BUCKETS_MS) + 1)
+    for ms in ordered:
+        i = 0
+        while i < len(BUCKETS_MS) and ms > BUCKETS_MS[i]:
+            i += 1
+        histogram[i] += 1
+    return {
+        "requests": len(ordered),
+        "errors": failed,
+        "error_rate": failed / len(ordered) if ordered else 0.0,
+        "error_kinds": errors,
+        "p50_ms": percentile(ordered, 50),
+        "p99_ms": percentile(ordered, 99),
+        "p999_ms": percentile(ordered, 99.9),
+        "max_ms": ordered[-1] if ordered else 0.0,
+        "histogram": histogram,
+    }
+
+
+def timed(recorder, session, label, method, url, timeout, **kwargs):
+    """Выполняет запрос и записывает его задержку и исход."""
+    start = time.perf_counter()
+    try:
+        r = session.request(method, url, timeout=timeout, **kwargs)
+        recorder.record(label, time.perf_counter() - start, None if r.status_code < 400 else f"http {r.status_code}")
+        return r
+    except requests.exceptions.Timeout:
+        recorder.record(label, time.perf_counter() - start, "timeout")
+    except requests.exceptions.RequestException:
+        recorder.record(label, time.perf_counter() - start, "connection")
+    return None
+
+
+def periodic(stop, interval, action):
+    """Вызывает action с заданным периодом и случайной начальной фазой до сигнала stop."""
+    if stop.wait(random.uniform(0, interval)):
+        return
+    while not stop.is_set():
+        started = time.monotonic()
+        action()
+        stop.wait(max(0.0, interval - (time.monotonic() - started)))
+
+
+def ui_poller(stop, recorder, args, path):
+    """Один опрос страницы: запрос path каждые 5 секунд, с ETag прошлого ответа, как у браузера."""
+    session = requests.Session()
+    etag = {"value": None}
+
+    def poll():
+        headers = {"If-None-Match": etag["value"]} if etag["value"] else {}
+        r = timed(recorder, session, "GET " + path, "GET", args.url + path, args.timeout, headers=headers)
+        if r is not None and r.headers.get("ETag"):
+            etag["value"] = r.headers["ETag"]
+
+    periodic(stop, POLL_INTERVAL, poll)
+
+
+def burst_client(stop, recorder, args, task_ids):
+    """Пачки запусков и остановок задач."""
+    session = requests.Session()
+
+    def burst():
+        for task_id in task_ids:
+            timed(recorder, session, "POST /api/tasks/run", "POST", args.url + "/api/tasks/run", args.timeout,
+                  data={"id": task_id})
+        stop.wait(0.5)
+        for task_id in task_ids:
+            timed(recorder, session, "POST /api/tasks/stop", "POST", args.url + "/api/tasks/stop", args.timeout,
+                  data={"id": task_id})
+
+    periodic(stop, args.burst_interval, burst)
+
+
+def save_client(stop, recorder, args, index):
+    """Сохранение файла заданного размера."""
+    session = requests.Session()
+    path = f"/loadtest/file_{index}.txt"
+
+    def save():
+        content = random_string(args.save_size)
+        timed(recorder, session, "POST /api/files/save", "POST", args.url + "/api/files/save", args.timeout,
+              data={"path": path, "content": content})
+
+    periodic(stop, args.save_interval, save)
+
+
+def create_burst_tasks(args):
+    """Создаёт задачи для пачек запусков; возвращает их ID."""
+    ids = []
+    for i in range(args.burst_tasks):
+        r = requests.post(f"{args.url}/api/tasks", data={"name": f"load_{random_string()}"}, timeout=10)
+        r.raise_for_status()
+        task_id = r.json()["id"]
+        requests.post(f"{args.url}/api/tasks", data={"id": task_id, "script": BURST_SCRIPT}, timeout=10).raise_for_status()
+        ids.append(task_id)
+    return ids
+
+
+def cleanup(args, task_ids):
+    """Удаляет созданные задачи и файлы."""
+    for task_id in task_ids:
+        try:
+            requests.post(f"{args.url}/api/tasks/stop", data={"id": task_id}, timeout=10)
+            requests.post(f"{args.url}/api/tasks/delete", data={"id": task_id}, timeout=10)
+        except requests.exceptions.RequestException:
+            pass
+    try:
+        requests.post(f"{args.url}/api/files/delete", data={"path": "/loadtest"}, timeout=10)
+    except requests.exceptions.RequestException:
+        pass
+
+
+def run_load(args, clients, task_ids):
+    """Прогоняет смесь запросов заданное время; возвращает сводку."""
+    recorder = Recorder()
+    stop = threading.Event()
+    threads = []
+    for _ in range(clients):
+        for path in ("/api/info", "/api/tasks"):
+            threads.append(threading.Thread(target=ui_poller, args=(stop, recorder, args, path)))
+    for _ in range(args.burst_clients if task_ids else 0):
+        threads.append(threading.Thread(target=burst_client, args=(stop, recorder, args, task_ids)))
+    for i in range(args.save_clients):
+        threads.append(threading.Thread(target=save_client, args=(stop, recorder, args, i)))
+    for t in threads:
+        t.daemon = True
+        t.start()
+    try:
+        time.sleep(args.duration)
+    finally:
+        stop.set()
+        for t in threads:
+            t.join(args.timeout + 1)
+    return recorder.summary()
+
+
+def print_summary(clients, summary, show_histogram):
+    """Выводит таблицу задержек и ошибок."""
+    print(f"\n--- {clients} UI clients ---")
+    print(f"{'request':26} {'count':>6} {'errors':>7} {'p50 ms':>8} {'p99 ms':>8} {'p999 ms':>8} {'max ms':>8}")
+    for label, s in summary.items():
+        print(f"{label:26} {s['requests']:6d} {s['error_rate'] * 100:6.1f}% {s['p50_ms']:8.1f} {s['p99_ms']:8.1f} "
+              f"{s['p999_ms']:8.1f} {s['max_ms']:8.1f}")
+        if s["error_kinds"]:
+            print(" " * 27 + ", ".join(f"{k}: {n}" for k, n in sorted(s["error_kinds"].items())))
+    if show_histogram:
+        hist = summary["all"]["histogram"]
+        top = max(hist) or 1
+        bounds = [f"<= {b} ms" for b in BUCKETS_MS] + [f"> {BUCKETS_MS[-1]} ms"]
+        print("\nlatency histogram (all requests):")
+        for bound, n in zip(bounds, hist):
+            print(f"{bound:>12} {n:7d} {'#' * int(40 * n / top)}")
+
+
+def passed(summary, args):
+    """Проверяет, что доля ошибок и p99 в пределах."""
+    total = summary["all"]
+    return total["error_rate"] <= args.max_errors / 100.0 and total["p99_ms"] <= args.max_p99
+
+
+def main():
+    """Главная функция нагрузочного теста."""
+    parser = argparse.ArgumentParser(description="Load test of the WASH-PRO HTTP API")
+    parser.add_argument("--url", default=BASE_URL, help=f"device or host build URL (default {BASE_URL})")
+    parser.add_argument("--clients", type=int, default=4, help="simulated UI clients")
+    parser.add_argument("--ramp", help="comma-separated UI client counts to step through, e.g. 1,2,4,8")
+    parser.add_argument("--duration", type=float, default=30.0, help="seconds per run or ramp step")
+    parser.add_argument("--timeout", type=float, default=POLL_INTERVAL, help="request timeout in seconds")
+    parser.add_argument("--burst-clients", type=int, default=1, help="clients starting and stopping tasks")
+    parser.add_argument("--burst-tasks", type=int, default=3, help="tasks per burst")
+    parser.add_argument("--burst-interval", type=float, default=10.0, help="seconds between bursts")
+    parser.add_argument("--save-clients", type=int, default=1, help="clients saving files")
+    parser.add_argument("--save-size", type=int, default=2048, help="size of a saved file in bytes")
+    parser.add_argument("--save-interval", type=float, default=5.0, help="seconds between saves")
+    parser.add_argument("--max-errors", type=float, default=1.0, help="allowed error rate in percent")
+    parser.add_argument("--max-p99", type=float, default=None, help="allowed p99 in ms (default: the timeout)")
+    parser.add_argument("--histogram", action="store_true", help="print the latency histogram")
+    parser.add_argument("--json", help="write the results to this file")
+    args = parser.parse_args()
+    args.url = args.url.rstrip("/")
+    if args.max_p99 is None:
+        args.max_p99 = args.timeout * 1000.0
+
+    print("--- Starting HTTP Load Test ---")
+    print(f"Target: {args.url}")
+    try:
+        requests.get(f"{args.url}/api/info", timeout=5).raise_for_status()
+    except requests.exceptions.RequestException as e:
+        print(f"[FATAL] Could not reach {args.url}: {e}")
+        sys.exit(1)
+
+    task_ids = []
+    results = []
+    ok = True
+    try:
+        if args.burst_clients > 0 and args.burst_tasks > 0:
+            task_ids = create_burst_tasks(args)
+        steps = [int(n) for n in args.ramp.split(",")] if args.ramp else [args.clients]
+        capacity = 0
+        for clients in steps:
+            summary = run_load(args, clients, task_ids)
+            results.append({"clients": clients, "summary": summary})
+            print_summary(clients, summary, args.histogram)
+            ok = passed(summary, args)
+            if not ok:
+                print(f"[FAIL] {clients} clients: error rate or p99 over the limit")
+                break
+            capacity = clients
+        if args.ramp:
+            print(f"\nLargest load within limits: {capacity} UI clients")
+    finally:
+        cleanup(args, task_ids)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"url": args.url, "duration": args.duration, "timeout": args.timeout, "steps": results}, f, indent=2)
+    # В режиме ступеней выход за пределы - ожидаемый результат, а не ошибка
+    if not ok and not args.ramp:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
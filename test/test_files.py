@@ -1,3 +1,4 @@
+import os
 import requests
 from .test_utils import BASE_URL, print_test_result, random_string
 
@@ -5,6 +6,9 @@ def run_file_tests():
     """Запускает все тесты файлового менеджера."""
     print("\n--- File Management Tests ---")
     test_file_management()
+    test_edited_file_cache()
+    test_large_listing()
+    test_upload_large_file()
 
 def test_file_management():
     """Тестирует создание, переименование и удаление файлов."""
@@ -64,4 +68,66 @@ def test_file_management():
         r.raise_for_status()
         print_test_result(test_name, True)
     except requests.exceptions.RequestException as e:
-        print_test_result(test_name, False, f"Request failed: {e} | Response: {r.text}")
\ No newline at end of file
+        print_test_result(test_name, False, f"Request failed: {e} | Response: {r.text}")
+
+def test_edited_file_cache():
+    """Проверяет, что изменённый файл того же размера не отдаётся из кэша."""
+    test_name = "Edited File Revalidated"
+    file_path = f"/test_cache_{random_string()}.txt"
+    try:
+        requests.post(f"{BASE_URL}/api/files/save", data={"path": file_path, "content": "version 1"}).raise_for_status()
+        r = requests.get(f"{BASE_URL}{file_path}")
+        r.raise_for_status()
+        assert "no-cache" in r.headers.get("Cache-Control", ""), "edited file may be cached without revalidation"
+        etag = r.headers.get("ETag")
+        assert etag, "no ETag header"
+        requests.post(f"{BASE_URL}/api/files/save", data={"path": file_path, "content": "version 2"}).raise_for_status()
+        r2 = requests.get(f"{BASE_URL}{file_path}", headers={"If-None-Match": etag})
+        print_test_result(test_name, r2.status_code == 200 and r2.text == "version 2", f"Status: {r2.status_code}")
+    except (requests.exceptions.RequestException, AssertionError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        requests.post(f"{BASE_URL}/api/files/delete", data={"path": file_path})
+
+def test_large_listing():
+    """Проверяет, что длинный список файлов отдаётся целиком и остаётся валидным JSON."""
+    prefix = f"l{random_string(6)}"
+    names = [f"{prefix}_{i:02d}.txt" for i in range(80)]
+
+    test_name = "List Many Files"
+    try:
+        for name in names:
+            requests.post(f"{BASE_URL}/api/files/save", data={"path": f"/{name}", "content": "x"}).raise_for_status()
+        r = requests.get(f"{BASE_URL}/api/files?path=/")
+        r.raise_for_status()
+        listed = {f["name"] for f in r.json().get("files", [])}
+        missing = [n for n in names if n not in listed]
+        print_test_result(test_name, not missing, f"{len(missing)} of {len(names)} files missing from the list")
+    except (requests.exceptions.RequestException, ValueError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        for name in names:
+            requests.post(f"{BASE_URL}/api/files/delete", data={"path": f"/{name}"})
+
+def test_upload_large_file():
+    """Загружает файл размером с ресурсы интерфейса и сверяет содержимое."""
+    name = f"upload_{random_string()}.bin"
+    content = os.urandom(120 * 1024)
+
+    test_name = "Upload 120 KB File"
+    try:
+        r = requests.post(f"{BASE_URL}/api/upload/fs", params={"path": "/"},
+                          files={"fs": (name, content)})
+        r.raise_for_status()
+        listing = requests.get(f"{BASE_URL}/api/files?path=/").json().get("files", [])
+        sizes = {f["name"]: f["size"] for f in listing}
+        assert sizes.get(name) == len(content), f"size {sizes.get(name)}"
+        assert f"{name}.tmp" not in sizes, "temp file left behind"
+        r2 = requests.get(f"{BASE_URL}/{name}")
+        r2.raise_for_status()
+        assert r2.content == content, "content differs"
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        requests.post(f"{BASE_URL}/api/files/delete", data={"path": f"/{name}"})
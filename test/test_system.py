@@ -5,6 +5,12 @@ def run_system_tests():
     """Запускает все системные тесты."""
     print("\n--- System API Tests ---")
     test_api_info()
+    test_conditional_get()
+    test_static_assets()
+    test_api_logs()
+    test_ota_rejects_bad_digest()
+    test_wifi_status()
+    test_metrics()
     test_api_system()
     test_settings_change()
 
@@ -24,6 +30,112 @@ def test_api_info():
              message += f" | Status: {r.status_code}, Response: {r.text}"
         print_test_result(test_name, False, message)
 
+def test_conditional_get():
+    """Проверяет ETag и ответ 304 для опрашиваемых эндпоинтов."""
+    for path in ("/api/tasks", "/api/info"):
+        test_name = f"Conditional GET {path}"
+        try:
+            r = requests.get(f"{BASE_URL}{path}")
+            r.raise_for_status()
+            etag = r.headers.get("ETag")
+            assert etag, "no ETag header"
+            r2 = requests.get(f"{BASE_URL}{path}", headers={"If-None-Match": etag})
+            # /api/info may legitimately change in between (e.g. free heap)
+            ok = r2.status_code == 304 and not r2.content
+            if path == "/api/info" and r2.status_code == 200:
+                ok = r2.headers.get("ETag") != etag
+            print_test_result(test_name, ok, f"Status: {r2.status_code}")
+        except (requests.exceptions.RequestException, AssertionError) as e:
+            print_test_result(test_name, False, f"Request failed: {e}")
+
+def test_static_assets():
+    """Проверяет заголовки кэширования и ответ 304 для файлов интерфейса."""
+    for path, cache in (("/", "no-cache"), ("/app.js", "max-age")):
+        test_name = f"Static asset {path}"
+        try:
+            r = requests.get(f"{BASE_URL}{path}", headers={"Accept-Encoding": "gzip"})
+            r.raise_for_status()
+            etag = r.headers.get("ETag")
+            assert etag, "no ETag header"
+            assert cache in r.headers.get("Cache-Control", ""), "unexpected Cache-Control"
+            r2 = requests.get(f"{BASE_URL}{path}", headers={"If-None-Match": etag})
+            print_test_result(test_name, r2.status_code == 304 and not r2.content, f"Status: {r2.status_code}")
+        except (requests.exceptions.RequestException, AssertionError) as e:
+            print_test_result(test_name, False, f"Request failed: {e}")
+
+def test_api_logs():
+    """Проверяет чтение журнала через /api/logs?since=."""
+    test_name = "GET /api/logs"
+    try:
+        r = requests.get(f"{BASE_URL}/api/logs")
+        r.raise_for_status()
+        data = r.json()
+        assert isinstance(data.get("logs"), list)
+        last = data["last"]
+        seqs = [entry["seq"] for entry in data["logs"]]
+        assert seqs == sorted(seqs) and all(s <= last for s in seqs)
+        # Только записи новее "since"
+        r2 = requests.get(f"{BASE_URL}/api/logs", params={"since": last})
+        r2.raise_for_status()
+        assert all(entry["seq"] > last for entry in r2.json()["logs"])
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+
+def test_ota_rejects_bad_digest():
+    """Проверяет, что прошивка с неверным SHA-256 отклоняется без перезагрузки."""
+    test_name = "OTA with wrong SHA-256"
+    try:
+        image = b"\xe9" + bytes(4095)  # правильный magic byte, остальное — мусор
+        r = requests.post(f"{BASE_URL}/api/upload/firmware",
+                          data={"size": str(len(image)), "sha256": "0" * 64},
+                          files={"firmware": ("bad.bin", image)})
+        assert r.status_code == 400, f"status {r.status_code}"
+        assert r.json().get("error") == "sha256 mismatch", r.text
+        status = requests.get(f"{BASE_URL}/api/ota").json()
+        assert status["state"] == "failed" and status["bytes"] == len(image)
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+
+def test_wifi_status():
+    """Проверяет, что состояние подключения к Wi-Fi отдаётся без ожидания."""
+    test_name = "GET /api/wifi/status"
+    try:
+        r = requests.get(f"{BASE_URL}/api/wifi/status", timeout=2)
+        assert r.status_code == 200, f"status {r.status_code}"
+        data = r.json()
+        assert data["state"] in ("idle", "connecting", "connected", "backoff"), data
+        assert data["apIp"], "access point is down"
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+
+def test_metrics():
+    """Проверяет счётчики /api/metrics в текстовом формате Prometheus."""
+    test_name = "GET /api/metrics"
+    try:
+        requests.get(f"{BASE_URL}/api/info").raise_for_status()
+        r = requests.get(f"{BASE_URL}/api/metrics")
+        r.raise_for_status()
+        assert r.headers.get("Content-Type", "").startswith("text/plain"), r.headers.get("Content-Type")
+        samples = {}
+        for line in r.text.splitlines():
+            if line and not line.startswith("#"):
+                name, value = line.rsplit(" ", 1)
+                samples[name] = float(value)
+        for name in ("wash_heap_free_bytes", "wash_heap_min_free_bytes",
+                     "wash_heap_largest_free_block_bytes", "wash_fs_used_bytes", "wash_tasks",
+                     "wash_mem_low"):
+            assert name in samples, f"no {name}"
+        assert samples["wash_heap_min_free_bytes"] <= samples["wash_heap_free_bytes"]
+        # Запрос к /api/info выше уже посчитан
+        info = 'wash_http_request_duration_seconds_count{method="GET",route="/api/info"}'
+        assert samples.get(info, 0) >= 1, f"no {info}"
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+
 def test_settings_change():
     """Тестирует изменение настроек, например, языка."""
     test_name = "POST /api/setlanguage"
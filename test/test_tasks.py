@@ -1,3 +1,5 @@
+import re
+import zlib
 import requests
 import time
 from .test_utils import BASE_URL, print_test_result, random_string
@@ -6,6 +8,10 @@ def run_task_tests():
     """Запускает все тесты жизненного цикла задач."""
     print("\n--- Task Lifecycle Tests ---")
     test_task_lifecycle()
+    test_task_events()
+    test_script_checksum()
+    test_onstop_budget()
+    test_rename_during_flush()
 
 def test_task_lifecycle():
     """Полный цикл тестирования задач: создание, переименование, запуск, остановка, удаление."""
@@ -65,24 +71,133 @@ def test_task_lifecycle():
         print_test_result(test_name, False, f"Request failed: {e} | Response: {r.text}")
 
     # 6. Удаление задачи
-    # В app.js удаление происходит через /api/files/delete. Это более правильный подход,
-    # так как задача - это просто файл. Будем следовать этой логике.
+    # Метаданные задач хранятся в упакованной базе /tasks.db, поэтому задача
+    # удаляется через /api/tasks/delete (удаляет и запись, и файл скрипта).
     test_name = "Delete Task"
     try:
-        task_file_path = f"/tasks/{task_id}.json"
-        script_file_path = f"/scripts/{task_id}.lua"
+        r = requests.post(f"{BASE_URL}/api/tasks/delete", data={"id": task_id})
+        r.raise_for_status()
 
-        # Удаляем файл задачи
-        r_task = requests.post(f"{BASE_URL}/api/files/delete", data={"path": task_file_path})
-        r_task.raise_for_status()
+        # Задача не должна больше появляться в списке
+        r_list = requests.get(f"{BASE_URL}/api/tasks")
+        r_list.raise_for_status()
+        ids = [str(t.get("id")) for t in r_list.json().get("tasks", [])]
+        print_test_result(test_name, str(task_id) not in ids, "Deleted task still in list")
+    except requests.exceptions.RequestException as e:
+        response_text = e.response.text if e.response else "No response"
+        print_test_result(test_name, False, f"Request failed: {e} | Response: {response_text}")
 
-        # Удаляем файл скрипта
-        r_script = requests.post(f"{BASE_URL}/api/files/delete", data={"path": script_file_path})
-        # Скрипт мог и не быть создан, поэтому 404 - это нормально. Проверяем на 200 или 404.
-        if r_script.status_code not in [200, 404]:
-            r_script.raise_for_status()
+def test_task_events():
+    """Проверяет, что /api/events присылает переходы задачи и строки log()."""
+    test_name = "Task Events Stream"
+    marker = f"evt_{random_string()}"
+    task_id = None
+    try:
+        r = requests.post(f"{BASE_URL}/api/tasks", data={"name": f"test_events_{random_string()}"})
+        r.raise_for_status()
+        task_id = r.json().get("id")
+        requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "script": f'log("{marker}")'}).raise_for_status()
 
-        print_test_result(test_name, True)
+        seen_state, seen_log = False, False
+        with requests.get(f"{BASE_URL}/api/events", stream=True, timeout=5) as stream:
+            requests.post(f"{BASE_URL}/api/tasks/run", data={"id": task_id}).raise_for_status()
+            deadline = time.time() + 5
+            for line in stream.iter_lines(decode_unicode=True):
+                if line and line.startswith("data:"):
+                    seen_state |= f'"id":"{task_id}"' in line and '"state"' in line
+                    seen_log |= marker in line
+                if (seen_state and seen_log) or time.time() > deadline:
+                    break
+        print_test_result(test_name, seen_state and seen_log, f"state event: {seen_state}, log event: {seen_log}")
     except requests.exceptions.RequestException as e:
-        response_text = e.response.text if e.response else "No response"
-        print_test_result(test_name, False, f"Request failed: {e} | Response: {response_text}")
\ No newline at end of file
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        if task_id:
+            requests.post(f"{BASE_URL}/api/tasks/delete", data={"id": task_id})
+
+def test_script_checksum():
+    """Проверяет, что скрипт сохраняется с контрольной суммой, а API отдаёт его без неё."""
+    test_name = "Script Checksum Footer"
+    task_id = None
+    script = 'log("checksum")\n'
+    try:
+        r = requests.post(f"{BASE_URL}/api/tasks", data={"name": f"test_crc_{random_string()}"})
+        r.raise_for_status()
+        task_id = r.json()["id"]
+        requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "script": script}).raise_for_status()
+        raw = requests.get(f"{BASE_URL}/scripts/{task_id}.lua").content
+        m = re.fullmatch(rb"(.*)\n--crc32:([0-9a-f]{8})\n", raw, re.S)
+        assert m, "no footer in the script file"
+        assert int(m.group(2), 16) == zlib.crc32(m.group(1)), "footer does not match"
+        r2 = requests.get(f"{BASE_URL}/api/tasks/{task_id}.json")
+        r2.raise_for_status()
+        assert r2.json().get("script") == script, "footer leaked into the script"
+        # Text saved back with its footer still gets exactly one
+        requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "script": raw.decode()}).raise_for_status()
+        raw2 = requests.get(f"{BASE_URL}/scripts/{task_id}.lua", headers={"Cache-Control": "no-cache"}).content
+        assert raw2 == raw, "checksum line was added twice"
+        print_test_result(test_name, True)
+    except (requests.exceptions.RequestException, AssertionError, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        if task_id:
+            requests.post(f"{BASE_URL}/api/tasks/delete", data={"id": task_id})
+
+def test_onstop_budget():
+    """Проверяет, что delay() в onStop не продлевает его дольше 500 мс."""
+    test_name = "onStop Budget"
+    task_id = None
+    script = "function onStop() delay(60000) log('onStop slept') end\nwhile true do delay(100) end\n"
+    try:
+        r = requests.post(f"{BASE_URL}/api/tasks", data={"name": f"test_onstop_{random_string()}"})
+        r.raise_for_status()
+        task_id = r.json()["id"]
+        requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "script": script}).raise_for_status()
+        since = requests.get(f"{BASE_URL}/api/logs").json()["last"]
+        requests.post(f"{BASE_URL}/api/tasks/run", data={"id": task_id}).raise_for_status()
+        time.sleep(0.5)
+        requests.post(f"{BASE_URL}/api/tasks/stop", data={"id": task_id}).raise_for_status()
+        time.sleep(2)
+        msgs = [e["msg"] for e in requests.get(f"{BASE_URL}/api/logs", params={"since": since}).json()["logs"]
+                if e.get("task") == task_id]
+        cut = any("onStop exceeded" in m for m in msgs)
+        print_test_result(test_name, cut and "onStop slept" not in msgs, f"log: {msgs}")
+    except (requests.exceptions.RequestException, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        if task_id:
+            requests.post(f"{BASE_URL}/api/tasks/delete", data={"id": task_id})
+
+def test_rename_during_flush():
+    """Переименовывает задачу, пока фоновая запись сохраняет состояния запусков,
+    и проверяет, что в /tasks.db осталось последнее имя."""
+    test_name = "Rename During Flush"
+    task_id = None
+    probe = f"/scripts/reload_{random_string()}.txt"
+    try:
+        r = requests.post(f"{BASE_URL}/api/tasks", data={"name": f"test_flush_{random_string()}"})
+        r.raise_for_status()
+        task_id = r.json()["id"]
+        requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "script": "delay(20)"}).raise_for_status()
+        # Запуски меняют состояние задачи, и запись каждые 2 с сохраняет её
+        # копию; переименования идут вперемешку с ними
+        name = None
+        deadline = time.time() + 6
+        while time.time() < deadline:
+            requests.post(f"{BASE_URL}/api/tasks/run", data={"id": task_id})
+            name = f"test_flush_{random_string()}"
+            requests.post(f"{BASE_URL}/api/tasks", data={"id": task_id, "name": name}).raise_for_status()
+            requests.post(f"{BASE_URL}/api/tasks/stop", data={"id": task_id})
+        time.sleep(3)  # дожидаемся последней записи
+        # Запись файла в /scripts перечитывает реестр из /tasks.db
+        requests.post(f"{BASE_URL}/api/files/save", data={"path": probe, "content": "reload"}).raise_for_status()
+        r = requests.get(f"{BASE_URL}/api/tasks/{task_id}")
+        r.raise_for_status()
+        stored = r.json().get("name")
+        print_test_result(test_name, stored == name, f"stored name {stored!r}, expected {name!r}")
+    except (requests.exceptions.RequestException, ValueError, KeyError) as e:
+        print_test_result(test_name, False, f"Request failed: {e}")
+    finally:
+        requests.post(f"{BASE_URL}/api/files/delete", data={"path": probe})
+        if task_id:
+            requests.post(f"{BASE_URL}/api/tasks/delete", data={"id": task_id})